@@ -0,0 +1,207 @@
+//-----------------------------------------------------------------------------
+// What the benchmark programs share: timing, reporting, temporary files and
+// the command line.
+//-----------------------------------------------------------------------------
+#include "solvespace.h"
+#include "benchmark.h"
+#if defined(WIN32)
+#   include <windows.h>
+#   include <psapi.h>
+#else
+#   include <unistd.h>
+#   include <sys/resource.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// The peak resident memory of the process, in bytes. Where we can (on Linux),
+// reset it before each benchmark, so that it measures just that benchmark;
+// elsewhere it is the peak over the whole run so far.
+//-----------------------------------------------------------------------------
+static void ResetPeakMemoryUsage() {
+#if defined(__linux__)
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if(f) {
+        fputs("5", f);
+        fclose(f);
+    }
+#endif
+}
+
+static size_t PeakMemoryUsage() {
+#if defined(WIN32)
+    PROCESS_MEMORY_COUNTERS pmc = {};
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        return pmc.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+#   if defined(__linux__)
+    FILE *f = fopen("/proc/self/status", "r");
+    if(f) {
+        char line[256];
+        unsigned long kb = 0;
+        bool found = false;
+        while(fgets(line, sizeof(line), f)) {
+            if(sscanf(line, "VmHWM: %lu kB", &kb) == 1) {
+                found = true;
+                break;
+            }
+        }
+        fclose(f);
+        if(found) return (size_t)kb * 1024;
+    }
+#   endif
+    struct rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+#   if defined(__APPLE__)
+    return (size_t)usage.ru_maxrss;
+#   else
+    return (size_t)usage.ru_maxrss * 1024;
+#   endif
+#endif
+}
+
+Platform::Path TemporaryPath(const std::string &program, const std::string &name) {
+#if defined(WIN32)
+    const char *dir = getenv("TEMP");
+    if(!dir) dir = ".";
+    unsigned long pid = GetCurrentProcessId();
+#else
+    const char *dir = getenv("TMPDIR");
+    if(!dir) dir = "/tmp";
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    return Platform::Path::From(dir).Join(
+        ssprintf("solvespace-%s-%lu-%s", program.c_str(), pid, name.c_str()));
+}
+
+std::string JsonQuote(const std::string &str) {
+    std::string result = "\"";
+    for(char c : str) {
+        if(c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if((unsigned char)c < 0x20) {
+            result += ssprintf("\\u%04x", (unsigned char)c);
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+bool RunBenchmark(const BenchmarkOptions &options, BenchmarkResult *result,
+                  std::function<void()> setupFn,
+                  std::function<bool()> benchFn,
+                  std::function<void()> teardownFn) {
+    ResetPeakMemoryUsage();
+
+    // Warmup
+    setupFn();
+    if(!benchFn()) {
+        fprintf(stderr, "Benchmark failed\n");
+        teardownFn();
+        return false;
+    }
+    teardownFn();
+
+    // Benchmark
+    std::vector<double> times;
+    double time = 0.0;
+    while(times.size() < options.minIter || time < options.minTime) {
+        setupFn();
+        auto testStartTime = std::chrono::steady_clock::now();
+        benchFn();
+        auto testEndTime = std::chrono::steady_clock::now();
+        teardownFn();
+
+        std::chrono::duration<double> testTime = testEndTime - testStartTime;
+        time += testTime.count();
+        times.push_back(testTime.count());
+    }
+
+    std::sort(times.begin(), times.end());
+    size_t iter = times.size();
+    result->iterations = iter;
+    result->total      = time;
+    result->mean       = time / (double)iter;
+    result->median     = (iter % 2 == 1) ? times[iter / 2]
+                                         : (times[iter / 2 - 1] + times[iter / 2]) / 2;
+    result->p95        = times[std::min(iter - 1, (size_t)ceil(0.95 * (double)iter) - 1)];
+    result->min        = times.front();
+    result->max        = times.back();
+    result->peakMemory = PeakMemoryUsage();
+    return true;
+}
+
+void ReportText(const BenchmarkResult &r) {
+    fprintf(stdout, "Mode:        %s\n", r.mode.c_str());
+    fprintf(stdout, "File:        %s\n", r.filename.c_str());
+    fprintf(stdout, "Iterations:  %zd\n", r.iterations);
+    fprintf(stdout, "Time:        %.3f s\n", r.total);
+    fprintf(stdout, "Per iter.:   %.6f s\n", r.mean);
+    fprintf(stdout, "Median:      %.6f s\n", r.median);
+    fprintf(stdout, "95th pct.:   %.6f s\n", r.p95);
+    fprintf(stdout, "Min:         %.6f s\n", r.min);
+    fprintf(stdout, "Peak memory: %.1f MiB\n", (double)r.peakMemory / (1024.0 * 1024.0));
+    fprintf(stdout, "\n");
+}
+
+std::string ReportJson(const BenchmarkResult &r) {
+    return ssprintf("{\"mode\": %s, \"file\": %s, \"iterations\": %zd, "
+                    "\"total\": %.9g, \"mean\": %.9g, \"median\": %.9g, "
+                    "\"p95\": %.9g, \"min\": %.9g, \"max\": %.9g, "
+                    "\"peak_memory\": %zd}",
+                    JsonQuote(r.mode).c_str(), JsonQuote(r.filename).c_str(),
+                    r.iterations, r.total, r.mean, r.median,
+                    r.p95, r.min, r.max, r.peakMemory);
+}
+
+void ReportJsonArray(const std::vector<std::string> &json) {
+    fprintf(stdout, "[\n");
+    for(size_t i = 0; i < json.size(); i++) {
+        fprintf(stdout, "  %s%s\n", json[i].c_str(), (i + 1 < json.size()) ? "," : "");
+    }
+    fprintf(stdout, "]\n");
+}
+
+bool ParseBenchmarkOption(const std::vector<std::string> &args, size_t *argn,
+                          BenchmarkOptions *options) {
+    const std::string &arg = args[*argn];
+    if(arg == "--json") {
+        options->json = true;
+    } else if(arg == "--min-iter" && *argn + 1 < args.size()) {
+        options->minIter = (size_t)std::max(1, atoi(args[++*argn].c_str()));
+    } else if(arg == "--min-time" && *argn + 1 < args.size()) {
+        options->minTime = atof(args[++*argn].c_str());
+    } else if(arg == "--trace" && *argn + 1 < args.size()) {
+        TraceScope::Start(Platform::Path::From(args[++*argn]));
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ParseArguments(const std::vector<std::string> &args,
+                    std::function<void(const std::string &cmd)> showUsage,
+                    std::function<bool(const std::vector<std::string> &args,
+                                       size_t *argn)> parseOption,
+                    std::vector<std::string> *positional, int *status) {
+    for(size_t argn = 1; argn < args.size(); argn++) {
+        const std::string &arg = args[argn];
+        if(arg == "--help" || arg == "-h") {
+            showUsage(args[0]);
+            *status = 0;
+            return false;
+        } else if(arg[0] == '-') {
+            if(!parseOption(args, &argn)) {
+                fprintf(stderr, "Unrecognized option '%s'.\n", arg.c_str());
+                *status = 1;
+                return false;
+            }
+        } else {
+            positional->push_back(arg);
+        }
+    }
+    return true;
+}
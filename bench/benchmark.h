@@ -0,0 +1,56 @@
+//-----------------------------------------------------------------------------
+// What the benchmark programs share: timing a step over many iterations,
+// reporting the times as text or JSON, temporary files, and the command line.
+//-----------------------------------------------------------------------------
+
+#ifndef SOLVESPACE_BENCHMARK_H
+#define SOLVESPACE_BENCHMARK_H
+
+// The options that every benchmark takes; each program adds its own.
+struct BenchmarkOptions {
+    size_t      minIter;
+    double      minTime;
+    bool        json;
+};
+
+struct BenchmarkResult {
+    std::string mode;
+    std::string filename;
+    size_t      iterations;
+    double      total, mean, median, p95, min, max;
+    size_t      peakMemory;
+};
+
+// A file in the temporary directory, named after the program and the process,
+// so that benchmarks running side by side don't share it.
+Platform::Path TemporaryPath(const std::string &program, const std::string &name);
+
+std::string JsonQuote(const std::string &str);
+
+// Time benchFn, after setupFn and before teardownFn, for at least as many
+// iterations and as long as the options say, after one untimed iteration to
+// warm up. Returns false if benchFn fails during the warmup.
+bool RunBenchmark(const BenchmarkOptions &options, BenchmarkResult *result,
+                  std::function<void()> setupFn,
+                  std::function<bool()> benchFn,
+                  std::function<void()> teardownFn);
+
+void ReportText(const BenchmarkResult &r);
+std::string ReportJson(const BenchmarkResult &r);
+void ReportJsonArray(const std::vector<std::string> &json);
+
+// Parse the options that every benchmark takes, and --trace, at args[*argn],
+// moving *argn past any value. Returns false if the option isn't one of them.
+bool ParseBenchmarkOption(const std::vector<std::string> &args, size_t *argn,
+                          BenchmarkOptions *options);
+
+// Parse the command line: --help shows the usage, other options go to
+// parseOption, which works like ParseBenchmarkOption, and the rest are
+// positional. Returns false if the program should exit now, with *status.
+bool ParseArguments(const std::vector<std::string> &args,
+                    std::function<void(const std::string &cmd)> showUsage,
+                    std::function<bool(const std::vector<std::string> &args,
+                                       size_t *argn)> parseOption,
+                    std::vector<std::string> *positional, int *status);
+
+#endif
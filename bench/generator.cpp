@@ -0,0 +1,469 @@
+//-----------------------------------------------------------------------------
+// A generator of large synthetic models, to benchmark the solver, the
+// Booleans and the renderer at scale. The models are built the same way as
+// the interactive tools build them, and saved as .slvs files that the
+// benchmark harness can load directly.
+//-----------------------------------------------------------------------------
+#include "solvespace.h"
+#include "platform/headless.h"
+#include "benchmark.h"
+
+struct GeneratorOptions {
+    int rows;
+    int cols;
+    int count;
+};
+
+//-----------------------------------------------------------------------------
+// Helpers to add groups, requests and constraints to the sketch, in the
+// active group and its active workplane.
+//-----------------------------------------------------------------------------
+static hGroup AddGroup(Group *g) {
+    g->visible = true;
+    g->scale   = 1;
+    g->color   = RGBi(100, 100, 100);
+
+    // The new group goes after every existing one; the group order isn't
+    // rebuilt until we regenerate, so look at the groups themselves.
+    g->order = 0;
+    for(const Group &gi : SK.group) {
+        g->order = std::max(g->order, gi.order + 1);
+    }
+
+    SK.group.AddAndAssignId(g);
+    SS.GW.activeGroup = g->h;
+    return g->h;
+}
+
+// A new sketch in the XY plane, through the origin. Its workplane entity is
+// needed to place points, so this regenerates what's dirty.
+static hGroup AddSketchGroup() {
+    hGroup hg = Group::AddWorkplaneGroup("sketch-in-plane");
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    return hg;
+}
+
+// Parameters that a group creates when it's generated take their values
+// from the previous generation if they exist, so this is how we give them
+// something other than the defaults that depend on the view.
+static void ForceParam(hParam hp, double val) {
+    Param *p = SK.param.FindByIdNoOops(hp);
+    if(p == NULL) {
+        Param pa = {};
+        pa.h = hp;
+        SK.param.Add(&pa);
+        p = SK.GetParam(hp);
+    }
+    p->val = val;
+}
+
+static hGroup AddExtrudeGroup(hGroup sketch, double depth, Group::CombineAs how) {
+    Group g = {};
+    g.type = Group::Type::EXTRUDE;
+    g.subtype = Group::Subtype::ONE_SIDED;
+    g.name = (how == Group::CombineAs::DIFFERENCE) ? "pocket" : "extrude";
+    g.opA = sketch;
+    g.predef.entityB = SK.GetGroup(sketch)->activeWorkplane;
+    g.meshCombine = how;
+    hGroup hg = AddGroup(&g);
+    ForceParam(hg.param(0), 0);
+    ForceParam(hg.param(1), 0);
+    ForceParam(hg.param(2), depth);
+    return hg;
+}
+
+static hGroup AddTranslateGroup(hGroup source, Vector step, int copies) {
+    Group g = {};
+    g.type = Group::Type::TRANSLATE;
+    g.subtype = Group::Subtype::ONE_SIDED;
+    g.name = "translate";
+    g.opA = source;
+    g.valA = copies;
+    g.predef.entityB = Entity::FREE_IN_3D;
+    g.activeWorkplane = Entity::FREE_IN_3D;
+    hGroup hg = AddGroup(&g);
+    ForceParam(hg.param(0), step.x);
+    ForceParam(hg.param(1), step.y);
+    ForceParam(hg.param(2), step.z);
+    return hg;
+}
+
+static hEntity AddPoint(Vector p) {
+    hRequest hr = SS.GW.AddRequest(Request::Type::DATUM_POINT, /*rememberForUndo=*/false);
+    SK.GetEntity(hr.entity(0))->PointForceTo(p);
+    return hr.entity(0);
+}
+
+static hRequest AddLine(Vector a, Vector b) {
+    hRequest hr = SS.GW.AddRequest(Request::Type::LINE_SEGMENT, /*rememberForUndo=*/false);
+    SK.GetEntity(hr.entity(1))->PointForceTo(a);
+    SK.GetEntity(hr.entity(2))->PointForceTo(b);
+    return hr;
+}
+
+// An arc counter-clockwise from a to b, about c.
+static hRequest AddArc(Vector c, Vector a, Vector b) {
+    hRequest hr = SS.GW.AddRequest(Request::Type::ARC_OF_CIRCLE, /*rememberForUndo=*/false);
+    SK.GetEntity(hr.entity(1))->PointForceTo(c);
+    SK.GetEntity(hr.entity(2))->PointForceTo(a);
+    SK.GetEntity(hr.entity(3))->PointForceTo(b);
+    return hr;
+}
+
+static hRequest AddCircle(Vector c, double r) {
+    hRequest hr = SS.GW.AddRequest(Request::Type::CIRCLE, /*rememberForUndo=*/false);
+    SK.GetEntity(hr.entity(1))->PointForceTo(c);
+    SK.GetEntity(hr.entity(64))->DistanceForceTo(r);
+    return hr;
+}
+
+static hConstraint AddDimension(Constraint::Type type, hEntity ptA, hEntity ptB,
+                                hEntity entityA, double val) {
+    Constraint c = {};
+    c.group = SS.GW.activeGroup;
+    c.workplane = SS.GW.ActiveWorkplane();
+    c.type = type;
+    c.ptA = ptA;
+    c.ptB = ptB;
+    c.entityA = entityA;
+    c.valA = val;
+    return Constraint::AddConstraint(&c, /*rememberForUndo=*/false);
+}
+
+// A rectangle from corner a to corner b, constrained like the rectangle
+// tool does it. Its corners, counter-clockwise from a, are returned.
+static void AddRectangle(Vector a, Vector b, hEntity corner[4]) {
+    Vector v[4] = {
+        a, Vector::From(b.x, a.y, 0), b, Vector::From(a.x, b.y, 0)
+    };
+    hRequest lns[4];
+    for(int i = 0; i < 4; i++) {
+        lns[i] = AddLine(v[i], v[(i + 3) % 4]);
+    }
+    for(int i = 0; i < 4; i++) {
+        Constraint::ConstrainCoincident(lns[i].entity(1), lns[(i + 1) % 4].entity(2));
+        Constraint::Constrain(
+            (i % 2) ? Constraint::Type::HORIZONTAL : Constraint::Type::VERTICAL,
+            Entity::NO_ENTITY, Entity::NO_ENTITY,
+            lns[i].entity(0));
+        corner[i] = lns[i].entity(1);
+    }
+}
+
+// A rectangle with both sides dimensioned.
+static void AddDimensionedRectangle(Vector a, Vector b, hEntity corner[4]) {
+    AddRectangle(a, b, corner);
+    AddDimension(Constraint::Type::PT_PT_DISTANCE, corner[0], corner[1],
+                 Entity::NO_ENTITY, fabs(b.x - a.x));
+    AddDimension(Constraint::Type::PT_PT_DISTANCE, corner[1], corner[2],
+                 Entity::NO_ENTITY, fabs(b.y - a.y));
+}
+
+static hRequest AddDimensionedCircle(Vector c, double r) {
+    hRequest hr = AddCircle(c, r);
+    AddDimension(Constraint::Type::DIAMETER, Entity::NO_ENTITY, Entity::NO_ENTITY,
+                 hr.entity(0), 2 * r);
+    return hr;
+}
+
+// A closed outline through the given segments, each of which is a line or an
+// arc; consecutive segments are joined by coincident constraints.
+static void CloseChain(const std::vector<hRequest> &segs) {
+    for(size_t i = 0; i < segs.size(); i++) {
+        hRequest a = segs[i], b = segs[(i + 1) % segs.size()];
+        bool aIsArc = (SK.GetRequest(a)->type == Request::Type::ARC_OF_CIRCLE);
+        bool bIsArc = (SK.GetRequest(b)->type == Request::Type::ARC_OF_CIRCLE);
+        Constraint::ConstrainCoincident(a.entity(aIsArc ? 3 : 2), b.entity(bIsArc ? 2 : 1));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The models. Each builds on the default sketch-in-plane group, and leaves
+// the group that the benchmarks should look at last.
+//-----------------------------------------------------------------------------
+
+// A grid of rectangular panels separated by dimensioned gaps, fully
+// constrained from the origin, and extruded.
+static void GeneratePanelGrid(const GeneratorOptions &opts) {
+    const double width = 40, height = 25, gap = 5, thickness = 3;
+    hGroup sketch = SS.GW.activeGroup;
+
+    std::vector<hEntity> corners((size_t)(opts.rows * opts.cols * 4));
+    for(int i = 0; i < opts.rows; i++) {
+        for(int j = 0; j < opts.cols; j++) {
+            Vector a = Vector::From(j * (width + gap), i * (height + gap), 0);
+            Vector b = a.Plus(Vector::From(width, height, 0));
+            hEntity *corner = &corners[(size_t)((i * opts.cols + j) * 4)];
+            AddDimensionedRectangle(a, b, corner);
+
+            if(j > 0) {
+                // From the bottom right corner of the panel to the left.
+                hEntity prev = corners[(size_t)((i * opts.cols + j - 1) * 4 + 1)];
+                Constraint::Constrain(Constraint::Type::HORIZONTAL,
+                                      prev, corner[0], Entity::NO_ENTITY);
+                AddDimension(Constraint::Type::PT_PT_DISTANCE, prev, corner[0],
+                             Entity::NO_ENTITY, gap);
+            } else if(i > 0) {
+                // From the top left corner of the panel below.
+                hEntity prev = corners[(size_t)(((i - 1) * opts.cols) * 4 + 3)];
+                Constraint::Constrain(Constraint::Type::VERTICAL,
+                                      prev, corner[0], Entity::NO_ENTITY);
+                AddDimension(Constraint::Type::PT_PT_DISTANCE, prev, corner[0],
+                             Entity::NO_ENTITY, gap);
+            } else {
+                Constraint::ConstrainCoincident(
+                    corner[0], Request::HREQUEST_REFERENCE_XY.entity(1));
+            }
+        }
+    }
+
+    AddExtrudeGroup(sketch, thickness, Group::CombineAs::UNION);
+}
+
+// A plate, followed by a chain of groups that alternately drill a hole
+// through it and add a boss on it, each from its own sketch.
+static void GenerateExtrudeChain(const GeneratorOptions &opts) {
+    const double pitch = 20, radius = 5, thickness = 5;
+    int side = std::max(1, (int)ceil(sqrt((double)opts.count)));
+
+    hGroup sketch = SS.GW.activeGroup;
+    hEntity corner[4];
+    AddDimensionedRectangle(Vector::From(0, 0, 0),
+                            Vector::From(side * pitch, side * pitch, 0), corner);
+    Constraint::ConstrainCoincident(corner[0], Request::HREQUEST_REFERENCE_XY.entity(1));
+    AddExtrudeGroup(sketch, thickness, Group::CombineAs::UNION);
+
+    for(int i = 0; i < opts.count; i++) {
+        Vector c = Vector::From((i % side + 0.5) * pitch, (i / side + 0.5) * pitch, 0);
+        sketch = AddSketchGroup();
+        AddDimensionedCircle(c, radius);
+        if(i % 2 == 0) {
+            AddExtrudeGroup(sketch, 2 * thickness, Group::CombineAs::DIFFERENCE);
+        } else {
+            AddExtrudeGroup(sketch, 3 * thickness, Group::CombineAs::UNION);
+        }
+    }
+}
+
+// A block with a hole, repeated along x and then along y; the copies
+// overlap, so every one of them takes part in the Boolean.
+static void GenerateStepRepeat(const GeneratorOptions &opts) {
+    const double size = 20, radius = 5, pitch = 15;
+
+    hGroup sketch = SS.GW.activeGroup;
+    hEntity corner[4];
+    AddDimensionedRectangle(Vector::From(0, 0, 0), Vector::From(size, size, 0), corner);
+    Constraint::ConstrainCoincident(corner[0], Request::HREQUEST_REFERENCE_XY.entity(1));
+    AddDimensionedCircle(Vector::From(size / 2, size / 2, 0), radius);
+    hGroup extrude = AddExtrudeGroup(sketch, size / 2, Group::CombineAs::UNION);
+
+    hGroup row = AddTranslateGroup(extrude, Vector::From(pitch, 0, 0), opts.cols);
+    AddTranslateGroup(row, Vector::From(0, pitch, 0), opts.rows);
+}
+
+// A tube whose outside is a wave of many line segments, revolved about the
+// y axis.
+static void GenerateLathe(const GeneratorOptions &opts) {
+    const double inner = 20, outer = 30, amplitude = 4, height = 100;
+    const int waves = 8;
+
+    hGroup sketch = SS.GW.activeGroup;
+    hRequest axis = AddLine(Vector::From(0, 0, 0), Vector::From(0, height, 0));
+    SK.GetRequest(axis)->construction = true;
+
+    std::vector<hRequest> segs;
+    Vector prev = Vector::From(outer, 0, 0);
+    for(int i = 1; i <= opts.count; i++) {
+        double t = (double)i / opts.count;
+        Vector p = Vector::From(outer + amplitude * sin(2 * PI * waves * t), height * t, 0);
+        segs.push_back(AddLine(prev, p));
+        prev = p;
+    }
+    segs.push_back(AddLine(prev, Vector::From(inner, height, 0)));
+    segs.push_back(AddLine(Vector::From(inner, height, 0), Vector::From(inner, 0, 0)));
+    segs.push_back(AddLine(Vector::From(inner, 0, 0), Vector::From(outer, 0, 0)));
+    CloseChain(segs);
+
+    Group g = {};
+    g.type = Group::Type::LATHE;
+    g.name = "lathe";
+    g.opA = sketch;
+    g.predef.origin = axis.entity(1);
+    g.predef.entityB = axis.entity(0);
+    AddGroup(&g);
+}
+
+// A plate with a grid of dimensioned holes, in a single extrusion.
+static void GenerateHolePlate(const GeneratorOptions &opts) {
+    const double pitch = 10, radius = 3, thickness = 5;
+
+    hGroup sketch = SS.GW.activeGroup;
+    hEntity corner[4];
+    AddDimensionedRectangle(Vector::From(0, 0, 0),
+                            Vector::From(opts.cols * pitch, opts.rows * pitch, 0), corner);
+    Constraint::ConstrainCoincident(corner[0], Request::HREQUEST_REFERENCE_XY.entity(1));
+    for(int i = 0; i < opts.rows; i++) {
+        for(int j = 0; j < opts.cols; j++) {
+            AddDimensionedCircle(Vector::From((j + 0.5) * pitch, (i + 0.5) * pitch, 0), radius);
+        }
+    }
+    AddExtrudeGroup(sketch, thickness, Group::CombineAs::UNION);
+}
+
+// A drawing like an imported DXF: a grid of rounded outlines made of lines
+// and arcs joined by coincident constraints, each with a hole and a few
+// loose points, and nothing else constrained.
+static void GenerateDxfSketch(const GeneratorOptions &opts) {
+    const double width = 30, height = 20, r = 4, pitch = 40;
+
+    for(int i = 0; i < opts.rows; i++) {
+        for(int j = 0; j < opts.cols; j++) {
+            double x0 = j * pitch, y0 = i * pitch,
+                   x1 = x0 + width, y1 = y0 + height;
+            auto P = [](double x, double y) { return Vector::From(x, y, 0); };
+
+            std::vector<hRequest> segs;
+            segs.push_back(AddArc(P(x0 + r, y0 + r), P(x0, y0 + r), P(x0 + r, y0)));
+            segs.push_back(AddLine(P(x0 + r, y0), P(x1 - r, y0)));
+            segs.push_back(AddArc(P(x1 - r, y0 + r), P(x1 - r, y0), P(x1, y0 + r)));
+            segs.push_back(AddLine(P(x1, y0 + r), P(x1, y1 - r)));
+            segs.push_back(AddArc(P(x1 - r, y1 - r), P(x1, y1 - r), P(x1 - r, y1)));
+            segs.push_back(AddLine(P(x1 - r, y1), P(x0 + r, y1)));
+            segs.push_back(AddArc(P(x0 + r, y1 - r), P(x0 + r, y1), P(x0, y1 - r)));
+            segs.push_back(AddLine(P(x0, y1 - r), P(x0, y0 + r)));
+            CloseChain(segs);
+
+            AddDimensionedCircle(P((x0 + x1) / 2, (y0 + y1) / 2), r);
+            AddPoint(P(x0 + r, (y0 + y1) / 2));
+            AddPoint(P(x1 - r, (y0 + y1) / 2));
+        }
+    }
+}
+
+struct Generator {
+    const char *kind;
+    void (*generate)(const GeneratorOptions &);
+    int defaultCount;
+};
+
+static const Generator Generators[] = {
+    { "panel-grid",    GeneratePanelGrid,    0   },
+    { "extrude-chain", GenerateExtrudeChain, 50  },
+    { "step-repeat",   GenerateStepRepeat,   0   },
+    { "lathe",         GenerateLathe,        500 },
+    { "hole-plate",    GenerateHolePlate,    0   },
+    { "dxf-sketch",    GenerateDxfSketch,    0   },
+};
+
+static void ShowUsage(const std::string &cmd) {
+    fprintf(stderr, "Usage: %s [options] <kind> <output.slvs>\n", cmd.c_str());
+    fprintf(stderr, R"(
+Options:
+    --rows <count>      Rows of the grid-like models (default 10).
+    --cols <count>      Columns of the grid-like models (default 10).
+    --count <count>     Groups in the chain, or segments in the lathe profile.
+
+Kind is one of:
+    panel-grid      A grid of rows x cols panels, dimensioned and constrained
+                    to each other, and extruded.
+    extrude-chain   A plate followed by <count> (default 50) groups that each
+                    drill a hole or add a boss, from their own sketch.
+    step-repeat     A block with a hole, stepped cols times along x, and that
+                    row stepped rows times along y.
+    lathe           A tube with a profile of <count> (default 500) segments.
+    hole-plate      A plate with a rows x cols grid of holes.
+    dxf-sketch      A rows x cols grid of outlines of lines and arcs, like an
+                    imported drawing.
+
+The output can be given straight to solvespace-benchmark, e.g.:
+    solvespace-generate --rows 30 --cols 30 hole-plate plate.slvs
+    solvespace-benchmark all plate.slvs
+)");
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args = InitPlatform(argc, argv);
+    TraceScope::StartFromEnvironment();
+
+    GeneratorOptions opts = {};
+    opts.rows = 10;
+    opts.cols = 10;
+
+    std::vector<std::string> positional;
+    int status;
+    if(!ParseArguments(args, ShowUsage,
+            [&](const std::vector<std::string> &args, size_t *argn) {
+                const std::string &arg = args[*argn];
+                if(arg == "--rows" && *argn + 1 < args.size()) {
+                    opts.rows = std::max(1, atoi(args[++*argn].c_str()));
+                } else if(arg == "--cols" && *argn + 1 < args.size()) {
+                    opts.cols = std::max(1, atoi(args[++*argn].c_str()));
+                } else if(arg == "--count" && *argn + 1 < args.size()) {
+                    opts.count = std::max(1, atoi(args[++*argn].c_str()));
+                } else {
+                    return false;
+                }
+                return true;
+            }, &positional, &status)) {
+        return status;
+    }
+    if(positional.size() != 2) {
+        ShowUsage(args[0]);
+        return 1;
+    }
+
+    const std::string &kind = positional[0];
+    Platform::Path output = Platform::Path::From(positional[1]);
+
+    const Generator *generator = NULL;
+    for(const Generator &g : Generators) {
+        if(kind == g.kind) generator = &g;
+    }
+    if(generator == NULL) {
+        fprintf(stderr, "Unknown kind '%s'.\n", kind.c_str());
+        return 1;
+    }
+    if(opts.count == 0) opts.count = generator->defaultCount;
+
+    std::vector<std::string> messages;
+    messageLog = &messages;
+
+    SS.Init();
+    generator->generate(opts);
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+
+    bool ok = true;
+    for(const std::string &message : messages) {
+        fprintf(stderr, "%s\n", message.c_str());
+        ok = false;
+    }
+    for(hGroup hg : SK.groupOrder) {
+        Group *g = SK.GetGroup(hg);
+        if(g->solved.how != SolveResult::OKAY) {
+            fprintf(stderr, "Group %s did not solve.\n", g->DescriptionString().c_str());
+            ok = false;
+        }
+        if((g->type == Group::Type::EXTRUDE || g->type == Group::Type::LATHE) &&
+           SK.GetGroup(g->opA)->polyError.how != PolyError::GOOD) {
+            fprintf(stderr, "Group %s has a bad sketch.\n", g->DescriptionString().c_str());
+            ok = false;
+        }
+    }
+
+    if(ok && !SS.SaveToFile(output)) {
+        fprintf(stderr, "Cannot write '%s'.\n", output.raw.c_str());
+        ok = false;
+    }
+    if(ok) {
+        Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+        fprintf(stdout, "Wrote '%s': %d groups, %d requests, %d constraints, "
+                        "%d entities, %d parameters, %d surfaces.\n",
+                output.raw.c_str(), SK.group.n, SK.request.n, SK.constraint.n,
+                SK.entity.n, SK.param.n, g->runningShell.surface.n);
+    }
+
+    messageLog = NULL;
+    SK.Clear();
+    SS.Clear();
+    return ok ? 0 : 1;
+}
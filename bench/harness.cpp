@@ -4,59 +4,58 @@
 // Copyright 2016 whitequark
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
+#include "benchmark.h"
 
-static bool RunBenchmark(std::function<void()> setupFn,
-                         std::function<bool()> benchFn,
-                         std::function<void()> teardownFn,
-                         size_t minIter = 5, double minTime = 5.0) {
-    // Warmup
-    setupFn();
-    if(!benchFn()) {
-        fprintf(stderr, "Benchmark failed\n");
-        return false;
-    }
-    teardownFn();
-
-    // Benchmark
-    size_t iter = 0;
-    double time = 0.0;
-    while(iter < minIter || time < minTime) {
-        setupFn();
-        auto testStartTime = std::chrono::steady_clock::now();
-        benchFn();
-        auto testEndTime = std::chrono::steady_clock::now();
-        teardownFn();
-
-        std::chrono::duration<double> testTime = testEndTime - testStartTime;
-        time += testTime.count();
-        iter += 1;
-    }
-
-    // Report
-    fprintf(stdout, "Iterations: %zd\n", iter);
-    fprintf(stdout, "Time:       %.3f s\n", time);
-    fprintf(stdout, "Per iter.:  %.3f s\n", time / (double)iter);
+struct HarnessOptions : BenchmarkOptions {
+    std::string constraint;
+};
 
+static bool LoadModel(const Platform::Path &filename) {
+    SS.Init();
+    if(!SS.LoadFromFile(filename))
+        return false;
+    SS.AfterNewFile();
     return true;
 }
 
-int main(int argc, char **argv) {
-    std::vector<std::string> args = InitPlatform(argc, argv);
+static void ClearModel() {
+    SK.Clear();
+    SS.Clear();
+}
 
-    std::string mode;
-    Platform::Path filename;
-    if(args.size() == 3) {
-        mode = args[1];
-        filename = Platform::Path::From(args[2]);
-    } else {
-        fprintf(stderr, "Usage: %s [mode] [filename]\n", args[0].c_str());
-        fprintf(stderr, "Mode can be one of: load.\n");
-        return 1;
+// The dimension to change for the regen-dirty and undo modes: the one that
+// was asked for, or else the first one in the sketch.
+static Constraint *FindDimension(const HarnessOptions &options) {
+    if(!options.constraint.empty()) {
+        const char *start = options.constraint.c_str();
+        if(*start == 'c') start++;
+        hConstraint hc = { (uint32_t)strtoul(start, NULL, 16) };
+        return SK.constraint.FindByIdNoOops(hc);
     }
+    for(Constraint &c : SK.constraint) {
+        if(!c.HasLabel() || c.reference || c.type == Constraint::Type::COMMENT) continue;
+        return &c;
+    }
+    return NULL;
+}
+
+static const char *Modes[] = {
+    "load", "solve", "regen-dirty", "boolean", "boolean-mesh", "triangulate",
+    "display-items", "hit-test", "export-stl", "export-step", "export-dxf",
+    "export-svg", "export-view", "save", "undo", NULL
+};
+
+//-----------------------------------------------------------------------------
+// Run one benchmark mode on one file. Every mode except load starts from a
+// freshly loaded and generated sketch, and only times the step it isolates.
+//-----------------------------------------------------------------------------
+static bool RunMode(const std::string &mode, const Platform::Path &filename,
+                    const HarnessOptions &options, BenchmarkResult *result) {
+    result->mode     = mode;
+    result->filename = filename.raw;
 
-    bool result = false;
     if(mode == "load") {
-        result = RunBenchmark(
+        return RunBenchmark(options, result,
             [] {
                 SS.Init();
             },
@@ -67,12 +66,240 @@ int main(int argc, char **argv) {
                 return true;
             },
             [] {
-                SK.Clear();
-                SS.Clear();
+                ClearModel();
+            });
+    }
+
+    if(!LoadModel(filename)) {
+        fprintf(stderr, "Cannot load '%s'\n", filename.raw.c_str());
+        ClearModel();
+        return false;
+    }
+
+    auto noop = [] {};
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    Platform::Path outputFile;
+    bool ok = false;
+    if(mode == "solve") {
+        ok = RunBenchmark(options, result, noop,
+            [] {
+                for(hGroup hg : SK.groupOrder) {
+                    SS.SolveGroup(hg, /*andFindFree=*/false);
+                }
+                return true;
+            }, noop);
+    } else if(mode == "regen-dirty" || mode == "undo") {
+        Constraint *c = FindDimension(options);
+        if(!c) {
+            fprintf(stderr, "No dimension to change in '%s'\n", filename.raw.c_str());
+        } else {
+            hConstraint hc = c->h;
+            double base = c->valA;
+            bool changed = false;
+            auto Change = [&] {
+                Constraint *c = SK.GetConstraint(hc);
+                changed = !changed;
+                c->valA = changed ? base + 1e-3 * std::max(1.0, fabs(base)) : base;
+                SS.MarkGroupDirty(c->group);
+            };
+
+            if(mode == "regen-dirty") {
+                ok = RunBenchmark(options, result, Change,
+                    [] {
+                        SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+                        return true;
+                    }, noop);
+            } else {
+                ok = RunBenchmark(options, result,
+                    [&] {
+                        SS.UndoRemember();
+                        Change();
+                        SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+                    },
+                    [] {
+                        SS.UndoUndo();
+                        return true;
+                    },
+                    [&] {
+                        changed = false;
+                    });
+            }
+        }
+    } else if(mode == "boolean" || mode == "boolean-mesh") {
+        if(mode == "boolean-mesh") {
+            for(Group &g : SK.group) g.forceToMesh = true;
+            SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+        }
+        ok = RunBenchmark(options, result, noop,
+            [] {
+                for(hGroup hg : SK.groupOrder) {
+                    Group *g = SK.GetGroup(hg);
+                    g->GenerateShellAndMesh();
+                    if(hg.v == SS.GW.activeGroup.v) break;
+                }
+                return true;
+            }, noop);
+    } else if(mode == "triangulate") {
+        if(g->runningShell.IsEmpty()) {
+            fprintf(stderr, "No exact surfaces in '%s'\n", filename.raw.c_str());
+        } else {
+            ok = RunBenchmark(options, result, noop,
+                [&] {
+                    SMesh m = {};
+                    g->runningShell.TriangulateInto(&m);
+                    m.Clear();
+                    return true;
+                }, noop);
+        }
+    } else if(mode == "display-items") {
+        ok = RunBenchmark(options, result,
+            [&] {
+                g->displayDirty = true;
+            },
+            [&] {
+                g->GenerateDisplayItems();
+                return true;
+            }, noop);
+    } else if(mode == "hit-test") {
+        SS.GW.width  = 1024;
+        SS.GW.height = 768;
+        SS.GW.ZoomToFit(/*includingInvisibles=*/false);
+        ok = RunBenchmark(options, result, noop,
+            [] {
+                for(int y = -384; y < 384; y += 32) {
+                    for(int x = -512; x < 512; x += 32) {
+                        SS.GW.HitTestMakeSelection(Point2d::From(x, y));
+                    }
+                }
+                return true;
+            }, noop);
+    } else if(mode == "export-stl" || mode == "export-step" ||
+              mode == "export-dxf" || mode == "export-svg" ||
+              mode == "export-view" || mode == "save") {
+        std::string extension = (mode == "export-stl")  ? "stl"  :
+                                (mode == "export-step") ? "step" :
+                                (mode == "export-dxf")  ? "dxf"  :
+                                (mode == "save")        ? "slvs" : "svg";
+        outputFile = TemporaryPath("benchmark", "output." + extension);
+
+        if(mode == "export-view") {
+            // The full hidden line view: shaded triangles, occluded lines
+            // removed.
+            SS.exportShadedTriangles = true;
+            SS.GW.showShaded         = true;
+            SS.GW.drawOccludedAs     = GraphicsWindow::DrawOccludedAs::INVISIBLE;
+        }
+        SS.GW.projRight = Vector::From(0.707,  0.000, -0.707);
+        SS.GW.projUp    = Vector::From(-0.408, 0.816, -0.408);
+
+        ok = RunBenchmark(options, result, noop,
+            [&] {
+                if(mode == "export-stl") {
+                    SS.ExportMeshTo(outputFile);
+                } else if(mode == "export-step") {
+                    StepFileWriter sfw = {};
+                    sfw.ExportSurfacesTo(outputFile);
+                } else if(mode == "save") {
+                    return SS.SaveToFile(outputFile);
+                } else {
+                    SS.ExportViewOrWireframeTo(outputFile, /*exportWireframe=*/false);
+                }
+                return true;
+            },
+            [&] {
+                remove(outputFile.raw.c_str());
             });
     } else {
         fprintf(stderr, "Unknown mode \"%s\"\n", mode.c_str());
     }
 
+    ClearModel();
+    return ok;
+}
+
+static void ShowUsage(const std::string &cmd) {
+    fprintf(stderr, "Usage: %s [options] [mode] [filename...]\n", cmd.c_str());
+    fprintf(stderr, R"(
+Options:
+    --json                  Write the results as a JSON array on stdout.
+    --min-iter <count>      Run at least <count> iterations (default 5).
+    --min-time <seconds>    Run for at least <seconds> (default 5).
+    --constraint <handle>   The dimension that regen-dirty and undo change,
+                            like "c01a"; by default, the first one.
+    --trace <filename>      Record a Chrome trace of the whole run.
+
+Mode can be "all", or one of:
+    load            Load and generate the sketch.
+    solve           Solve every group, starting from the solved state.
+    regen-dirty     Change one dimension, and regenerate what it affects.
+    boolean         Redo the booleans of every group up to the active one.
+    boolean-mesh    Same, but with every group forced to a triangle mesh.
+    triangulate     Triangulate the exact surfaces of the active group.
+    display-items   Regenerate the display mesh and edges of the active group.
+    hit-test        Hit test a grid of points across a 1024x768 view.
+    export-stl      Export the mesh as STL.
+    export-step     Export the exact surfaces as STEP.
+    export-dxf      Export the 2d view as DXF.
+    export-svg      Export the 2d view as SVG.
+    export-view     Export the 2d view as SVG, shaded, with hidden lines removed.
+    save            Save the sketch.
+    undo            Undo a change of one dimension.
+)");
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args = InitPlatform(argc, argv);
+    TraceScope::StartFromEnvironment();
+
+    HarnessOptions options = {};
+    options.minIter = 5;
+    options.minTime = 5.0;
+
+    std::vector<std::string> positional;
+    int status;
+    if(!ParseArguments(args, ShowUsage,
+            [&](const std::vector<std::string> &args, size_t *argn) {
+                if(args[*argn] == "--constraint" && *argn + 1 < args.size()) {
+                    options.constraint = args[++*argn];
+                    return true;
+                }
+                return ParseBenchmarkOption(args, argn, &options);
+            }, &positional, &status)) {
+        return status;
+    }
+    if(positional.size() < 2) {
+        ShowUsage(args[0]);
+        return 1;
+    }
+
+    std::vector<std::string> modes;
+    if(positional[0] == "all") {
+        for(const char **mode = Modes; *mode; mode++) modes.push_back(*mode);
+    } else {
+        modes.push_back(positional[0]);
+    }
+
+    bool result = true;
+    std::vector<std::string> json;
+    for(size_t i = 1; i < positional.size(); i++) {
+        Platform::Path filename = Platform::Path::From(positional[i]);
+        for(const std::string &mode : modes) {
+            BenchmarkResult r = {};
+            if(!RunMode(mode, filename, options, &r)) {
+                result = false;
+                continue;
+            }
+            if(options.json) {
+                json.push_back(ReportJson(r));
+            } else {
+                ReportText(r);
+            }
+        }
+    }
+
+    if(options.json) {
+        ReportJsonArray(json);
+    }
+
     return (result == true ? 0 : 1);
 }
@@ -0,0 +1,488 @@
+//-----------------------------------------------------------------------------
+// A benchmark of the panelizer, on synthetic floor plans: images of walls in
+// the wall colors, with specks of noise between them, and catalogues of panels
+// for which the best fit of every wall is known. Each stage of the processing
+// is timed by itself, and the fits are checked against the best ones.
+//-----------------------------------------------------------------------------
+#include "solvespace.h"
+#include "PyPanelize.h"
+#include "benchmark.h"
+#include <random>
+
+struct PanelizeOptions : BenchmarkOptions {
+    int         walls;
+    int         pixelsPerFoot;
+    uint32_t    seed;
+};
+
+// Walls are a whole number of feet long, so that their lengths are exact at
+// any resolution, and the fit resolution of a hundredth of a foot.
+static const int MinWallLength = 6;
+static const int MaxWallLength = 40;
+static const double NoiseThreshold = 5;
+
+struct Catalogue {
+    const char          *name;
+    const char          *description;
+    std::vector<double>  widths;
+};
+
+static const Catalogue Catalogues[] = {
+    { "binary",   "laying the widest panels first is best", { 1, 2, 4, 8 } },
+    { "greedy",   "laying the widest panels first is not best", { 1, 3, 4 } },
+    { "waste",    "most walls can't be covered exactly", { 2.5, 4 } },
+};
+
+//-----------------------------------------------------------------------------
+// Runs the stages of a Processor one at a time, which the Processor itself
+// only does all together.
+//-----------------------------------------------------------------------------
+namespace Panelization {
+class ProcessorBenchmark {
+public:
+    Processor processor;
+    double    scale;
+
+    ProcessorBenchmark(const std::string &panelListFileName, double scale) {
+        this->scale = scale;
+        processor.scale = scale;
+        processor.addDefaultColors();
+        processor.getPanels(panelListFileName);
+    }
+
+    std::vector<Wall> &wallList() {
+        return processor.wallList;
+    }
+
+    bool DetectWalls(const std::string &imageName) {
+        processor.wallList.clear();
+        return processor.detectWalls(imageName, /*cornerSelection=*/false);
+    }
+
+    void FilterNoise() {
+        processor.filterNoise(scale, NoiseThreshold, /*cornerSelection=*/false);
+    }
+
+    // Every fit is computed again, rather than found in the cache.
+    void FitPanels() {
+        processor.fitCache = std::make_shared<Processor::FitCache>();
+        processor.computeNumPanelsBestFit();
+    }
+
+    // The walls and their panels are added to a new sketch, made beforehand.
+    bool AddToSketch() {
+        hGroup hg = processor.addToSketch();
+        return SK.GetGroup(hg)->IsSolvedOkay();
+    }
+
+    void WriteOutput(const std::string &outputFileName, const std::string &imageName) {
+        processor.writeToFile(outputFileName, imageName);
+    }
+};
+}
+
+using Panelization::ProcessorBenchmark;
+using Panelization::Wall;
+using Panelization::Panel;
+
+//-----------------------------------------------------------------------------
+// The floor plan. Walls are laid in square cells, parallel to each other,
+// across in one cell and down in the next, and alternately blue and yellow on
+// white. Beside each wall is a speck of its color, too small to be a wall.
+//-----------------------------------------------------------------------------
+static bool GenerateFloorPlan(const PanelizeOptions &options, std::mt19937 *rng,
+                              const Platform::Path &filename, std::vector<int> *lengths,
+                              size_t *width, size_t *height) {
+    // A wall N pixels long measures N - 1, from the first pixel to the last.
+    size_t ppf       = (size_t)options.pixelsPerFoot;
+    size_t thickness = std::max((size_t)6, (ppf + 1) / 2);
+    size_t gap       = 2 * thickness;
+    size_t span      = MaxWallLength * ppf + 1;
+    size_t cellSize  = span + 2 * gap;
+    size_t perCell   = (span - thickness) / (thickness + gap) + 1;
+    size_t numCells  = ((size_t)options.walls + perCell - 1) / perCell;
+    size_t cols      = (size_t)ceil(sqrt((double)numCells));
+    size_t rows      = (numCells + cols - 1) / cols;
+
+    *width  = cols * cellSize;
+    *height = rows * cellSize;
+    std::shared_ptr<Pixmap> pixmap =
+        Pixmap::Create(Pixmap::Format::RGB, *width, *height);
+    std::fill(pixmap->data.begin(), pixmap->data.end(), 255);
+
+    const uint8_t colors[2][3] = {
+        { 0, 0, 255 },      // Blue
+        { 255, 255, 0 },    // Yellow
+    };
+    // Fill a box given along and across the walls of the cell.
+    auto fill = [&](size_t cx, size_t cy, bool down, size_t along, size_t across,
+                    size_t length, size_t breadth, const uint8_t *color) {
+        size_t x0 = cx + (down ? across : along),  x1 = x0 + (down ? breadth : length),
+               y0 = cy + (down ? along : across),  y1 = y0 + (down ? length : breadth);
+        for(size_t y = y0; y < y1; y++) {
+            uint8_t *row = &pixmap->data[y * pixmap->stride];
+            for(size_t x = x0; x < x1; x++) {
+                memcpy(&row[x * 3], color, 3);
+            }
+        }
+    };
+
+    std::uniform_int_distribution<int> lengthDist(MinWallLength, MaxWallLength);
+    lengths->clear();
+    for(size_t i = 0; i < (size_t)options.walls; i++) {
+        size_t cell = i / perCell, j = i % perCell;
+        size_t cx = (cell % cols) * cellSize, cy = (cell / cols) * cellSize;
+        bool down = (cell % 2 == 1);
+        const uint8_t *color = colors[i % 2];
+
+        int length = lengthDist(*rng);
+        lengths->push_back(length);
+        size_t pixels = (size_t)length * ppf + 1;
+        size_t across = gap + j * (thickness + gap);
+        fill(cx, cy, down, gap, across, pixels, thickness, color);
+
+        std::uniform_int_distribution<size_t> speckDist(0, pixels - 3);
+        fill(cx, cy, down, gap + speckDist(*rng), across + thickness + (gap - 3) / 2,
+             3, 3, color);
+    }
+    return pixmap->WritePng(filename);
+}
+
+static bool WriteCatalogue(const Catalogue &catalogue, const Platform::Path &filename) {
+    FILE *f = OpenFile(filename, "wb");
+    if(!f) return false;
+    fprintf(f, "Panel Width (ft)\r\n");
+    for(double width : catalogue.widths) {
+        fprintf(f, "%g\r\n", width);
+    }
+    return fclose(f) == 0;
+}
+
+//-----------------------------------------------------------------------------
+// The best fit of panels to a wall, found independently of the panelizer: we
+// try every number of each panel but the narrowest, which fills what is left.
+// The best fit covers the most of the wall, and with the fewest panels among
+// those that cover as much. Lengths are in hundredths of a foot.
+//-----------------------------------------------------------------------------
+struct Fit {
+    int64_t covered;
+    int64_t numPanels;
+};
+
+static void FindBestFit(int64_t length, const std::vector<int64_t> &widths, size_t k,
+                        int64_t covered, int64_t numPanels, Fit *best) {
+    int64_t width = widths[k];
+    if(k + 1 == widths.size()) {
+        int64_t n = (length - covered) / width;
+        covered += n * width;
+        numPanels += n;
+        if(covered > best->covered ||
+                (covered == best->covered && numPanels < best->numPanels)) {
+            best->covered   = covered;
+            best->numPanels = numPanels;
+        }
+        return;
+    }
+    for(int64_t n = 0; covered + n * width <= length; n++) {
+        FindBestFit(length, widths, k + 1, covered + n * width, numPanels + n, best);
+    }
+}
+
+static Fit BestFit(int64_t length, const Catalogue &catalogue) {
+    std::vector<int64_t> widths;
+    for(double width : catalogue.widths) {
+        widths.push_back((int64_t)lround(width * 100));
+    }
+    std::sort(widths.begin(), widths.end(), std::greater<int64_t>());
+    Fit best = { 0, 0 };
+    FindBestFit(length, widths, 0, 0, 0, &best);
+    return best;
+}
+
+struct FitCheck {
+    size_t  wallsDetected;
+    size_t  wallsKept;
+    size_t  wrongLengths;
+    size_t  wrongFits;
+    int64_t numPanels, bestNumPanels;
+    double  waste, bestWaste;
+};
+
+// Compare the walls that were kept with the ones that were drawn, and the fit
+// of each with the best one for its length.
+static FitCheck CheckFits(const std::vector<Wall> &walls, const std::vector<int> &lengths,
+                          const Catalogue &catalogue) {
+    FitCheck check = {};
+    check.wallsKept = walls.size();
+
+    std::vector<int64_t> expected, found;
+    for(int length : lengths) {
+        expected.push_back((int64_t)length * 100);
+        Fit fit = BestFit((int64_t)length * 100, catalogue);
+        check.bestNumPanels += fit.numPanels;
+        check.bestWaste     += (double)((int64_t)length * 100 - fit.covered) / 100;
+    }
+
+    std::map<int64_t, Fit> bestFits;
+    for(const Wall &wall : walls) {
+        int64_t length = (int64_t)lround(wall.getLength() * 100);
+        found.push_back(length);
+        if(bestFits.find(length) == bestFits.end()) {
+            bestFits[length] = BestFit(length, catalogue);
+        }
+        const Fit &best = bestFits[length];
+
+        int64_t numPanels = 0;
+        double covered = 0;
+        for(const Panel &panel : wall.getBestFitPanelList()) {
+            numPanels += (int64_t)panel.getNumPanels();
+            covered   += panel.getWidth() * panel.getNumPanels();
+        }
+        check.numPanels += numPanels;
+        check.waste     += wall.getWaste();
+
+        double bestWaste = (double)(length - best.covered) / 100;
+        if(numPanels != best.numPanels || fabs(wall.getWaste() - bestWaste) > 1e-6 ||
+                fabs(covered + wall.getWaste() - wall.getLength()) > 1e-6) {
+            check.wrongFits++;
+        }
+    }
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(found.begin(), found.end());
+    std::vector<int64_t> missing;
+    std::set_symmetric_difference(expected.begin(), expected.end(),
+                                  found.begin(), found.end(),
+                                  std::back_inserter(missing));
+    check.wrongLengths = missing.size();
+    return check;
+}
+
+//-----------------------------------------------------------------------------
+// Reporting the check of the fits, alongside the times.
+//-----------------------------------------------------------------------------
+static void ReportFitText(const Catalogue &catalogue, const FitCheck &check,
+                          const PanelizeOptions &options) {
+    std::string widths;
+    for(double width : catalogue.widths) {
+        if(!widths.empty()) widths += ", ";
+        widths += ssprintf("%g", width);
+    }
+    fprintf(stdout, "Catalogue:   %s (%s ft; %s)\n",
+            catalogue.name, widths.c_str(), catalogue.description);
+    fprintf(stdout, "Walls:       %zd of %d kept, of %zd regions detected\n",
+            check.wallsKept, options.walls, check.wallsDetected);
+    fprintf(stdout, "Panels:      %lld, best %lld\n",
+            (long long)check.numPanels, (long long)check.bestNumPanels);
+    fprintf(stdout, "Waste:       %.2f ft, best %.2f ft\n", check.waste, check.bestWaste);
+    fprintf(stdout, "Wrong:       %zd lengths, %zd fits\n",
+            check.wrongLengths, check.wrongFits);
+    fprintf(stdout, "\n");
+}
+
+static std::string ReportFitJson(const Catalogue &catalogue, const FitCheck &check) {
+    return ssprintf("{\"mode\": \"check\", \"file\": %s, \"detected\": %zd, "
+                    "\"kept\": %zd, \"panels\": %lld, \"best_panels\": %lld, "
+                    "\"waste\": %.9g, \"best_waste\": %.9g, "
+                    "\"wrong_lengths\": %zd, \"wrong_fits\": %zd}",
+                    JsonQuote(catalogue.name).c_str(), check.wallsDetected, check.wallsKept,
+                    (long long)check.numPanels, (long long)check.bestNumPanels,
+                    check.waste, check.bestWaste, check.wrongLengths, check.wrongFits);
+}
+
+//-----------------------------------------------------------------------------
+// Time each stage on the floor plan, with one catalogue, leaving the result
+// of the stage for the next one; then check the fits. Returns false if any
+// wall is not found, or not fitted as well as it could be.
+//-----------------------------------------------------------------------------
+static bool RunCatalogue(const Catalogue &catalogue, const PanelizeOptions &options,
+                         const Platform::Path &imageFile, const std::vector<int> &lengths,
+                         const std::string &description, std::vector<std::string> *json) {
+    Platform::Path catalogueFile = TemporaryPath("panelize", ssprintf("%s.csv", catalogue.name));
+    Platform::Path outputFile    = TemporaryPath("panelize", "output.csv");
+    if(!WriteCatalogue(catalogue, catalogueFile)) {
+        fprintf(stderr, "Cannot write '%s'\n", catalogueFile.raw.c_str());
+        return false;
+    }
+
+    ProcessorBenchmark bench(catalogueFile.raw, 1.0 / options.pixelsPerFoot);
+    std::vector<Wall> detected, filtered;
+    bool ok = true;
+    auto noop = [] {};
+    auto run = [&](const char *mode, std::function<void()> setupFn,
+                   std::function<bool()> benchFn, std::function<void()> teardownFn) {
+        BenchmarkResult r = {};
+        if(!RunBenchmark(options, &r, setupFn, benchFn, teardownFn)) {
+            fprintf(stderr, "The %s stage failed with catalogue '%s'.\n",
+                    mode, catalogue.name);
+            ok = false;
+            return;
+        }
+        r.mode     = mode;
+        r.filename = ssprintf("%s, %s", catalogue.name, description.c_str());
+        if(options.json) {
+            json->push_back(ReportJson(r));
+        } else {
+            ReportText(r);
+        }
+    };
+
+    run("detect", noop,
+        [&] {
+            return bench.DetectWalls(imageFile.raw);
+        }, noop);
+    detected = bench.wallList();
+
+    run("filter-noise",
+        [&] {
+            bench.wallList() = detected;
+        },
+        [&] {
+            bench.FilterNoise();
+            return true;
+        }, noop);
+    filtered = bench.wallList();
+
+    run("fit",
+        [&] {
+            bench.wallList() = filtered;
+        },
+        [&] {
+            bench.FitPanels();
+            return true;
+        }, noop);
+
+    run("sketch",
+        [] {
+            SS.Init();
+        },
+        [&] {
+            return bench.AddToSketch();
+        },
+        [] {
+            SK.Clear();
+            SS.Clear();
+        });
+
+    run("output", noop,
+        [&] {
+            bench.WriteOutput(outputFile.raw, imageFile.raw);
+            return true;
+        },
+        [&] {
+            remove(outputFile.raw.c_str());
+        });
+
+    FitCheck check = CheckFits(bench.wallList(), lengths, catalogue);
+    check.wallsDetected = detected.size();
+    if(options.json) {
+        json->push_back(ReportFitJson(catalogue, check));
+    } else {
+        ReportFitText(catalogue, check, options);
+    }
+
+    remove(catalogueFile.raw.c_str());
+    return ok &&
+           check.wallsDetected == 2 * lengths.size() &&
+           check.wallsKept == lengths.size() &&
+           check.wrongLengths == 0 && check.wrongFits == 0;
+}
+
+static void ShowUsage(const std::string &cmd) {
+    fprintf(stderr, "Usage: %s [options] [catalogue...]\n", cmd.c_str());
+    fprintf(stderr, R"(
+Options:
+    --json                  Write the results as a JSON array on stdout.
+    --min-iter <count>      Run at least <count> iterations (default 5).
+    --min-time <seconds>    Run for at least <seconds> (default 1).
+    --walls <count>         Draw <count> walls (default 500).
+    --pixels-per-foot <n>   Draw walls at <n> pixels per foot (default 10).
+    --seed <n>              Seed the wall lengths with <n> (default 1).
+    --trace <filename>      Record a Chrome trace of the whole run.
+
+Catalogue can be "all" (the default), or one of:
+    binary          Panels of 1, 2, 4 and 8 ft.
+    greedy          Panels of 1, 3 and 4 ft.
+    waste           Panels of 2.5 and 4 ft.
+
+The stages timed are detect, filter-noise, fit, sketch (adding the walls and
+panels to a new sketch, and solving it) and output. Then the fits are checked
+against the best ones, and the exit status is 1 if any is not as good, or if
+a stage failed (as the sketch does when it doesn't solve).
+)");
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args = InitPlatform(argc, argv);
+    TraceScope::StartFromEnvironment();
+
+    PanelizeOptions options = {};
+    options.minIter       = 5;
+    options.minTime       = 1.0;
+    options.walls         = 500;
+    options.pixelsPerFoot = 10;
+    options.seed          = 1;
+
+    std::vector<std::string> positional;
+    int status;
+    if(!ParseArguments(args, ShowUsage,
+            [&](const std::vector<std::string> &args, size_t *argn) {
+                const std::string &arg = args[*argn];
+                if(arg == "--walls" && *argn + 1 < args.size()) {
+                    options.walls = std::max(1, atoi(args[++*argn].c_str()));
+                } else if(arg == "--pixels-per-foot" && *argn + 1 < args.size()) {
+                    options.pixelsPerFoot = std::max(5, atoi(args[++*argn].c_str()));
+                } else if(arg == "--seed" && *argn + 1 < args.size()) {
+                    options.seed = (uint32_t)strtoul(args[++*argn].c_str(), NULL, 10);
+                } else {
+                    return ParseBenchmarkOption(args, argn, &options);
+                }
+                return true;
+            }, &positional, &status)) {
+        return status;
+    }
+
+    std::vector<const Catalogue *> catalogues;
+    if(positional.empty() || (positional.size() == 1 && positional[0] == "all")) {
+        for(const Catalogue &c : Catalogues) catalogues.push_back(&c);
+    } else {
+        for(const std::string &name : positional) {
+            const Catalogue *catalogue = NULL;
+            for(const Catalogue &c : Catalogues) {
+                if(name == c.name) catalogue = &c;
+            }
+            if(catalogue == NULL) {
+                fprintf(stderr, "Unknown catalogue '%s'.\n", name.c_str());
+                return 1;
+            }
+            catalogues.push_back(catalogue);
+        }
+    }
+
+    std::mt19937 rng(options.seed);
+    Platform::Path imageFile = TemporaryPath("panelize", "plan.png");
+    std::vector<int> lengths;
+    size_t width, height;
+    if(!GenerateFloorPlan(options, &rng, imageFile, &lengths, &width, &height)) {
+        fprintf(stderr, "Cannot write '%s'\n", imageFile.raw.c_str());
+        return 1;
+    }
+    std::string description = ssprintf("%d walls at %d px/ft, %zdx%zd",
+                                       options.walls, options.pixelsPerFoot,
+                                       width, height);
+
+    bool result = true;
+    std::vector<std::string> json;
+    for(const Catalogue *catalogue : catalogues) {
+        if(!RunCatalogue(*catalogue, options, imageFile, lengths, description, &json)) {
+            result = false;
+        }
+    }
+    remove(imageFile.raw.c_str());
+
+    if(options.json) {
+        ReportJsonArray(json);
+    }
+
+    return (result == true ? 0 : 1);
+}
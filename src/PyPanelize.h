@@ -18,8 +18,152 @@
 #include <map>
 #include <sstream>
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "solvespace.h"
 
 namespace Panelization {
+// How much the panelizer tells about what it is doing. Only errors are printed
+// unless the level is raised, with setLogLevel or by setting
+// SOLVESPACE_PANELIZE_LOG to the number of a level.
+enum class LogLevel : int {
+	QUIET   = 0,
+	ERRORS  = 1,
+	INFO    = 2,
+	DEBUG   = 3,
+};
+
+inline std::atomic<int> &currentLogLevel() {
+	static std::atomic<int> level([]() {
+		const char *level = getenv("SOLVESPACE_PANELIZE_LOG");
+		return (level && *level) ? atoi(level) : (int)LogLevel::ERRORS;
+	}());
+	return level;
+}
+
+inline void setLogLevel(LogLevel level) {
+	currentLogLevel().store((int)level, std::memory_order_relaxed);
+}
+
+inline bool logEnabled(LogLevel level) {
+	return currentLogLevel().load(std::memory_order_relaxed) >= (int)level;
+}
+
+// Log a message built with <<, e.g. PANELIZE_LOG(DEBUG, "Wall: " << length).
+// Unless the level is enabled, this is a flag test and the message is never
+// formatted. The message is written all at once, so that messages from
+// different threads do not interleave.
+#define PANELIZE_LOG(level, message)                                      \
+	do {                                                                  \
+		if(Panelization::logEnabled(Panelization::LogLevel::level)) {     \
+			std::ostringstream panelizeLog;                               \
+			panelizeLog << message;                                       \
+			std::cout << panelizeLog.str();                               \
+		}                                                                 \
+	} while(0)
+
+// Reads a CSV file a record at a time. The fields point straight into the
+// contents of the file, so nothing is copied or allocated per record. Quoted
+// fields are supported, but quotes within them are not unescaped.
+class CsvReader {
+public:
+	struct Field {
+		const char *begin;
+		const char *end;
+	};
+
+	bool open(const std::string &fileName) {
+		position = 0;
+		return SolveSpace::Platform::ReadFile(SolveSpace::Platform::Path::From(fileName), &data);
+	}
+
+// Read the fields of the next record, skipping blank lines. Returns false at
+// the end of the file.
+	bool nextRecord(std::vector<Field> &fields) {
+		fields.clear();
+		const char *p = data.c_str() + position, *end = data.c_str() + data.size();
+		while(p != end && (*p == '\r' || *p == '\n'))
+			p++;
+		if(p == end) {
+			position = data.size();
+			return false;
+		}
+		while(true) {
+			Field field;
+			if(*p == '"') {
+				field.begin = ++p;
+				while(p != end && *p != '"')
+					p++;
+				field.end = p;
+				while(p != end && *p != ',' && *p != '\r' && *p != '\n')
+					p++;
+			} else {
+				field.begin = p;
+				while(p != end && *p != ',' && *p != '\r' && *p != '\n')
+					p++;
+				field.end = p;
+			}
+			fields.push_back(field);
+			if(p == end || *p != ',')
+				break;
+			p++;
+		}
+		position = p - data.c_str();
+		return true;
+	}
+
+// Parse a field that holds just a number, besides spaces around it
+	static bool parseNumber(const Field &field, double *value) {
+		const char *begin = field.begin, *end = field.end;
+		while(begin != end && (*begin == ' ' || *begin == '\t'))
+			begin++;
+		while(end != begin && (end[-1] == ' ' || end[-1] == '\t'))
+			end--;
+		if(begin == end)
+			return false;
+	// The field is followed by a delimiter or the end of the buffer, neither of
+	// which can be part of a number, so strtod stops within the field.
+		char *parsed;
+		*value = strtod(begin, &parsed);
+		return parsed == end;
+	}
+
+// Whether a field contains the given name, ignoring case, spaces and underscores
+	static bool fieldContains(const Field &field, const char *name) {
+		std::string text;
+		for(const char *p = field.begin; p != field.end; p++) {
+			if(*p != ' ' && *p != '_')
+				text.push_back((char)tolower((unsigned char)*p));
+		}
+		return text.find(name) != std::string::npos;
+	}
+
+private:
+	std::string data;
+	size_t position = 0;
+};
+
+// A point in an image, in pixels
+struct Point {
+	double x = 0;
+	double y = 0;
+
+	Point() = default;
+
+	Point(double x, double y) {
+		this->x = x;
+		this->y = y;
+	}
+};
+
 // Generic class to represent colors. But it is abstract i.e. you are not
 // to make a new Color object.
 class Color {
@@ -71,7 +215,7 @@ private:
 // Order of parameters: LOW_H, HIGH_H, LOW_S, HIGH_S, LOW_V, HIGH_V
 	void setColor(const std::vector<uint8_t> &hsv) {
 		if(hsv.size() != 3) {
-			std::cout << "Invalid HSV vector\n";
+			PANELIZE_LOG(ERRORS, "Invalid HSV vector\n");
 			exit(-1);
 		}
 		hue = hsv[0];
@@ -79,7 +223,7 @@ private:
 		brightness = hsv[2];
 	}
 
-	void printColor() {
+	void printColor() const {
 		printf("HUE: %" PRIu8"\n", hue);
 		printf("SATURATION: %" PRIu8"\n", saturation);
 		printf("BRIGHTNESS: %" PRIu8"\n", brightness);
@@ -109,10 +253,6 @@ private:
 		height = panelHeight;
 	}
 
-	Panel(const Panel &) = delete;
-
-	Panel operator =(const Panel &) = delete;
-
 public:
 // Get panel info
 	double getWidth() const {
@@ -138,7 +278,7 @@ private:
 	}
 
 // Print Panel information
-	void printPanelInfo() {
+	void printPanelInfo() const {
 		std::cout << "+++++++++++++ PRINT PANEL INFO ++++++++++++++\n";
 		std::cout << "Panel Width: " << width << "\n";
 		std::cout << "Panel Height: " << height << "\n";
@@ -155,15 +295,19 @@ private:
 	double width = 0;
 	double height = 0;
 
-// Vector of vector of panels that best fit the wall
-	std::vector<std::vector<Panel *> *> bestFitPanelList;
+// Panels that best fit the wall. The list is shared by all the walls that the
+// same fit is computed for, and never changed once made.
+	std::shared_ptr<const std::vector<Panel>> bestFitPanelList;
 
-// We define the "head" of the panel list as the outermost panel for a wall.
-// We map the head of the panels to the pointer to the panel list.
-	std::map<const Panel *, std::vector<Panel *> *> panelHeadListMap;
+// Sides of the wall in the print; walls from corner selection have only one
+	double rectSides[2] = { 0, 0 };
+	size_t numRectSides = 0;
 
-// Sides of the wall in the print
-	std::vector<double> rectSides;
+// Corners of the wall in the print
+	std::vector<Point> rectPoints;
+
+// Length of the wall left uncovered by the best fit panels
+	double waste = 0;
 
 // Constructors need to be private to restrict how this class is used
 	Wall() = default;
@@ -178,10 +322,6 @@ private:
 		this->setColor(hue, saturation, brightness);
 	}
 
-	Wall(const Wall &) = delete;
-
-	Wall operator = (const Wall &) = delete;
-	
 	friend class Processor;
 
 public:
@@ -198,8 +338,17 @@ public:
 		return height;
 	}
 
-	std::vector<std::vector<Panel *> *> &getBestFitPanelList() {
-		return bestFitPanelList;
+	const std::vector<Panel> &getBestFitPanelList() const {
+		static const std::vector<Panel> noPanels;
+		return bestFitPanelList ? *bestFitPanelList : noPanels;
+	}
+
+	const std::vector<Point> &getRectPoints() const {
+		return rectPoints;
+	}
+
+	double getWaste() const {
+		return waste;
 	}
 
 private:
@@ -217,89 +366,40 @@ private:
 	}
 
 	void setRectSides(double side1, double side2) {
-		rectSides.clear();
-		rectSides.push_back(side1);
-		rectSides.push_back(side2);
+		rectSides[0] = side1;
+		rectSides[1] = side2;
+		numRectSides = 2;
 	}
 	
 	void setRectSide(double side) {
-		rectSides.clear();
-		rectSides.push_back(side);
+		rectSides[0] = side;
+		rectSides[1] = 0;
+		numRectSides = 1;
 	}
 	
-	std::vector<double> &getRectSides() {
+	const double *getRectSides() const {
 		return rectSides;
 	}
-	
-	void addBestFitPanel(Panel *panel, uint32_t numPanels = 1) {
-	// This is a panel for a new list
-		std::vector<Panel *> *panelList = new std::vector<Panel *>();
-		panelList->push_back(panel);
-		bestFitPanelList.push_back(panelList);
-		panelHeadListMap[panel] = panelList;
-		panel->incrementNumPanels(numPanels);
-	}
-
-	void addBestFitPanel(Panel *panel, std::vector<Panel*> &headPanelList,
-													uint32_t numPanels = 1) {
-		if(headPanelList.empty()) {
-		// This is a panel for a new list
-			std::vector<Panel *> *panelList = new std::vector<Panel *>();
-			panelList->push_back(panel);
-			bestFitPanelList.push_back(panelList);
-
-			panelHeadListMap[panel] = panelList;
-			headPanelList.push_back(panel);
-		} else {
-		// Access the map to get the panel list corresponding to the given head panel
-		// and add the new panel to the list.
-			std::vector<Panel *>::iterator it = headPanelList.begin();
-			while(it != headPanelList.end()) {
-				(*panelHeadListMap[*it]).push_back(panel);
-				it++;
-			}
-		}
-		panel->incrementNumPanels(numPanels);
-	}
-
-// Make sure there is no repetition of panels in the panel list	
-	void mergePanelsInPanelLists() {
-		std::vector<std::vector<Panel *> *>::iterator panelList = bestFitPanelList.begin();
-		while(panelList != bestFitPanelList.end()) {
-		// Iterate over the panels to see if the panels in a list are repetitive. If they are
-		// merge them.
-			if((*panelList)->size() != 1) {
-				std::vector<Panel *>::iterator panel = (*panelList)->begin();
-				while(panel != (*panelList)->end()) {
-						std::vector<Panel *>::iterator temp_panel = (*panelList)->begin();
-						while(temp_panel != (*panelList)->end()) {
-							if(temp_panel != panel) {
-								if((*temp_panel)->getWidth() == (*panel)->getWidth()
-								&& (*temp_panel)->getHeight() == (*panel)->getHeight()) {
-								// Merge panels
-									(*panel)->incrementNumPanels((*temp_panel)->getNumPanels());
-									std::vector<Panel *>::iterator it = temp_panel - 1;
-									delete *temp_panel;
-									(*panelList)->erase(temp_panel);
-									temp_panel = it;
-								}
-							}
-							temp_panel++;
-						}
-					panel++;
-				}
-			}
-			panelList++;
-		}
+
+	void setRectPoints(const Point points[4]) {
+		rectPoints.assign(points, points + 4);
+	}
+
+	void setWaste(double wallWaste) {
+		waste = wallWaste;
 	}
 	
+	void setBestFitPanelList(const std::shared_ptr<const std::vector<Panel>> &panelList) {
+		bestFitPanelList = panelList;
+	}
+
 // This class is not abstract
 	void abstractColor() const {}
 
 // Verify wall info is correct
 	bool wallInfoIsSane() {
 		//return true;
-		if(!(rectSides.size() && rectSides.size() <= 2))
+		if(!(numRectSides && numRectSides <= 2))
 			return false;
 		if(!length)
 			return false;
@@ -310,7 +410,7 @@ private:
 	void printWallInfo() {
 	// Verify wall info is sane
 		if(!wallInfoIsSane()) {
-			std::cout << "Wall info is not sane\n";
+			PANELIZE_LOG(ERRORS, "Wall info is not sane\n");
 			//exit(-1);
 		}
 
@@ -320,33 +420,541 @@ private:
 		std::cout << "Wall Length: " << length << "\n";
 		std::cout << "Wall Width: " << width << "\n";
 		std::cout << "Wall Height: " << height << "\n";
+		std::cout << "Wall Waste: " << waste << "\n";
 
 	// Print wall color
 		printColor();
 
 	// Print Best fit Panel info
-		std::vector<std::vector<Panel *> *>::iterator panel_list_it = bestFitPanelList.begin();
-		while(panel_list_it != bestFitPanelList.end()) {
+		if(bestFitPanelList) {
 			std::cout << "-------------------- PANEL LIST ----------------------\n";
-			std::vector<Panel *>::iterator panel_it = (*panel_list_it)->begin();
-			while(panel_it != (*panel_list_it)->end()) {
-				(*panel_it)->printPanelInfo();
+			std::vector<Panel>::const_iterator panel_it = bestFitPanelList->begin();
+			while(panel_it != bestFitPanelList->end()) {
+				panel_it->printPanelInfo();
 				panel_it++;
 			}
 			std::cout << "------------------------------------------------------\n";
-			panel_list_it++;
 		}
 		std::cout << "*****************************************\n";
 	}
 };
 
+// Range of HSV values that a wall color can take. Hue is in [0, 180), as in
+// OpenCV, and saturation and brightness are in [0, 255].
+class ColorRange {
+private:
+	uint8_t lowH = 0;
+	uint8_t highH = 0;
+	uint8_t lowS = 0;
+	uint8_t highS = 0;
+	uint8_t lowV = 0;
+	uint8_t highV = 0;
+
+	friend class Image;
+	friend class Processor;
+
+	ColorRange(uint8_t lowH, uint8_t highH, uint8_t lowS, uint8_t highS,
+			   uint8_t lowV, uint8_t highV) {
+		this->lowH = lowH;
+		this->highH = highH;
+		this->lowS = lowS;
+		this->highS = highS;
+		this->lowV = lowV;
+		this->highV = highV;
+	}
+};
+
+// A connected region of an image, which is what a wall looks like in the print.
+// We keep its convex hull, which is all that fitting a rectangle needs, and its
+// area and average color, and which of the wall colors it was found in.
+struct Contour {
+	std::vector<Point> hull;
+	size_t color = 0;
+	size_t area = 0;
+	double hue = 0;
+	double saturation = 0;
+	double brightness = 0;
+};
+
+// This class represents images in HSV, in which walls are detected. Images are
+// processed a tile at a time, so an Image holds one tile. We do not want this
+// class to be accessed by any class other than Processor.
+class Image {
+private:
+	friend class Processor;
+
+// Image size, and HSV values of the pixels, row by row
+	size_t width = 0;
+	size_t height = 0;
+	std::vector<uint8_t> hsv;
+
+// A horizontal run of pixels with the same label in a row, and the sums of the
+// HSV values of its pixels
+	struct Run {
+		size_t x0;
+		size_t x1;
+		uint8_t label;
+		double hue;
+		double saturation;
+		double brightness;
+	};
+
+// Follows the 8-connected regions of runs with the same label down an image, a
+// row at a time, and finishes the contour of each region as soon as a row does
+// not continue it. Only regions that reach the last row are kept, and each of
+// those keeps only the hull of its run ends so far, so that memory does not
+// grow with the height of the image.
+	class RegionFinder {
+	public:
+		void addRow(size_t y, const std::vector<Run> &runs) {
+			currentRow.clear();
+			size_t above = 0;
+			std::vector<Run>::const_iterator run = runs.begin();
+			while(run != runs.end()) {
+				RowRun rowRun = { run->x0, run->x1, run->label, NONE };
+			// Skip the runs above that end before this one starts, diagonally
+			// included; those can't touch any later run in this row either.
+				while(above < previousRow.size() && previousRow[above].x1 + 1 < run->x0)
+					above++;
+				for(size_t j = above;
+						j < previousRow.size() && previousRow[j].x0 <= run->x1 + 1; j++) {
+					if(previousRow[j].label != run->label)
+						continue;
+					size_t region = findRoot(previousRow[j].region);
+					if(rowRun.region == NONE) {
+						rowRun.region = region;
+					} else {
+						rowRun.region = mergeRegions(rowRun.region, region);
+					}
+				}
+				if(rowRun.region == NONE)
+					rowRun.region = newRegion(run->label, run->x0, y);
+				addRun(regions[rowRun.region], *run, y);
+				currentRow.push_back(rowRun);
+				run++;
+			}
+
+		// Point the runs of this row at their regions as they are now. Regions that
+		// went on in the row above but not in this one are done, and those merged
+		// into others are no longer needed.
+			std::vector<size_t> nextActiveRegions;
+			std::vector<RowRun>::iterator rowRun = currentRow.begin();
+			while(rowRun != currentRow.end()) {
+				rowRun->region = findRoot(rowRun->region);
+				Region &region = regions[rowRun->region];
+				if(region.lastRow != y) {
+					region.lastRow = y;
+					nextActiveRegions.push_back(rowRun->region);
+				}
+				rowRun++;
+			}
+			std::vector<size_t>::iterator it = activeRegions.begin();
+			while(it != activeRegions.end()) {
+				if(regions[*it].parent == *it && regions[*it].lastRow != y)
+					finishRegion(*it);
+				it++;
+			}
+			it = mergedRegions.begin();
+			while(it != mergedRegions.end()) {
+				freeRegion(*it);
+				it++;
+			}
+			mergedRegions.clear();
+			activeRegions.swap(nextActiveRegions);
+			previousRow.swap(currentRow);
+		}
+
+	// Finish the regions that reach the last row, and give all the contours,
+	// ordered by color and then smallest first. Ties go to the region that starts
+	// first, so that the order does not depend on how the image was tiled.
+		void finish(std::vector<Contour> &contours) {
+			std::vector<size_t>::iterator it = activeRegions.begin();
+			while(it != activeRegions.end()) {
+				finishRegion(*it);
+				it++;
+			}
+			activeRegions.clear();
+			previousRow.clear();
+
+			std::vector<size_t> order(finished.size());
+			for(size_t i = 0; i < order.size(); i++)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+				const Contour &ca = finished[a], &cb = finished[b];
+				if(ca.color != cb.color)
+					return ca.color < cb.color;
+				if(ca.area != cb.area)
+					return ca.area < cb.area;
+				return starts[a] < starts[b];
+			});
+			contours.clear();
+			contours.reserve(order.size());
+			for(size_t k = 0; k < order.size(); k++)
+				contours.push_back(std::move(finished[order[k]]));
+			finished.clear();
+			starts.clear();
+		}
+
+	private:
+		static const size_t NONE = SIZE_MAX;
+
+		struct Region {
+			size_t parent;
+			uint8_t label;
+			size_t lastRow;
+			std::pair<size_t, size_t> start;
+			size_t area;
+			double hue;
+			double saturation;
+			double brightness;
+		// Ends of the runs of the region, of which only the hull matters. It is
+		// taken again whenever there are enough new points.
+			std::vector<Point> points;
+			size_t hullSize;
+		};
+
+		struct RowRun {
+			size_t x0;
+			size_t x1;
+			uint8_t label;
+			size_t region;
+		};
+
+		std::vector<Region> regions;
+		std::vector<size_t> freeRegions;
+	// Regions with runs in the last row, and regions merged into others in it
+		std::vector<size_t> activeRegions;
+		std::vector<size_t> mergedRegions;
+		std::vector<RowRun> previousRow;
+		std::vector<RowRun> currentRow;
+		std::vector<Point> hull;
+	// Finished contours, and where their regions start, as (row, column)
+		std::vector<Contour> finished;
+		std::vector<std::pair<size_t, size_t>> starts;
+
+		size_t findRoot(size_t i) {
+			while(regions[i].parent != i) {
+				regions[i].parent = regions[regions[i].parent].parent;
+				i = regions[i].parent;
+			}
+			return i;
+		}
+
+		size_t newRegion(uint8_t label, size_t x, size_t y) {
+			size_t i;
+			if(freeRegions.empty()) {
+				i = regions.size();
+				regions.push_back(Region());
+			} else {
+				i = freeRegions.back();
+				freeRegions.pop_back();
+			}
+			Region &region = regions[i];
+			region.parent = i;
+			region.label = label;
+			region.lastRow = NONE;
+			region.start = std::make_pair(y, x);
+			region.area = 0;
+			region.hue = region.saturation = region.brightness = 0;
+			region.points.clear();
+			region.hullSize = 0;
+			return i;
+		}
+
+		void freeRegion(size_t i) {
+			regions[i].points.clear();
+			freeRegions.push_back(i);
+		}
+
+	// Merge two regions, given by their roots, into the one with more points, and
+	// return that one
+		size_t mergeRegions(size_t a, size_t b) {
+			if(a == b)
+				return a;
+			if(regions[a].points.size() < regions[b].points.size())
+				std::swap(a, b);
+			Region &root = regions[a], &child = regions[b];
+			root.start = std::min(root.start, child.start);
+			root.area += child.area;
+			root.hue += child.hue;
+			root.saturation += child.saturation;
+			root.brightness += child.brightness;
+			root.points.insert(root.points.end(), child.points.begin(), child.points.end());
+			root.hullSize += child.hullSize;
+			child.points.clear();
+			child.parent = a;
+			mergedRegions.push_back(b);
+			return a;
+		}
+
+		void addRun(Region &region, const Run &run, size_t y) {
+			region.area += run.x1 - run.x0 + 1;
+			region.hue += run.hue;
+			region.saturation += run.saturation;
+			region.brightness += run.brightness;
+			region.points.push_back(Point((double)run.x0, (double)y));
+			region.points.push_back(Point((double)run.x1, (double)y));
+			if(region.points.size() >= 2 * region.hullSize + 64) {
+				convexHull(region.points.data(), region.points.data() + region.points.size(),
+						   hull);
+				region.points.swap(hull);
+				region.hullSize = region.points.size();
+			}
+		}
+
+		void finishRegion(size_t i) {
+			Region &region = regions[i];
+			Contour contour;
+			contour.color = region.label - 1;
+			contour.area = region.area;
+			contour.hue = region.hue / region.area;
+			contour.saturation = region.saturation / region.area;
+			contour.brightness = region.brightness / region.area;
+			convexHull(region.points.data(), region.points.data() + region.points.size(),
+					   contour.hull);
+			finished.push_back(std::move(contour));
+			starts.push_back(region.start);
+			freeRegion(i);
+		}
+	};
+
+	Image() = default;
+
+// Find the outer contours of the 8-connected regions of each of the colors in an
+// image file, ordered by color and then smallest first. The image is read a band
+// of rows at a time, and each band is cut into tiles that are labelled in
+// parallel, so that very large images take bounded memory. Runs that meet at
+// the edges of tiles are joined, and regions are followed from one band into the
+// next, so the contours are the same however the image is tiled. Returns false,
+// having reported it, if the image cannot be read.
+	static bool findContours(const std::string &fileName, const std::vector<ColorRange> &colors,
+							 std::vector<Contour> &contours, bool parallel = true,
+							 size_t tileSize = 512) {
+		struct Tile {
+			Image image;
+			std::vector<uint8_t> labels;
+			std::vector<std::vector<Run>> rows;
+		};
+		std::vector<Tile> tiles;
+		std::vector<Run> row;
+		RegionFinder regionFinder;
+		bool read = SolveSpace::Pixmap::ReadPngBands(
+				SolveSpace::Platform::Path::From(fileName), tileSize,
+				[&](const SolveSpace::Pixmap &band, size_t y) {
+			TRACE_SCOPE("Image::findContours", (uint32_t)y);
+			tiles.resize((band.width + tileSize - 1) / tileSize);
+			auto labelTile = [&](size_t i) {
+				Tile &tile = tiles[i];
+				size_t x0 = i * tileSize;
+				tile.image.convertRGB2HSV(band, x0, std::min(tileSize, band.width - x0));
+				tile.image.getLabelImage(tile.labels, colors);
+				tile.image.findRuns(tile.labels, x0, tile.rows);
+			};
+			if(parallel) {
+				SolveSpace::ParallelFor(tiles.size(), labelTile);
+			} else {
+				for(size_t i = 0; i < tiles.size(); i++)
+					labelTile(i);
+			}
+
+		// Put the runs of each row back together across the tiles
+			for(size_t r = 0; r < band.height; r++) {
+				row.clear();
+				std::vector<Tile>::iterator tile = tiles.begin();
+				while(tile != tiles.end()) {
+					std::vector<Run>::iterator run = tile->rows[r].begin();
+					while(run != tile->rows[r].end()) {
+						if(!row.empty() && row.back().x1 + 1 == run->x0 &&
+								row.back().label == run->label) {
+							row.back().x1 = run->x1;
+							row.back().hue += run->hue;
+							row.back().saturation += run->saturation;
+							row.back().brightness += run->brightness;
+						} else {
+							row.push_back(*run);
+						}
+						run++;
+					}
+					tile++;
+				}
+				regionFinder.addRow(y + r, row);
+			}
+		});
+		if(!read) {
+			PANELIZE_LOG(ERRORS, "Error: Could not read image file " << fileName << "\n");
+			return false;
+		}
+		regionFinder.finish(contours);
+		return true;
+	}
+
+// Take the columns of a pixmap from x0, tileWidth of them, as this image
+	void convertRGB2HSV(const SolveSpace::Pixmap &pixmap, size_t x0, size_t tileWidth) {
+		width = tileWidth;
+		height = pixmap.height;
+		hsv.resize(width * height * 3);
+		size_t bpp = pixmap.GetBytesPerPixel();
+		bool bgr = (pixmap.format == SolveSpace::Pixmap::Format::BGR ||
+					pixmap.format == SolveSpace::Pixmap::Format::BGRA);
+		for(size_t y = 0; y < height; y++) {
+			const uint8_t *src = &pixmap.data[y * pixmap.stride + x0 * bpp];
+			uint8_t *dst = &hsv[y * width * 3];
+			for(size_t x = 0; x < width; x++, src += bpp, dst += 3) {
+				if(bpp < 3) {
+					convertRGB2HSV(src[0], src[0], src[0], dst);
+				} else if(bgr) {
+					convertRGB2HSV(src[2], src[1], src[0], dst);
+				} else {
+					convertRGB2HSV(src[0], src[1], src[2], dst);
+				}
+			}
+		}
+	}
+
+// Same conversion as OpenCV does for 8-bit images, so that color ranges tuned
+// with it still work.
+	static void convertRGB2HSV(uint8_t r, uint8_t g, uint8_t b, uint8_t *out) {
+		int max = std::max(r, std::max(g, b));
+		int min = std::min(r, std::min(g, b));
+		int diff = max - min;
+		double h = 0;
+		if(diff != 0) {
+			if(max == r) {
+				h = 60.0 * (g - b) / diff;
+			} else if(max == g) {
+				h = 120.0 + 60.0 * (b - r) / diff;
+			} else {
+				h = 240.0 + 60.0 * (r - g) / diff;
+			}
+			if(h < 0)
+				h += 360;
+		}
+		out[0] = (uint8_t)(std::lround(h / 2) % 180);
+		out[1] = (uint8_t)(max ? std::lround(255.0 * diff / max) : 0);
+		out[2] = (uint8_t)max;
+	}
+
+// Label every pixel with the first of the colors whose range it is in, as the
+// index of the color plus one, or 0 if it is in none. The ranges are boxes in
+// HSV, so the colors a pixel is in are those allowed by its hue, by its
+// saturation and by its brightness alike; we look each of these up as a
+// bitmask of colors, which takes one pass over the image for all colors.
+	void getLabelImage(std::vector<uint8_t> &labels,
+					   const std::vector<ColorRange> &colors) const {
+		if(colors.size() > 32) {
+			PANELIZE_LOG(ERRORS, "Error: Too many wall colors\n");
+			exit(-1);
+		}
+		uint32_t hueColors[256] = {}, saturationColors[256] = {}, brightnessColors[256] = {};
+		for(size_t i = 0; i < colors.size(); i++) {
+			uint32_t bit = 1u << i;
+			const ColorRange &color = colors[i];
+			for(int value = color.lowH; value <= color.highH; value++)
+				hueColors[value] |= bit;
+			for(int value = color.lowS; value <= color.highS; value++)
+				saturationColors[value] |= bit;
+			for(int value = color.lowV; value <= color.highV; value++)
+				brightnessColors[value] |= bit;
+		}
+
+		labels.resize(width * height);
+		const uint8_t *pixel = hsv.data();
+		for(size_t i = 0; i < width * height; i++, pixel += 3) {
+			uint32_t inColors = hueColors[pixel[0]] & saturationColors[pixel[1]]
+										& brightnessColors[pixel[2]];
+			uint8_t label = 0;
+			if(inColors) {
+				label = 1;
+				while(!(inColors & 1)) {
+					inColors >>= 1;
+					label++;
+				}
+			}
+			labels[i] = label;
+		}
+	}
+
+// Find the runs of each row of labels but 0, with their columns counted from x0
+	void findRuns(const std::vector<uint8_t> &labels, size_t x0,
+				  std::vector<std::vector<Run>> &rows) const {
+		rows.resize(height);
+		for(size_t y = 0; y < height; y++) {
+			rows[y].clear();
+			const uint8_t *row = &labels[y * width];
+			const uint8_t *pixel = &hsv[y * width * 3];
+			size_t x = 0;
+			while(x < width) {
+				if(!row[x]) {
+					x++;
+					continue;
+				}
+				Run run = { x0 + x, x0 + x, row[x], 0, 0, 0 };
+				while(x < width && row[x] == run.label) {
+					run.hue += pixel[x * 3];
+					run.saturation += pixel[x * 3 + 1];
+					run.brightness += pixel[x * 3 + 2];
+					run.x1 = x0 + x++;
+				}
+				rows[y].push_back(run);
+			}
+		}
+	}
+
+// Andrew's monotone chain; the hull comes out counter-clockwise
+	static void convexHull(Point *first, Point *last, std::vector<Point> &hull) {
+		std::sort(first, last, [](const Point &a, const Point &b) {
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		});
+		auto cross = [](const Point &o, const Point &a, const Point &b) {
+			return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+		};
+		hull.clear();
+		size_t n = last - first;
+		if(n < 3) {
+			hull.assign(first, last);
+			return;
+		}
+		hull.resize(2 * n);
+		size_t k = 0;
+		for(size_t i = 0; i < n; i++) {
+			while(k >= 2 && cross(hull[k - 2], hull[k - 1], first[i]) <= 0)
+				k--;
+			hull[k++] = first[i];
+		}
+		for(size_t i = n - 1, t = k + 1; i > 0; i--) {
+			while(k >= t && cross(hull[k - 2], hull[k - 1], first[i - 1]) <= 0)
+				k--;
+			hull[k++] = first[i - 1];
+		}
+		hull.resize(k - 1);
+	}
+};
+
+// How panels are fitted to a wall. The best fit leaves the least of the wall
+// uncovered, and uses the fewest panels among those that do. Fits that leave
+// at most maxWaste uncovered all count as perfect, so then the fewest panels
+// win outright.
+struct FitOptions {
+// Wall and panel lengths are rounded to multiples of this before fitting
+	double resolution = 0.01;
+	double maxWaste = 0;
+};
+
+// Runs the stages of Processor one at a time, to time them; see bench/panelize.cpp
+class ProcessorBenchmark;
+
 // Most of the functions of Processor are private so outside functions or
 // classes cannot directly use it. If any function that involves interaction
 // with the front-end could be added under public acess-modifier.
 class Processor {
 private:
+	friend class ProcessorBenchmark;
+
 // Wall list
-	std::vector<Wall *> wallList;
+	std::vector<Wall> wallList;
+
+// List of valid wall colors
+	std::vector<ColorRange> validColorList;
 
 	struct PanelInfo {
 	private:
@@ -365,43 +973,282 @@ private:
 // List of panels
 	std::vector<PanelInfo> panelList;
 
+// Number of panels of one width in a fit
+	struct PanelCount {
+		double width;
+		uint32_t numPanels;
+	};
+
+// How to fit panels to walls
+	FitOptions fitOptions;
+
+// Length of a pixel of the image, in the units of the panel widths
+	double scale = 1;
+
+// A fit of panels to walls of one length, shared by all of those walls
+	struct CachedFit {
+		std::shared_ptr<const std::vector<Panel>> panelList;
+		double coveredLength;
+	};
+
+// Fits already computed, by the wall length in units of fitOptions.resolution
+// and by the hash of the panel widths and options they were computed with.
+// The processors of a batch share one, so it is guarded by a mutex.
+	struct FitCache {
+		std::mutex mutex;
+		std::map<std::pair<size_t, uint64_t>, CachedFit> fits;
+	};
+	std::shared_ptr<FitCache> fitCache = std::make_shared<FitCache>();
+
+// Processors for batches are set up by processImages
+	Processor() {}
+
+// Set up to process one image of a batch, with the colors, panels, options and
+// fit cache of the batch
+	Processor(const Processor &batch, double scale) {
+		validColorList = batch.validColorList;
+		panelList = batch.panelList;
+		fitOptions = batch.fitOptions;
+		fitCache = batch.fitCache;
+		this->scale = scale;
+	}
+
+// Process one image of a batch. Tiles and fits are not parallelized here, as
+// the images are. Returns false if the image cannot be read.
+	bool processBatchImage(const std::string &imageName, bool cornerSelection,
+						   double noiseThreshold) {
+		if(!detectWalls(imageName, cornerSelection, /*parallel=*/false))
+			return false;
+		filterNoise(scale, noiseThreshold, cornerSelection);
+		computeNumPanelsBestFit(/*parallel=*/false);
+		return true;
+	}
+
 public:
 	Processor(const std::string &imageName,
 			  const std::string &panelListFileName, double scale, 
 			  bool cornerSelection = false, double noiseThreshold = 5,
-			  const std::string &outputFileName = std::string()) {
-		std::cout << "PROCESSOR\n";
-	// Invoke the python script to get the wall data in a file
-		std::string outputFile = imageName + ".csv";
-		runProcessorScript(imageName, outputFile, cornerSelection);
-		
-	// Now that the file has been written to, develop a tree of wall and panels info
-		readOutputFile(outputFile, cornerSelection);
-		
+			  const std::string &outputFileName = std::string(),
+			  const FitOptions &fitOptions = FitOptions()) {
+		PANELIZE_LOG(INFO, "PROCESSOR\n");
+		this->fitOptions = fitOptions;
+		this->scale = scale;
+		addDefaultColors();
+
+	// Detect the walls in the image
+		if(!detectWalls(imageName, cornerSelection))
+			exit(-1);
+
 	// Get the list of available panels
 		getPanels(panelListFileName);
 		
 	// Filter out the noise
-		std::cout << "FILTERING NOISE\n";
+		PANELIZE_LOG(INFO, "FILTERING NOISE\n");
 		filterNoise(scale, noiseThreshold, cornerSelection);
 
 	// Compute panels needed for given wall layout
-		printAvailablePanels();
+		if(logEnabled(LogLevel::DEBUG))
+			printAvailablePanels();
 		computeNumPanelsBestFit();
-		//mergeRepetitivePanels();
 
 	// Write data to output file
 		writeToFile(outputFileName, imageName);
 
 	// Print Walls and panels
-		printWallList();
+		if(logEnabled(LogLevel::DEBUG))
+			printWallList();
+	}
+
+// Process a number of images with the same panels, and write the walls of all
+// of them to one output file, in the order the images are given. The images
+// are processed in parallel, and each is written out as soon as those before
+// it have been, so only the images in flight are held in memory. An image that
+// cannot be read is reported and skipped, and the rest are still processed.
+// Returns false if any image was skipped, or the output file cannot be written.
+	static bool processImages(const std::vector<std::string> &imageNames,
+							  const std::string &panelListFileName, double scale,
+							  const std::string &outputFileName,
+							  bool cornerSelection = false, double noiseThreshold = 5,
+							  const FitOptions &fitOptions = FitOptions()) {
+		Processor batch;
+		batch.fitOptions = fitOptions;
+		batch.addDefaultColors();
+		batch.getPanels(panelListFileName);
+
+		std::ofstream outputFile(outputFileName);
+		if(!outputFile) {
+			PANELIZE_LOG(ERRORS, "Cannot write output file " << outputFileName << "\n");
+			return false;
+		}
+		outputFile << "Image,Wall Length (ft),Wall Width (ft),Wall Height (ft),"
+					  "Panel Width (ft),Number of Panels" << std::endl;
+
+		std::vector<std::unique_ptr<Processor>> processors(imageNames.size());
+		std::vector<char> skipped(imageNames.size());
+		std::mutex writeMutex;
+		size_t nextToWrite = 0;
+		SolveSpace::ParallelFor(imageNames.size(), [&](size_t i) {
+			TRACE_SCOPE("Processor::processImages", (uint32_t)i);
+			std::unique_ptr<Processor> processor(new Processor(batch, scale));
+			bool processed =
+				processor->processBatchImage(imageNames[i], cornerSelection, noiseThreshold);
+
+		// Write out every image that is done and has nothing before it left
+			std::lock_guard<std::mutex> lock(writeMutex);
+			if(processed) {
+				processors[i] = std::move(processor);
+			} else {
+				PANELIZE_LOG(ERRORS, "Skipping image " << imageNames[i] << "\n");
+				skipped[i] = true;
+			}
+			while(nextToWrite < processors.size() &&
+				  (processors[nextToWrite] || skipped[nextToWrite])) {
+				if(processors[nextToWrite]) {
+					std::string imageName =
+						Platform::Path::From(imageNames[nextToWrite]).FileName();
+					processors[nextToWrite]->writeWalls(outputFile, imageName);
+					processors[nextToWrite].reset();
+				}
+				nextToWrite++;
+			}
+		});
+
+		outputFile.close();
+		bool anySkipped = std::find(skipped.begin(), skipped.end(), true) != skipped.end();
+		return !outputFile.fail() && !anySkipped;
+	}
+
+// Process all of the PNG images in a directory, in order of their names
+	static bool processDirectory(const std::string &directoryName,
+								 const std::string &panelListFileName, double scale,
+								 const std::string &outputFileName,
+								 bool cornerSelection = false, double noiseThreshold = 5,
+								 const FitOptions &fitOptions = FitOptions()) {
+		std::vector<std::string> imageNames = listImages(directoryName);
+		if(imageNames.empty()) {
+			PANELIZE_LOG(ERRORS, "No images found in " << directoryName << "\n");
+			return false;
+		}
+		return processImages(imageNames, panelListFileName, scale, outputFileName,
+							 cornerSelection, noiseThreshold, fitOptions);
 	}
 
 // Get data collected by Processor
-	const std::vector<Wall *> &getWallList() const {
+	const std::vector<Wall> &getWallList() const {
 		return wallList;
 	}
 
+// Add the walls, and the panels fitted to them, to the sketch in a new group in
+// the XY plane, after all of the others. Each wall is drawn as a construction
+// rectangle, and its panels as lines laid end to end down the middle of it.
+// Lengths in the units of the panel widths are mmPerUnit long in the sketch;
+// by default, they are feet. Every point is locked where it was detected, so
+// the group solves one equation at a time, without a big system to solve; the
+// points at the ends of neighbouring lines are not made coincident, since the
+// solver would substitute each such pair through every equation.
+	SolveSpace::hGroup addToSketch(double mmPerUnit = 304.8) const {
+		using namespace SolveSpace;
+		TRACE_SCOPE("Processor::addToSketch");
+		SS.UndoRemember();
+
+		hGroup hg = Group::AddWorkplaneGroup("panels");
+		hEntity workplane = hg.entity(0);
+
+	// Count what we are going to add, so that each list grows just once
+		size_t numLines = 0;
+		std::vector<Wall>::const_iterator wall = wallList.begin();
+		while(wall != wallList.end()) {
+			numLines += 4;
+			const std::vector<Panel> &panelList = wall->getBestFitPanelList();
+			std::vector<Panel>::const_iterator panel = panelList.begin();
+			while(panel != panelList.end()) {
+				numLines += (size_t)panel->getNumPanels();
+				panel++;
+			}
+			wall++;
+		}
+		SK.request.ReserveMore((int)numLines);
+		SK.constraint.ReserveMore((int)(2 * numLines));
+		std::vector<Param> params;
+		params.reserve(4 * numLines);
+
+	// The image has y down, and the sketch y up
+		double mmPerPixel = scale * mmPerUnit;
+		auto toSketch = [&](const Point &point) {
+			return Vector::From(point.x * mmPerPixel, -point.y * mmPerPixel, 0);
+		};
+		auto addLine = [&](Vector a, Vector b, bool construction) {
+			Request r = {};
+			r.group = hg;
+			r.workplane = workplane;
+			r.type = Request::Type::LINE_SEGMENT;
+			r.construction = construction;
+			hRequest hr = SK.request.AddAndAssignId(&r);
+
+		// Give the points their positions as params, which the regeneration will
+		// take up, and lock them there
+			Vector ends[2] = { a, b };
+			for(int i = 0; i < 2; i++) {
+				Param pu = {}, pv = {};
+				pu.h = hr.param(16 + 3 * i + 0);
+				pu.val = ends[i].x;
+				pv.h = hr.param(16 + 3 * i + 1);
+				pv.val = ends[i].y;
+				params.push_back(pu);
+				params.push_back(pv);
+
+				Constraint c = {};
+				c.group = hg;
+				c.workplane = workplane;
+				c.type = Constraint::Type::WHERE_DRAGGED;
+				c.ptA = hr.entity(1 + i);
+				SK.constraint.AddAndAssignId(&c);
+			}
+		};
+
+		wall = wallList.begin();
+		while(wall != wallList.end()) {
+			const std::vector<Point> &rect = wall->getRectPoints();
+			for(size_t i = 0; i < rect.size(); i++) {
+				addLine(toSketch(rect[i]), toSketch(rect[(i + 1) % rect.size()]), true);
+			}
+
+		// The panels start from the middle of one of the short sides
+			if(rect.size() == 4) {
+				Vector corner[4];
+				for(int i = 0; i < 4; i++)
+					corner[i] = toSketch(rect[i]);
+				Vector start = corner[0].Plus(corner[3]).ScaledBy(0.5),
+					   end = corner[1].Plus(corner[2]).ScaledBy(0.5);
+				if(corner[0].Minus(corner[1]).Magnitude() <
+						corner[1].Minus(corner[2]).Magnitude()) {
+					start = corner[0].Plus(corner[1]).ScaledBy(0.5);
+					end = corner[3].Plus(corner[2]).ScaledBy(0.5);
+				}
+				Vector along = end.Minus(start).WithMagnitude(1);
+				const std::vector<Panel> &panelList = wall->getBestFitPanelList();
+				std::vector<Panel>::const_iterator panel = panelList.begin();
+				while(panel != panelList.end()) {
+					Vector step = along.ScaledBy(panel->getWidth() * mmPerUnit);
+					for(uint32_t k = 0; k < (uint32_t)panel->getNumPanels(); k++) {
+						addLine(start, start.Plus(step), false);
+						start = start.Plus(step);
+					}
+					panel++;
+				}
+			}
+			wall++;
+		}
+		if(!params.empty())
+			SK.param.AddMany(params.data(), (int)params.size());
+
+		SK.GetGroup(hg)->dofCheckOk = false;
+		SS.MarkGroupDirty(hg);
+		SS.GenerateAll();
+		SK.GetGroup(hg)->Activate();
+		return hg;
+	}
+
 // Print panel list
 	void printAvailablePanels() {
 		std::cout << "||||||||||||||| PRINTING AVAILABLE PANELS |||||||||||||||||\n";
@@ -419,122 +1266,136 @@ public:
 // Print wall list
 	void printWallList() {
 		std::cout << "=================== PRINTING WALL LIST ===================\n";
-		std::vector<Wall *>::iterator it = wallList.begin();
+		std::vector<Wall>::iterator it = wallList.begin();
 		while(it != wallList.end()) {
-			(*it)->printWallInfo();
+			it->printWallInfo();
 			it++;
 		}
 		std::cout << "==========================================================\n";
 	}
 
 private:
-	void runProcessorScript(const std::string &imageName, 
-							const std::string &outputFileName,
- 							bool cornerSelection) const {	
-	// Run a python script too get all the wall data into a csv file
-		char command[1024] = {0};
-		if(!cornerSelection) {
-			sprintf(command, "python imageProcTest.py --image %s --output %s\n", 
-								 imageName.c_str(), outputFileName.c_str());
-		} else {
-			sprintf(command, "python imageProcTest.py --image %s --output %s --corner True\n", 
-								 imageName.c_str(), outputFileName.c_str());
+// WARNING: A few colors are hard coded. Make sure these colors work
+	void addDefaultColors() {
+		addColor(72, 180, 72, 255, 0, 255);   // Blue
+		addColor(18, 56, 0, 255, 0, 255);     // Yellow
+	}
+
+// Paths of the PNG images in a directory, sorted by name
+	static std::vector<std::string> listImages(const std::string &directoryName) {
+		Platform::Path directory = Platform::Path::From(directoryName);
+		std::vector<std::string> imageNames;
+#if defined(WIN32)
+		WIN32_FIND_DATAW wfd;
+		HANDLE h = FindFirstFileW(Platform::Widen(directory.Join("*").raw).c_str(), &wfd);
+		if(h != INVALID_HANDLE_VALUE) {
+			do {
+				Platform::Path path = directory.Join(Platform::Narrow(wfd.cFileName));
+				if(!(wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+						path.HasExtension("png")) {
+					imageNames.push_back(path.raw);
+				}
+			} while(FindNextFileW(h, &wfd));
+			FindClose(h);
+		}
+#else
+		DIR *dir = opendir(directory.raw.c_str());
+		if(dir) {
+			while(struct dirent *entry = readdir(dir)) {
+				Platform::Path path = directory.Join(entry->d_name);
+				if(entry->d_name[0] != '.' && path.HasExtension("png"))
+					imageNames.push_back(path.raw);
+			}
+			closedir(dir);
 		}
-		std::cout << "COMMAND: " << command << "\n";
-		system(command);
+#endif
+		std::sort(imageNames.begin(), imageNames.end());
+		return imageNames;
 	}
-	
-	void readOutputFile(const std::string &outputFileName, bool cornerSelection) {
-		std::cout << "OUTPUT FILE NAME: " << outputFileName << "\n";
-	// Open the output file and read it
-		std::ifstream outfile(outputFileName);
-		std::string line;
-		while(std::getline(outfile, line)) {
-			std::cout << "LINE: " << line << "\n";
-			size_t index = 2;
-			
-		// Allocate a wall
-			uint8_t hue = (uint8_t)getNumber(',', index, line);
-			index += 2;
-			uint8_t sat = (uint8_t)getNumber(',', index, line);
-			index += 2;
-			uint8_t val = (uint8_t)getNumber(')', index, line);
-			printf("HUE: %d\n", hue);
-			printf("SAT: %d\n", sat);
-			printf("VAL: %d\n", val);
-			//std::cout << "HUE: " << hue << "\n";
-			//std::cout << "SAT: " << sat << "\n";
-			//std::cout << "VAL: " << val << "\n";
-			Wall *wall = allocateWall(hue, sat, val);
-			
-		// Get its vertices
-			index += 5;
-			double x1 = getNumber(',', index, line);
-			index += 2;
-			double y1 = getNumber(')', index, line);
-			printf("x1: %lf\n", x1);
-			printf("y1: %lf\n", y1);
-			index += 5;
-			double x2 = getNumber(',', index, line);
-			index += 2;
-			double y2 = getNumber(')', index, line);
-			printf("x2: %lf\n", x2);
-			printf("y2: %lf\n", y2);
+
+// API to add colors to valid colors list
+	void addColor(uint8_t lowH, uint8_t highH, uint8_t lowS, uint8_t highS,
+				  uint8_t lowV, uint8_t highV) {
+		validColorList.push_back(ColorRange(lowH, highH, lowS, highS, lowV, highV));
+	}
+
+// Returns false if the image cannot be read
+	bool detectWalls(const std::string &imageName, bool cornerSelection,
+					 bool parallel = true) {
+		PANELIZE_LOG(INFO, "IMAGE NAME: " << imageName << "\n");
+
+	// Find the regions of all valid colors at once, and box them to get the walls
+		std::vector<Contour> contours;
+		if(!Image::findContours(imageName, validColorList, contours, parallel))
+			return false;
+		boxContours(contours, cornerSelection);
+		return true;
+	}
+
+	void boxContours(const std::vector<Contour> &contours, bool cornerSelection) {
+		wallList.reserve(wallList.size() + contours.size());
+		std::vector<Contour>::const_iterator contour = contours.begin();
+		while(contour != contours.end()) {
+			Wall wall((uint8_t)lround(contour->hue),
+					  (uint8_t)lround(contour->saturation),
+					  (uint8_t)lround(contour->brightness));
+
+		// Get the rectangle points and add them to the wall
+			Point rectPoints[4];
+			minAreaRect(contour->hull, rectPoints);
+			wall.setRectPoints(rectPoints);
+			double side1 = euclideanDistance(rectPoints[0], rectPoints[1]);
+			double side2 = euclideanDistance(rectPoints[1], rectPoints[2]);
 			if(!cornerSelection) {
-			// If the corners are not selected, then there must be 2 more vertices left	
-				index += 5;
-				double x3 = getNumber(',', index, line);
-				index += 2;
-				double y3 = getNumber(')', index, line);
-				printf("x3: %lf\n", x3);
-				printf("y3: %lf\n", y3);
-				index += 5;
-				double x4 = getNumber(',', index, line);
-				index += 2;
-				double y4 = getNumber(')', index, line);
-				printf("x4: %lf\n", x4);
-				printf("y4: %lf\n", y4);
-				
-			// Find the sides of the walls. 2 must be sides and 1 must be the diagonal
-				double length1 = euclideanDistance(x1, y1, x2, y2);
-				std::cout << "LENGTH1: " << length1 << "\n";
-				double length2 = euclideanDistance(x1, y1, x3, y3);
-				std::cout << "LENGTH2: " << length2 << "\n";
-				double length3 = euclideanDistance(x1, y1, x4, y4);
-				std::cout << "LENGTH3: " << length3 << "\n";
-				if(length1 > length2 && length1 > length3) {
-				// Length1 is a diagonal
-					wall->setRectSides(length2, length3);
-				} else {
-					if(length2 > length1 && length2 > length3) {
-					// Length2 is a diagonal
-						wall->setRectSides(length1, length3);
-					} else {
-					// Length3 is a diagonal
-						wall->setRectSides(length1, length2);
-					}
-				}
+				wall.setRectSides(side1, side2);
 			} else {
-			// Set the length of the allocated wall
-				double length = euclideanDistance(x1, y1, x2, y2);
-				wall->setRectSide(length);
+			// The wall runs along the longer side of the rectangle
+				wall.setRectSide(std::max(side1, side2));
 			}
-			
-			wallList.push_back(wall);
+
+			wallList.push_back(std::move(wall));
+			contour++;
 		}
 	}
-	
-	double getNumber(char stopChar, size_t &index, const std::string line) const {
-		std::cout << "INDEX: " << index << "\n";
-		std::cout << "START LINE CHAR: " << line[index] << "\n";
-		char number[1024] = {0};
-		int i= 0;
-		while(line[index] != stopChar) {
-			std::cout << line[index] << " ";
-			number[i++] = line[index++];
+
+// Smallest rectangle around a convex hull. One of its sides must be on an edge
+// of the hull, so we try each edge in turn.
+	void minAreaRect(const std::vector<Point> &hull, Point rect[4]) const {
+		if(hull.empty()) {
+			std::fill(rect, rect + 4, Point());
+			return;
+		}
+		double bestArea = -1;
+		for(size_t i = 0; i < hull.size(); i++) {
+			const Point &a = hull[i], &b = hull[(i + 1) % hull.size()];
+			double len = euclideanDistance(a, b);
+			double ux = 1, uy = 0;
+			if(len > 0) {
+				ux = (b.x - a.x) / len;
+				uy = (b.y - a.y) / len;
+			}
+			double minU = 0, maxU = 0, minV = 0, maxV = 0;
+			std::vector<Point>::const_iterator p = hull.begin();
+			while(p != hull.end()) {
+				double u = (p->x - a.x) * ux + (p->y - a.y) * uy;
+				double v = (p->y - a.y) * ux - (p->x - a.x) * uy;
+				minU = std::min(minU, u);
+				maxU = std::max(maxU, u);
+				minV = std::min(minV, v);
+				maxV = std::max(maxV, v);
+				p++;
+			}
+			double area = (maxU - minU) * (maxV - minV);
+			if(bestArea < 0 || area < bestArea) {
+				bestArea = area;
+				double us[4] = { minU, maxU, maxU, minU };
+				double vs[4] = { minV, minV, maxV, maxV };
+				for(int k = 0; k < 4; k++) {
+					rect[k] = Point(a.x + us[k] * ux - vs[k] * uy,
+									a.y + us[k] * uy + vs[k] * ux);
+				}
+			}
 		}
-		std::cout << "\n";
-		return atof(number);
 	}
 	
 	double euclideanDistance(double x1, double y1, double x2, double y2) const {
@@ -542,460 +1403,268 @@ private:
 		double sq_diff_y = (y1 - y2) * (y1 - y2);
 		return sqrt(sq_diff_x + sq_diff_y);
 	}
+
+	double euclideanDistance(const Point &point1, const Point &point2) const {
+		return euclideanDistance(point1.x, point1.y, point2.x, point2.y);
+	}
 	
 	void addPanel(double width, double height = 0) {
 		PanelInfo panel(width, height);
 		panelList.push_back(panel);
 	}
 
-	void getPanels(const std::string panelListFileName) {
-	// Check if the panelListFileName is not valid
-		if(panelListFileName.empty()) {
-			std::cout << "Panel List File Invalid\n";
+	void getPanels(const std::string &panelListFileName) {
+	// Check that the panel list is named, and is a CSV file
+		CsvReader csv;
+		if(panelListFileName.empty()
+		|| !SolveSpace::Platform::Path::From(panelListFileName).HasExtension("csv")
+		|| !csv.open(panelListFileName)) {
+			PANELIZE_LOG(ERRORS, "Panel List File Invalid\n");
 			exit(-1);
 		}
 
-	// Exit if the panelListName does not have a .csv extension
-		std::string fileName = panelListFileName;
-		std::string::iterator it = fileName.begin();
-		std::string::iterator dot_it = it;
-		while(it != fileName.end()) {
-			if(*it == '.')
-				dot_it = it;
-			it++;
+	// Search for the panel width column, under a header such as "Panel Width",
+	// "PanelWidth", "panel_width" or "PANEL WIDTH (ft)"
+		std::vector<CsvReader::Field> fields;
+		size_t column = 0;
+		bool columnFound = false;
+		while(!columnFound && csv.nextRecord(fields)) {
+			for(column = 0; column < fields.size(); column++) {
+				if(CsvReader::fieldContains(fields[column], "panelwidth")) {
+					columnFound = true;
+					break;
+				}
+			}
 		}
-
-	// Check the extension
-		it = dot_it;
-		if(*(it + 1) != 'c'
-		|| *(it + 2) != 's'
-		|| *(it + 3) != 'v') {
-			std::cout << "Panel List File Invalid\n";
+		if(columnFound == false) {
+			PANELIZE_LOG(ERRORS, "Error: No panels specified in file or the panel"
+								 << "column not named as expected.\n");
 			exit(-1);
 		}
 
-	// File is sane. Read the panel list and collect the information. Open file.
-		std::ifstream infile(panelListFileName);
-		std::string line;
-		uint32_t numCommas = 0;
-		bool columnFound = false;
-		while(std::getline(infile, line)) {
-			if(columnFound == true) {
-			// Read the line to get the panel width
-				std::stringstream stream(line);
-				double panelWidth = 0;
-				uint32_t col = 0;	
-				while(col++ <= numCommas) {
-					stream >> panelWidth;
-					std::cout << "READ PANEL WIDTH: " << panelWidth << "\n";
-				}
-					
-			// Add panel to the panel list	
+	// Read the panel widths from the rest of the file, skipping blank fields
+		while(csv.nextRecord(fields)) {
+			double panelWidth;
+			if(column < fields.size() && CsvReader::parseNumber(fields[column], &panelWidth)) {
+				PANELIZE_LOG(DEBUG, "READ PANEL WIDTH: " << panelWidth << "\n");
 				addPanel(panelWidth);
-				continue;
-			}
-			
-		// Search for "Panel Width", "PanelWidth", "Panel width", "panel width", 
-		// "PANEL WIDTH", "PANEL_WIDTH", "panelWidth", or "panel_width". 
-		// Once found -- if found, we count the number of commas precede the string.
-			size_t pos = line.find("Panel Width");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
-			}
-			pos = line.find("PanelWidth");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
-			}
-			pos = line.find("Panel width");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
-			}
-			pos = line.find("panel width");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
-			}
-			pos = line.find("PANEL WIDTH");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
-			}
-			pos = line.find("PANEL_WIDTH");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
 			}
-			pos = line.find("panel_width");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
-			}
-			pos = line.find("panelWidth");
-			if(pos != std::string::npos) {
-				numCommas = numCharBeforePos(',', pos, line);
-				columnFound = true;
-				continue;
+		}
+	}
+
+	void computeNumPanelsBestFit(bool parallel = true) {
+		std::vector<size_t> widths = panelWidthsInUnits();
+		uint64_t catalogue = hashFit(widths);
+
+	// Collect the wall lengths that have no fit yet. Walls of the same length, to
+	// the resolution, get the same fit, so each is computed once.
+		std::vector<size_t> lengths;
+		{
+			std::lock_guard<std::mutex> lock(fitCache->mutex);
+			std::vector<Wall>::iterator wall = wallList.begin();
+			while(wall != wallList.end()) {
+				std::pair<size_t, uint64_t> key(lengthInUnits(wall->getLength()), catalogue);
+				if(fitCache->fits.find(key) == fitCache->fits.end())
+					lengths.push_back(key.first);
+				wall++;
 			}
 		}
-		if(columnFound == false) {
-			std::cout << "Error: No panels specified in file or the panel"
-					  << "column not named as expected.\n";
-			exit(-1);
+		std::sort(lengths.begin(), lengths.end());
+		lengths.erase(std::unique(lengths.begin(), lengths.end()), lengths.end());
+
+	// The fits are independent of each other, so they can be computed in parallel
+		std::vector<CachedFit> fits(lengths.size());
+		auto fitLength = [&](size_t i) {
+			std::vector<PanelCount> fit;
+			size_t covered = fitPanels(lengths[i], widths, fit);
+
+			std::shared_ptr<std::vector<Panel>> panelList =
+				std::make_shared<std::vector<Panel>>();
+			panelList->reserve(fit.size());
+			std::vector<PanelCount>::iterator it = fit.begin();
+			while(it != fit.end()) {
+				Panel panel(it->width);
+				panel.incrementNumPanels(it->numPanels);
+				panelList->push_back(panel);
+				it++;
+			}
+			fits[i].panelList = panelList;
+			fits[i].coveredLength = covered * fitOptions.resolution;
+		};
+		if(parallel) {
+			SolveSpace::ParallelFor(lengths.size(), fitLength);
+		} else {
+			for(size_t i = 0; i < lengths.size(); i++)
+				fitLength(i);
 		}
-	}
-	
-	uint32_t numCharBeforePos(char search_char, size_t stop_pos, 
-							  const std::string &line) const {
-		uint32_t numCommas = 0;
-		size_t index = 0;
-		while(index != stop_pos) {
-			if(line[index] == ',')
-				numCommas++;
-			index++;
+
+		std::lock_guard<std::mutex> lock(fitCache->mutex);
+	// Another processor of the batch may have fitted some of these lengths in the
+	// meantime. Fits are deterministic, so we keep whichever was cached first.
+		for(size_t i = 0; i < lengths.size(); i++) {
+			std::pair<size_t, uint64_t> key(lengths[i], catalogue);
+			fitCache->fits.insert(std::make_pair(key, fits[i]));
 		}
-		return numCommas;
-	}
 
-	Wall *allocateWall(uint8_t hue, uint8_t saturation, 
-										   uint8_t brightness) {
-		Wall *wall = new Wall(hue, saturation, brightness);
-		if(!wall) {
-			std::cout << "Error in allocating wall.\n";
-			exit(-1);
+	// Iterate over the wall list and give each wall its fit
+		std::vector<Wall>::iterator wall = wallList.begin();
+		while(wall != wallList.end()) {
+			double wallLength = wall->getLength();
+			PANELIZE_LOG(DEBUG, "WALL LENGTH: " << wallLength << "\n");
+			std::pair<size_t, uint64_t> key(lengthInUnits(wallLength), catalogue);
+			const CachedFit &cached = fitCache->fits[key];
+
+			double waste = std::max(wallLength - cached.coveredLength, 0.0);
+			PANELIZE_LOG(DEBUG, "WASTE: " << waste << "\n");
+			wall->setBestFitPanelList(cached.panelList);
+			wall->setWaste(waste);
+			wall++;
 		}
-		return wall;
 	}
 
-	Wall *allocateWall(double length = 0, double width = 0,
-												double height = 0) {
-		Wall *wall = new Wall(length, width, height);
-		if(!wall) {
-			std::cout << "Error in allocating wall.\n";
-			exit(-1);
-		}
-		return wall;
+	size_t lengthInUnits(double length) const {
+		if(length <= 0 || fitOptions.resolution <= 0)
+			return 0;
+		return (size_t)floor(length / fitOptions.resolution + 1e-9);
 	}
 
-	Panel *allocatePanel(double width = 0, double height = 0) {
-		Panel *panel = new Panel(width, height);
-		if(!panel) {
-			std::cout << "Error in allocating panel.\n";
-			exit(-1);
+// Panel widths in units of fitOptions.resolution, without duplicates
+	std::vector<size_t> panelWidthsInUnits() const {
+		std::vector<size_t> widths;
+		std::vector<PanelInfo>::const_iterator panel = panelList.begin();
+		while(panel != panelList.end()) {
+			size_t width = lengthInUnits(panel->width + fitOptions.resolution / 2);
+			if(width > 0 && std::find(widths.begin(), widths.end(), width) == widths.end())
+				widths.push_back(width);
+			panel++;
 		}
-		return panel;
+		return widths;
 	}
 
-	void computeNumPanelsBestFit() {
-	// Iterate over the wall list and compute the number of panels needed
-		std::vector<Wall *>::iterator wall = wallList.begin();
-		while(wall != wallList.end()) {
-		// Check if any panel type fits perfectly with the half wall of given length.
-		// If not, we keep track of error and panel width the lowest leftover wall
-		// space to get the "best" panel. Put half panels in vector too.
-			double wallLength = ((*wall)->getLength()) / 2;
-			std::cout << "****************************************\n";
-			std::cout << "WALL LENGTH: " << 2 * wallLength << "\n";
-			double extraSpace = wallLength;
-			double smallerExtraSpace;
-			int zeroSpaceFitFound = -1;
-			std::vector<PanelInfo> panelVect = panelList;
-			std::vector<PanelInfo>::iterator panel = panelList.begin();
-			while(panel != panelList.end()) {
-				PanelInfo temp_panel(((*panel).width / 2));
-				panelVect.push_back(temp_panel);
-				panel++;
-			}
-			panel = panelVect.begin();
-			std::vector<Panel *> headPanelList;
-			std::vector<Panel *> perfectFitPanelList;
-			std::vector<std::vector<double>> panelsAdded;
-			while(panel != panelVect.end()) {
-				double panelWidth = panel->width;
-				if(wallLength >= panelWidth) {
-					if(zeroSpaceFitFound == -1)
-						zeroSpaceFitFound = 0;
-					uint32_t numPanels = wallLength / panelWidth;
-					double spaceLeft = wallLength - (numPanels * panelWidth);
-					std::cout << "PANEL WIDTH: " << panelWidth << "\n";
-					std::cout << "SPACE LEFT: " << spaceLeft << "\n";
-					if(!spaceLeft) {
-					// Perfect match found! Allocate panel. But before that, check if
-					// its a half panel.
-						zeroSpaceFitFound = 1;
-						std::vector<PanelInfo>::iterator temp_panel = panelList.begin();
-						while(temp_panel != panelList.end()) {
-							if(panelWidth == (*temp_panel).width) {
-								Panel *panel = allocatePanel(panelWidth);
-								numPanels = 2 * (wallLength / panelWidth);
-								(*wall)->addBestFitPanel(panel, numPanels);
-								std::cout << "NUM PANELS: " << numPanels << "\n";
-								headPanelList.push_back(panel);
-								goto next_panel;
-							}
-							temp_panel++;
-						}
-
-					// Check if the full panel corresponding to the full panel has already
-					// been added to the wall. If yes, we can move on.
-						panelWidth *= 2;
-						std::vector<Panel *>::iterator it = headPanelList.begin();
-						while(it != headPanelList.end()) {
-							if((*it)->getWidth() == panelWidth)
-								goto next_panel;
-							it++;
-						}
-						Panel *panel = allocatePanel(panelWidth);
-						numPanels = ((uint32_t)(2 * (wallLength / panelWidth)) - 1) + 1;
-						(*wall)->addBestFitPanel(panel, numPanels);
-						std::cout << "NUM PANELS: " << numPanels << "\n";
-						goto next_panel;
-					}
-					//std::cout << "BUGGER\n";
-					std::vector<PanelInfo>::iterator temp_panel = panelList.begin();
-					while(temp_panel != panelList.end()) {
-						if(panelWidth == (*temp_panel).width) {
-						// Get the lowest space left over
-							std::cout << "EXTRA SPACE: " << extraSpace << "\n";
-							if(spaceLeft == extraSpace) {
-								//std::cout << "BUGGER\n";
-								std::vector<double> temp_vect;
-								temp_vect.push_back(spaceLeft);
-								temp_vect.push_back(panelWidth);
-								panelsAdded.push_back(temp_vect);
-								extraSpace = spaceLeft;
-								std::cout << "EXTRA\n";
-								std::cout << "PANELS ADDED VECT SIZE: "
-													<< panelsAdded.size() << "\n";
-							} else {
-								if(spaceLeft < extraSpace) {
-									std::cout << "SPACE LEFT LESS THAN EXTRA SPACE\n";
-									std::vector<std::vector<double>>::iterator it = panelsAdded.begin();
-									if(it != panelsAdded.end()) {
-										while(it != panelsAdded.end()) {
-											if((*it)[0] == extraSpace) {
-												(*it)[0] = spaceLeft;
-												(*it)[1] = panelWidth;
-											}
-											it++;
-										}
-									} else {
-										std::vector<double> temp_vect;
-										temp_vect.push_back(spaceLeft);
-										temp_vect.push_back(panelWidth);
-										panelsAdded.push_back(temp_vect);
-									}
-									extraSpace = spaceLeft;
-									std::cout << "ppEXTRA\n";
-									std::cout << "PANELS ADDED VECT SIZE: "
-														<< panelsAdded.size() << "\n";
-								}
-							}
-							break;
-						}
-						temp_panel++;
-					}
-				}
-			next_panel:
-				panel++;
+// FNV-1a hash of everything besides the wall length that a fit depends on
+	uint64_t hashFit(const std::vector<size_t> &widths) const {
+		uint64_t hash = 14695981039346656037ULL;
+		auto add = [&](uint64_t value) {
+			for(int i = 0; i < 8; i++) {
+				hash ^= (value >> (8 * i)) & 0xff;
+				hash *= 1099511628211ULL;
 			}
+		};
+		uint64_t resolution;
+		memcpy(&resolution, &fitOptions.resolution, sizeof(resolution));
+		add(resolution);
+		add(lengthInUnits(fitOptions.maxWaste + fitOptions.resolution / 2));
+		std::vector<size_t>::const_iterator width = widths.begin();
+		while(width != widths.end()) {
+			add(*width);
+			width++;
+		}
+		return hash;
+	}
 
-		// If the best fit with zero space left is not found deal with the panels
-		// that work.
-			if(!zeroSpaceFitFound && !panelsAdded.empty()) {
-				std::vector<std::vector<double>>::iterator it = panelsAdded.begin();
-				while(it != panelsAdded.end()) {
-					Panel *panel = allocatePanel((*it)[1]);
-					uint32_t numPanels = 2 * (uint32_t)(wallLength / (*it)[1]);
-					(*wall)->addBestFitPanel(panel, numPanels);
-					std::cout << "zPANEL WIDTH: " <<  (*it)[1] << "\n";
-					std::cout << "zNUM PANELS: " << numPanels << "\n";
-					//extraSpace = wallLength - ((uint32_t)(wallLength / (*it)[1]) * (*it)[1]);
-
-				// Since this is a head panel, we add this to the head panel list
-					headPanelList.push_back(panel);
-					it++;
+// Fit panels of the given widths to a wall of the given length, both in units
+// of fitOptions.resolution, as an unbounded knapsack. For every length up to
+// the wall's, we find the fewest panels that cover it exactly; the best fit is
+// then read off the longest of those lengths, or the one with fewest panels
+// among those within maxWaste of the wall. This takes time in O(length *
+// panel types). Returns the length covered.
+	size_t fitPanels(size_t length, const std::vector<size_t> &widths,
+					 std::vector<PanelCount> &fit) const {
+		fit.clear();
+		const uint32_t unreachable = UINT32_MAX;
+		std::vector<uint32_t> numPanels(length + 1, unreachable);
+		std::vector<uint32_t> lastPanel(length + 1, 0);
+		numPanels[0] = 0;
+		for(size_t covered = 1; covered <= length; covered++) {
+			for(size_t k = 0; k < widths.size(); k++) {
+				if(widths[k] > covered || numPanels[covered - widths[k]] == unreachable)
+					continue;
+				if(numPanels[covered - widths[k]] + 1 < numPanels[covered]) {
+					numPanels[covered] = numPanels[covered - widths[k]] + 1;
+					lastPanel[covered] = (uint32_t)k;
 				}
-			} else {
-				goto next_wall;
 			}
+		}
 
-		// Try to fit panels in the left over space. Half panels would do as well.
-			//extraSpace = wallLength - ((uint32_t)(wallLength / optPanelWidth) * optPanelWidth);
-			std::cout << "EXTRA SPACE LEFT: " << 2 * extraSpace << "\n";
-			zeroSpaceFitFound = -1;
-			panelsAdded.clear();
-			smallerExtraSpace = extraSpace;
-			panel = panelVect.begin();
-			while(panel != panelVect.end()) {
-				double panelWidth = panel->width;
-				if(extraSpace >= panelWidth) {
-					if(zeroSpaceFitFound == -1)
-						zeroSpaceFitFound = 0;
-					uint32_t numPanels = extraSpace / panelWidth;
-					double spaceLeft = extraSpace - (numPanels * panelWidth);
-					std::cout << "--PANEL WIDTH: " << panelWidth << "\n";
-					std::cout << "--SPACE LEFT: " << spaceLeft << "\n";
-					if(!spaceLeft) {
-					// Perfect match found! Allocate panel. But before that, check if
-					// its a half panel.
-						zeroSpaceFitFound = 1;
-						std::vector<PanelInfo>::iterator temp_panel = panelList.begin();
-						while(temp_panel != panelList.end()) {
-							if(panelWidth == (*temp_panel).width) {
-								Panel *panel = allocatePanel(panelWidth);
-								numPanels = 2 * (extraSpace / panelWidth);
-								(*wall)->addBestFitPanel(panel, headPanelList, numPanels);
-								std::cout << "--NUM PANELS: " << numPanels << "\n";
-								perfectFitPanelList.push_back(panel);
-								goto next_panel2;
-							}
-							temp_panel++;
-						}
-						panelWidth *= 2;
-						std::vector<Panel *>::iterator it = perfectFitPanelList.begin();
-						while(it != perfectFitPanelList.end()) {
-							if((*it)->getWidth() == panelWidth)
-								goto next_panel2;
-							it++;
-						}
-						Panel *panel = allocatePanel(panelWidth);
-						numPanels = ((uint32_t)(2 * (wallLength / panelWidth)) - 1) + 1;
-						(*wall)->addBestFitPanel(panel, headPanelList, numPanels);
-						std::cout << "--NUM PANELS: " << numPanels << "\n";
-						goto next_panel2;
-					}
-
-					if(spaceLeft == smallerExtraSpace) {
-						std::vector<double> temp_vect;
-						temp_vect.push_back(spaceLeft);
-						temp_vect.push_back(panelWidth);
-						panelsAdded.push_back(temp_vect);
-						smallerExtraSpace = spaceLeft;
-						std::cout << "--EXTRA\n";
-					} else {
-						if(spaceLeft < smallerExtraSpace) {
-							std::vector<std::vector<double>>::iterator it = panelsAdded.begin();
-							if(it != panelsAdded.end()) {
-								while(it != panelsAdded.end()) {
-									if((*it)[0] == smallerExtraSpace) {
-										(*it)[0] = spaceLeft;
-										(*it)[1] = panelWidth;
-									}
-									it++;
-								}
-							} else {
-								std::vector<double> temp_vect;
-								temp_vect.push_back(spaceLeft);
-								temp_vect.push_back(panelWidth);
-								panelsAdded.push_back(temp_vect);
-							}
-							smallerExtraSpace = spaceLeft;
-							std::cout << "--ppEXTRA\n";
-						}
-					}
-				}
-			next_panel2:
-				panel++;
+	// Pick the best covered length
+		size_t tolerance = lengthInUnits(fitOptions.maxWaste + fitOptions.resolution / 2);
+		size_t best = 0;
+		for(size_t covered = length; covered > 0; covered--) {
+			if(numPanels[covered] == unreachable)
+				continue;
+			if(length - covered > tolerance) {
+				if(best == 0)
+					best = covered;
+				break;
 			}
+			if(best == 0 || numPanels[covered] < numPanels[best])
+				best = covered;
+		}
 
-		// If the best fit with zero space left is not found deal with the panels
-		// that work.
-			if(!zeroSpaceFitFound && !panelsAdded.empty()) {
-				std::vector<std::vector<double>>::iterator it = panelsAdded.begin();
-				while(it != panelsAdded.end()) {
-					double panelWidth = (*it)[1];
-					uint32_t numPanels;
-
-				// Check if it is half panel
-					std::vector<PanelInfo>::iterator panel_it = panelList.begin();
-					while(panel_it != panelList.end()) {
-						if(panel_it->width == panelWidth) {
-							numPanels = 2 * (uint32_t)(extraSpace / panelWidth);
-							goto allocate_panel;
-						}
-						panel_it++;
-					}
-					panelWidth *= 2;
-					numPanels = ((uint32_t)(2 * (extraSpace / panelWidth)) - 1) + 1;
-
-				allocate_panel:
-					Panel *panel = allocatePanel(panelWidth);
-					(*wall)->addBestFitPanel(panel, headPanelList, numPanels);
-					std::cout << "--zPANEL WIDTH: " <<  (*it)[1] << "\n";
-					std::cout << "--zNUM PANELS: " << numPanels << "\n";
-					it++;
-				}
+	// And walk back through the panels that make it up
+		std::vector<uint32_t> counts(widths.size(), 0);
+		for(size_t covered = best; covered > 0; covered -= widths[lastPanel[covered]])
+			counts[lastPanel[covered]]++;
+		for(size_t k = 0; k < widths.size(); k++) {
+			if(counts[k]) {
+				PanelCount count = { widths[k] * fitOptions.resolution, counts[k] };
+				fit.push_back(count);
 			}
-
-		next_wall:
-			std::cout << "***********************************************\n";
-			wall++;
 		}
+		return best;
 	}
 
 	void filterNoise(double scale, double noiseThreshold, bool cornerSelection) {
+		if(cornerSelection) {
+		// User selected walls. Assume everything is sane.	
+			std::vector<Wall>::iterator wall = wallList.begin();
+			while(wall != wallList.end()) {
+				wall->setLength(wall->getRectSides()[0] * scale);
+				wall++;
+			}
+			return;
+		}
+
 	// Filter noise. Avoid anything that does not have a proper, significant size
 	// Traverse the object list and filter the bugger noise out. For rectangles,
 	// there are only three unique distances. We pick two shortest lengths,
-	// ignoring the longest one which is most likely to be the diagonal.
-		std::vector<Wall *> tempList = wallList;
-		wallList.clear();
-		std::vector<Wall *>::iterator wall_it = tempList.begin();
-		if(!cornerSelection) {
-			while(wall_it != tempList.end()) {
-			// Walls are treated as rectangles. Get two rectangle sides	and check if the
-			// ratio of sides is more than the threshold. If it is, put the wall in the
-			// wall list and save the scaled lengths of the walls.
-				double side1 = (*wall_it)->getRectSides()[0];
-				double side2 = (*wall_it)->getRectSides()[1];
-				if(side1 && side2) {
-					if(side1 > side2) {
-						if(side1 / side2 >= noiseThreshold) {
-							if(side2 <= 1000 && side2 >= 5) {
-								wallList.push_back(*wall_it);
-								(*wall_it)->setLength(side1 * scale);
-							}
-							std::cout << " WALL SIDE WIDTH: " << side1 << "\n";
-						} else {
-						// Delete the wall
-							delete *wall_it;
-						}
-					} else {
-						if(side2 / side1 >= noiseThreshold) {
-							//if(side1 <= 1000 && side1 >= 5) {
-								wallList.push_back(*wall_it);
-								(*wall_it)->setLength(side2 * scale);
-							//}
-							std::cout << " WALL SIDE WIDTH: " << side1 << "\n";
-						} else {
-						// Delete the wall	
-							delete *wall_it;
+	// ignoring the longest one which is most likely to be the diagonal. Walls
+	// that are kept are moved down over those that are not.
+		size_t numKept = 0;
+		for(size_t i = 0; i < wallList.size(); i++) {
+			Wall &wall = wallList[i];
+		// Walls are treated as rectangles. Get two rectangle sides	and check if the
+		// ratio of sides is more than the threshold. If it is, keep the wall and save
+		// its scaled length.
+			double side1 = wall.getRectSides()[0];
+			double side2 = wall.getRectSides()[1];
+			bool keep = false;
+			if(side1 && side2) {
+				if(side1 > side2) {
+					if(side1 / side2 >= noiseThreshold) {
+						if(side2 <= 1000 && side2 >= 5) {
+							wall.setLength(side1 * scale);
+							keep = true;
 						}
+						PANELIZE_LOG(DEBUG, " WALL SIDE WIDTH: " << side1 << "\n");
 					}
 				} else {
-				// Delete the wall	
-					delete *wall_it;
+					if(side2 / side1 >= noiseThreshold) {
+						//if(side1 <= 1000 && side1 >= 5) {
+							wall.setLength(side2 * scale);
+							keep = true;
+						//}
+						PANELIZE_LOG(DEBUG, " WALL SIDE WIDTH: " << side1 << "\n");
+					}
 				}
-				wall_it++;
 			}
-		} else {
-		// User selected walls. Assume everything is sane.	
-			while(wall_it != tempList.end()) {
-				double side = (*wall_it)->getRectSides()[0];
-				(*wall_it)->setLength(side * scale);
-				wall_it++;
+			if(keep) {
+				if(numKept != i)
+					wallList[numKept] = std::move(wall);
+				numKept++;
 			}
 		}
+		wallList.erase(wallList.begin() + numKept, wallList.end());
 	}
 	
 // Truncate file truncate extension
@@ -1027,104 +1696,62 @@ private:
 		if(outputFileName.empty()) {
 			output = truncateExtension(imageName);
 
-			std::cout << "TRUNCATED OUPUT FILE NAME: " << output << "\n";
+			PANELIZE_LOG(DEBUG, "TRUNCATED OUPUT FILE NAME: " << output << "\n");
 		// Append new extension
 			output.append(".csv");
 		} else {
 			output = outputFileName;
 		}
-		std::cout << "OUPUT FILE NAME: " << output << "\n";
+		PANELIZE_LOG(INFO, "OUPUT FILE NAME: " << output << "\n");
 	// Write to output file
 		std::ofstream outputFile;
 		outputFile.open(output);
 		outputFile << "Wall Length (ft),Wall Width (ft),Wall Height (ft),"
 						"Panel Width (ft),Number of Panels" << std::endl;
-		std::vector<Wall *>::iterator wall = wallList.begin();
+		writeWalls(outputFile);
+
+	// Done wrtiting to the file. Save the god damn thing.
+		outputFile.close();
+	}
+
+// Write a row for each wall, with the widths and numbers of the panels fitted
+// to it. Batches name the image in an extra first column.
+	void writeWalls(std::ostream &outputFile,
+					const std::string &imageName = std::string()) {
+		std::vector<Wall>::const_iterator wall = wallList.begin();
 		while(wall != wallList.end()) {
+			if(!imageName.empty())
+				outputFile << "\"" << imageName << "\",";
+
 		// Write wall dimensions
-			std::ostringstream strs;
-			std::string str;
-			str.append("\"");
-			strs << (*wall)->getLength();
-			str.append(strs.str());
-			str.append("\"");
-			outputFile << str << ",";
-			std::ostringstream strs2;
-			str.clear();
-			str.append("\"");
-			strs2 << (*wall)->getWidth();
-			str.append(strs2.str());
-			str.append("\"");
-			outputFile << str << ",";
-			std::ostringstream strs3;
-			str.clear();
-			str.append("\"");
-			strs3 << (*wall)->getHeight();
-			str.append(strs3.str());
-			str.append("\"");
-			outputFile << str << ",";
-
-			std::cout << "WALL DIMENSIONS ADDED\n";
+			outputFile << "\"" << wall->getLength() << "\","
+					   << "\"" << wall->getWidth() << "\","
+					   << "\"" << wall->getHeight() << "\",";
+
 		// List the panels
-			std::vector<std::vector<Panel *> *>::iterator panel_list =
-										((*wall)->getBestFitPanelList()).begin();
-			while(panel_list != ((*wall)->getBestFitPanelList()).end()) {
-				std::string str;
-				str.append("\"");
-				std::vector<Panel *>::iterator panel = (*panel_list)->begin();
-				while(panel != (*panel_list)->end()) {
-					std::ostringstream strs;
-					strs << (*panel)->getWidth();
-					str.append(strs.str());
-					str.append(", ");
-					panel++;
-				}
-				std::string::reverse_iterator rit = str.rbegin() + 1;
-				std::cout << "LAST CHAR: " << *rit << "\n";
-				*rit = '\"';
-				outputFile << str;
-				std::cout << "STRING: " << str << "\n";
-				std::cout << "PANEL WIDTH ADDED\n";
-				outputFile << ",";
-				std::string str2;
-				str2.append("\"");
-				panel = (*panel_list)->begin();
-				while(panel != (*panel_list)->end()) {
-					std::ostringstream strs;
-					strs << (*panel)->getNumPanels();
-					str2.append(strs.str());
-					str2.append(", ");
-					panel++;
-				}
-				rit = str2.rbegin() + 1;
-				std::cout << "LAST CHAR: " << *rit << "\n";
-				*rit = '\"';
-				outputFile << str2;
-				std::cout << "STRING: " << str2 << "\n";
-				std::cout << "PANEL NUM ADDED\n";
-				outputFile << std::endl;
-				panel_list++;
-				if(panel_list != ((*wall)->getBestFitPanelList()).end()) {
-					outputFile << ",,,";
-				}
+			std::string widths, counts;
+			const std::vector<Panel> &panelList = wall->getBestFitPanelList();
+			std::vector<Panel>::const_iterator panel = panelList.begin();
+			while(panel != panelList.end()) {
+				std::ostringstream strs;
+				if(panel != panelList.begin())
+					strs << ", ";
+				strs << panel->getWidth();
+				widths.append(strs.str());
+				std::ostringstream strs2;
+				if(panel != panelList.begin())
+					strs2 << ", ";
+				strs2 << panel->getNumPanels();
+				counts.append(strs2.str());
+				panel++;
 			}
+			outputFile << "\"" << widths << "\" ,\"" << counts << "\" " << std::endl;
+			PANELIZE_LOG(DEBUG, "PANELS ADDED: " << widths << "; " << counts << "\n");
 			outputFile << std::endl;
 			wall++;
 		}
-
-	// Done wrtiting to the file. Save the god damn thing.
-		outputFile.close();
 	}
 	
-// Merge necessary panels for the walls in the wall list
-	void mergeRepetitivePanels() {
-		std::vector<Wall *>::iterator wall = wallList.begin();
-		while(wall != wallList.end()) {
-			(*wall)->mergePanelsInPanelLists();
-			wall++;
-		}
-	}	
-
 // This class is not abstract
 	void abstractImage() const {}
 };
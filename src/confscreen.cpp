@@ -74,6 +74,11 @@ void TextWindow::ScreenChangeExportOffset(int link, uint32_t v) {
     SS.TW.edit.meaning = Edit::EXPORT_OFFSET;
 }
 
+void TextWindow::ScreenChangeExportHlrResolution(int link, uint32_t v) {
+    SS.TW.ShowEditControl(3, ssprintf("%d", SS.exportHlrResolution));
+    SS.TW.edit.meaning = Edit::EXPORT_HLR_RESOLUTION;
+}
+
 void TextWindow::ScreenChangeFixExportColors(int link, uint32_t v) {
     SS.fixExportColors = !SS.fixExportColors;
 }
@@ -236,6 +241,10 @@ void TextWindow::ShowConfiguration() {
     Printf(false, "%Ba   %s %Fl%Ll%f%D[change]%E",
         SS.MmToString(SS.exportOffset).c_str(),
         &ScreenChangeExportOffset, 0);
+    Printf(false, "%Ft hidden line removal resolution (0=exact)");
+    Printf(false, "%Ba   %d %Fl%Ll%f%D[change]%E",
+        SS.exportHlrResolution,
+        &ScreenChangeExportHlrResolution, 0);
 
     Printf(false, "");
     Printf(false, "  %Fd%f%Ll%s  export shaded 2d triangles%E",
@@ -414,6 +423,16 @@ bool TextWindow::EditControlDoneForConfiguration(const char *s) {
             }
             break;
         }
+        case Edit::EXPORT_HLR_RESOLUTION: {
+            int v = atoi(s);
+            if(v < 0 || v > SDepthBuffer::MAX_RESOLUTION) {
+                Error(_("Hidden line removal resolution must be between 0 "
+                        "(exact) and 4096 pixels."));
+            } else {
+                SS.exportHlrResolution = v;
+            }
+            break;
+        }
         case Edit::CANVAS_SIZE: {
             Expr *e = Expr::From(s, /*popUpError=*/true);
             if(!e) {
@@ -51,6 +51,45 @@ std::string Constraint::DescriptionString() const {
     return ssprintf("c%03x-%s", h.v, s.c_str());
 }
 
+//-----------------------------------------------------------------------------
+// Set the value of a dimension to v, as entered by the user: a distance in mm,
+// an angle in degrees, or a ratio. Signed distances keep their sign, since it
+// isn't displayed to the user, and a diameter shown as a radius is doubled.
+//-----------------------------------------------------------------------------
+void Constraint::ModifyValueTo(double v) {
+    switch(type) {
+        case Type::PROJ_PT_DISTANCE:
+        case Type::PT_LINE_DISTANCE:
+        case Type::PT_FACE_DISTANCE:
+        case Type::PT_PLANE_DISTANCE:
+        case Type::LENGTH_DIFFERENCE: {
+            // The sign is not displayed to the user, but this is a signed
+            // distance internally. To flip the sign, the user enters a
+            // negative distance.
+            bool wasNeg = (valA < 0);
+            if(wasNeg) {
+                valA = -v;
+            } else {
+                valA = v;
+            }
+            break;
+        }
+        case Type::DIAMETER:
+            valA = fabs(v);
+
+            // If displayed and edited as radius, convert back
+            // to diameter
+            if(other)
+                valA *= 2;
+            break;
+
+        default:
+            // These are always positive.
+            valA = fabs(v);
+            break;
+    }
+}
+
 #ifndef LIBRARY
 
 //-----------------------------------------------------------------------------
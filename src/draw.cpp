@@ -816,6 +816,7 @@ void GraphicsWindow::Draw(Canvas *canvas) {
 }
 
 void GraphicsWindow::Paint() {
+    TRACE_SCOPE("GraphicsWindow::Paint");
     if(!canvas) return;
 
     havePainted = true;
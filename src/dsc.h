@@ -329,6 +329,33 @@ public:
         n++;
     }
 
+    // Add many items at once. Adding them one by one moves every item after
+    // each new one along, which takes quadratic time when they don't go at
+    // the end; this sorts them, and merges them in with one pass from the back.
+    void AddMany(T *items, int count) {
+        if(count == 0) return;
+        std::sort(items, items + count, [](const T &a, const T &b) {
+            return a.h.v < b.h.v;
+        });
+        for(int j = 1; j < count; j++) {
+            ssassert(items[j - 1].h.v != items[j].h.v, "Handle isn't unique");
+        }
+        ReserveMore(count);
+        for(int k = n; k < n + count; k++) {
+            new(&elem[k]) T();
+        }
+        int i = n - 1, j = count - 1, k = n + count - 1;
+        while(j >= 0) {
+            if(i >= 0 && elem[i].h.v > items[j].h.v) {
+                elem[k--] = std::move(elem[i--]);
+            } else {
+                ssassert(i < 0 || elem[i].h.v != items[j].h.v, "Handle isn't unique");
+                elem[k--] = items[j--];
+            }
+        }
+        n += count;
+    }
+
     T *FindById(H h) {
         T *t = FindByIdNoOops(h);
         ssassert(t != NULL, "Cannot find handle");
@@ -9,6 +9,7 @@
 #include "solvespace.h"
 
 void SolveSpaceUI::ExportSectionTo(const Platform::Path &filename) {
+    TRACE_SCOPE("SolveSpaceUI::ExportSectionTo");
     Vector gn = (SS.GW.projRight).Cross(SS.GW.projUp);
     gn = gn.WithMagnitude(1);
 
@@ -73,37 +74,120 @@ void SolveSpaceUI::ExportSectionTo(const Platform::Path &filename) {
     SEdgeList el = {};
     SBezierList bl = {};
 
+    // Only the triangles and surfaces whose bounding boxes meet the plane can
+    // lie in it, so query a hierarchy for those instead of testing them all.
+    SBvh meshBvh  = SBvh::From(&g->runningMesh),
+         shellBvh = SBvh::From(&g->runningShell);
+
     // If there's a mesh, then grab the edges from it.
-    g->runningMesh.MakeEdgesInPlaneInto(&el, n, d);
+    g->runningMesh.MakeEdgesInPlaneInto(&el, n, d, &meshBvh);
 
     // If there's a shell, then grab the edges and possibly Beziers.
     g->runningShell.MakeSectionEdgesInto(n, d,
        &el,
-       (SS.exportPwlCurves || fabs(SS.exportOffset) > LENGTH_EPS) ? NULL : &bl);
+       (SS.exportPwlCurves || fabs(SS.exportOffset) > LENGTH_EPS) ? NULL : &bl,
+       &shellBvh);
+
+    ExportSectionEdgesTo(filename, &el, &bl, u, v, n, origin);
+    el.Clear();
+    bl.Clear();
+}
 
+//-----------------------------------------------------------------------------
+// Write the edges and curves of a section, which all lie in the plane through
+// origin with normal n, reoriented from that plane into the xy plane.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::ExportSectionEdgesTo(const Platform::Path &filename,
+                                        SEdgeList *el, SBezierList *bl,
+                                        Vector u, Vector v, Vector n, Vector origin)
+{
     // All of these are solid model edges, so use the appropriate style.
     SEdge *se;
-    for(se = el.l.First(); se; se = el.l.NextAfter(se)) {
+    for(se = el->l.First(); se; se = el->l.NextAfter(se)) {
         se->auxA = Style::SOLID_EDGE;
     }
     SBezier *sb;
-    for(sb = bl.l.First(); sb; sb = bl.l.NextAfter(sb)) {
+    for(sb = bl->l.First(); sb; sb = bl->l.NextAfter(sb)) {
         sb->auxA = Style::SOLID_EDGE;
     }
 
-    el.CullExtraneousEdges();
-    bl.CullIdenticalBeziers();
+    el->CullExtraneousEdges();
+    bl->CullIdenticalBeziers();
 
     // And write the edges.
     VectorFileWriter *out = VectorFileWriter::ForFile(filename);
     if(out) {
         // parallel projection (no perspective), and no mesh
-        ExportLinesAndMesh(&el, &bl, NULL,
+        ExportLinesAndMesh(el, bl, NULL,
                            u, v, n, origin, 0,
                            out);
     }
-    el.Clear();
-    bl.Clear();
+}
+
+//-----------------------------------------------------------------------------
+// Export a stack of sections through the solid of the active group, in planes
+// normal to the view direction and spaced step apart, one file per section
+// named after filename with a numeric suffix. The solid is cut as its
+// triangle mesh, regenerated at the export chord tolerance, so curves come out
+// piecewise linear to that tolerance; a single hierarchy over that mesh serves
+// every plane, and the planes are cut in parallel.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::ExportSlicesTo(const Platform::Path &filename, double step) {
+    TRACE_SCOPE("SolveSpaceUI::ExportSlicesTo");
+    GenerateForExport();
+
+    Vector n = (SS.GW.projRight).Cross(SS.GW.projUp);
+    n = n.WithMagnitude(1);
+    Vector u = SS.GW.projRight.WithMagnitude(1),
+           v = SS.GW.projUp.WithMagnitude(1);
+
+    Group *g = SK.GetGroup(SS.GW.activeGroup);
+    g->GenerateDisplayItems();
+    if(g->displayMesh.IsEmpty()) {
+        Error(_("No solid model present; draw one with extrudes and revolves, "
+                "or use Export 2d View to export bare lines and curves."));
+        return;
+    }
+    if(step < LENGTH_EPS) {
+        Error(_("Slice spacing must be greater than zero."));
+        return;
+    }
+
+    SMesh *m = &g->displayMesh;
+    SBvh bvh = SBvh::From(m);
+
+    double dmin = VERY_POSITIVE, dmax = VERY_NEGATIVE;
+    for(int i = 0; i < m->l.n; i++) {
+        const STriangle &tr = m->l.elem[i];
+        for(Vector p : { tr.a, tr.b, tr.c }) {
+            dmin = min(dmin, n.Dot(p));
+            dmax = max(dmax, n.Dot(p));
+        }
+    }
+
+    // Center the stack in the extent of the solid, so that no plane grazes
+    // its outermost faces.
+    size_t count = (size_t)floor((dmax - dmin) / step) + 1;
+    double d0 = (dmin + dmax) / 2 - step * (double)(count - 1) / 2;
+
+    std::vector<SEdgeList> sections(count);
+    ParallelFor(count, [&](size_t i) {
+        m->MakeSectionInto(&sections[i], n, d0 + step * (double)i, &bvh);
+    });
+
+    std::string stem = filename.FileStem(),
+                ext  = filename.Extension();
+    int digits = std::max(3, (int)std::to_string(count).length());
+    for(size_t i = 0; i < count; i++) {
+        Platform::Path sliceFilename = filename.Parent().Join(
+            ssprintf("%s-%0*d.%s", stem.c_str(), digits, (int)i + 1, ext.c_str()));
+        Vector origin = n.ScaledBy(d0 + step * (double)i);
+
+        SBezierList bl = {};
+        ExportSectionEdgesTo(sliceFilename, &sections[i], &bl, u, v, n, origin);
+        sections[i].Clear();
+        bl.Clear();
+    }
 }
 
 // This is an awful temporary hack to replace Constraint::GetEdges until we have proper
@@ -165,7 +249,83 @@ public:
     }
 };
 
+//-----------------------------------------------------------------------------
+// Regenerate the sketch at the export tolerances. If it was last regenerated
+// for export at the same tolerances, then everything that's clean is still
+// good, and only the dirty groups need it; that keeps repeated exports of an
+// edited sketch cheap.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::GenerateForExport() {
+    if(exportMode && exportModeChordTol == ExportChordTolMm() &&
+       exportModeMaxSegments == exportMaxSegments) {
+        GenerateAll(Generate::DIRTY);
+        return;
+    }
+
+    exportMode            = true;
+    exportModeChordTol    = ExportChordTolMm();
+    exportModeMaxSegments = exportMaxSegments;
+    GenerateAll(Generate::ALL);
+}
+
+//-----------------------------------------------------------------------------
+// Solve and regenerate the dirty groups after an edit, keeping export mode if
+// we're in it. In export mode GenerateAll only rebuilds the meshes from the
+// params as they are, so the solve is a separate pass first, like the one for
+// the bounding box.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::GenerateEditForExport() {
+    if(!exportMode) {
+        GenerateAll(Generate::DIRTY);
+        return;
+    }
+    GenerateAll(Generate::DIRTY, /*andFindFree=*/false, /*genForBBox=*/true);
+    GenerateForExport();
+}
+
+//-----------------------------------------------------------------------------
+// Set the given dimensions to the given values, and re-solve from the first
+// group that any of them changed. In export mode GenerateAll only rebuilds the
+// meshes, so the solve is a separate pass, like the one for the bounding box.
+// If that solves, the dirty groups are regenerated for export, and goodParams
+// becomes a copy of the solution. If it doesn't, the params are put back as
+// they are in goodParams, and every group that this variant changed is marked
+// dirty again: their dimensions keep the values of this variant, so the next
+// variant has to solve them again even where it doesn't change them itself.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::GenerateVariantForExport(const std::vector<hConstraint> &dimensions,
+                                            const std::vector<double> &values,
+                                            IdList<Param,hParam> *goodParams) {
+    std::vector<hGroup> changed;
+    for(size_t i = 0; i < dimensions.size(); i++) {
+        Constraint *c = SK.GetConstraint(dimensions[i]);
+        double valA = c->valA;
+        c->ModifyValueTo(values[i]);
+        if(c->valA != valA) {
+            MarkGroupDirty(c->group);
+            changed.push_back(c->group);
+        }
+    }
+
+    GenerateAll(Generate::DIRTY, /*andFindFree=*/false, /*genForBBox=*/true);
+    if(ActiveGroupsOkay()) {
+        GenerateForExport();
+        SK.param.DeepCopyInto(goodParams);
+        return true;
+    }
+
+    for(Param &p : *goodParams) {
+        Param *cur = SK.param.FindByIdNoOops(p.h);
+        if(cur) cur->val = p.val;
+    }
+    for(hGroup hg : changed) {
+        MarkGroupDirty(hg);
+    }
+    return false;
+}
+
 void SolveSpaceUI::ExportViewOrWireframeTo(const Platform::Path &filename, bool exportWireframe) {
+    TRACE_SCOPE("SolveSpaceUI::ExportViewOrWireframeTo");
     int i;
     SEdgeList edges = {};
     SBezierList beziers = {};
@@ -173,8 +333,7 @@ void SolveSpaceUI::ExportViewOrWireframeTo(const Platform::Path &filename, bool
     VectorFileWriter *out = VectorFileWriter::ForFile(filename);
     if(!out) return;
 
-    SS.exportMode = true;
-    GenerateAll(Generate::ALL);
+    GenerateForExport();
 
     SMesh *sm = NULL;
     if(SS.GW.showShaded || SS.GW.drawOccludedAs != GraphicsWindow::DrawOccludedAs::VISIBLE) {
@@ -297,6 +456,7 @@ void SolveSpaceUI::ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *s
                                       Vector origin, double cameraTan,
                                       VectorFileWriter *out)
 {
+    TRACE_SCOPE("SolveSpaceUI::ExportLinesAndMesh");
     double s = 1.0 / SS.exportScale;
 
     // Project into the export plane; so when we're done, z doesn't matter,
@@ -395,41 +555,73 @@ void SolveSpaceUI::ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *s
                                        GW.showOutlines ? Style::OUTLINE : Style::SOLID_EDGE);
         }
 
-        root->ClearTags();
-        int cnt = 1234;
-
-        SEdge *se;
-        for(se = sel->l.First(); se; se = sel->l.NextAfter(se)) {
-            if(se->auxA == Style::CONSTRAINT) {
-                // Constraints should not get hidden line removed; they're
-                // always on top.
-                hlrd.AddEdge(se->a, se->b, se->auxA);
-                continue;
-            }
-
-            SEdgeList edges = {};
-            // Split the original edge against the mesh
-            edges.AddEdge(se->a, se->b, se->auxA);
-            root->OcclusionTestLine(*se, &edges, cnt);
+        // Edges that are hidden get drawn stippled, or not at all; and the
+        // occlusion test may split unnecessarily, so fix that too.
+        auto addResults = [&](SEdge *se, SEdgeList *edges) {
             if(SS.GW.drawOccludedAs == GraphicsWindow::DrawOccludedAs::STIPPLED) {
-                for(SEdge &se : edges.l) {
-                    if(se.tag == 1) {
-                        se.auxA = Style::HIDDEN_EDGE;
+                for(SEdge &e : edges->l) {
+                    if(e.tag == 1) {
+                        e.auxA = Style::HIDDEN_EDGE;
                     }
                 }
             } else if(SS.GW.drawOccludedAs == GraphicsWindow::DrawOccludedAs::INVISIBLE) {
-                edges.l.RemoveTagged();
+                edges->l.RemoveTagged();
             }
 
-            // the occlusion test splits unnecessarily; so fix those
-            edges.MergeCollinearSegments(se->a, se->b);
-            cnt++;
+            edges->MergeCollinearSegments(se->a, se->b);
             // And add the results to our output
             SEdge *sen;
-            for(sen = edges.l.First(); sen; sen = edges.l.NextAfter(sen)) {
+            for(sen = edges->l.First(); sen; sen = edges->l.NextAfter(sen)) {
                 hlrd.AddEdge(sen->a, sen->b, sen->auxA);
             }
-            edges.Clear();
+            edges->Clear();
+        };
+
+        if(SS.exportHlrResolution > 0) {
+            // Test against a depth buffer instead of the kd-tree; that's much
+            // faster for big meshes with many edges. Edges are sampled twice
+            // per pixel, and each sample is tested exactly, so only a hidden
+            // or visible stretch shorter than about a pixel can be missed;
+            // hence the configurable resolution. Each edge is tested on its
+            // own, so they can all be done in parallel.
+            SDepthBuffer db = SDepthBuffer::From(&smp, SS.exportHlrResolution);
+            std::vector<SEdgeList> results(sel->l.n);
+            ParallelFor(results.size(), [&](size_t i) {
+                const SEdge &se = sel->l.elem[i];
+                if(se.auxA == Style::CONSTRAINT) return;
+                db.OcclusionTestLine(se, &results[i]);
+            });
+
+            for(int i = 0; i < sel->l.n; i++) {
+                SEdge *se = &(sel->l.elem[i]);
+                if(se->auxA == Style::CONSTRAINT) {
+                    // Constraints should not get hidden line removed; they're
+                    // always on top.
+                    hlrd.AddEdge(se->a, se->b, se->auxA);
+                    continue;
+                }
+                addResults(se, &results[i]);
+            }
+        } else {
+            root->ClearTags();
+            int cnt = 1234;
+
+            SEdge *se;
+            for(se = sel->l.First(); se; se = sel->l.NextAfter(se)) {
+                if(se->auxA == Style::CONSTRAINT) {
+                    // Constraints should not get hidden line removed; they're
+                    // always on top.
+                    hlrd.AddEdge(se->a, se->b, se->auxA);
+                    continue;
+                }
+
+                SEdgeList edges = {};
+                // Split the original edge against the mesh
+                edges.AddEdge(se->a, se->b, se->auxA);
+                root->OcclusionTestLine(*se, &edges, cnt);
+                cnt++;
+                addResults(se, &edges);
+            }
         }
 
         sel = &hlrd;
@@ -794,16 +986,31 @@ void VectorFileWriter::BezierAsNonrationalCubic(SBezier *sb, int depth) {
 // Export a triangle mesh, in the requested format.
 //-----------------------------------------------------------------------------
 void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
-    SS.exportMode = true;
-    GenerateAll(Generate::ALL);
+    TRACE_SCOPE("SolveSpaceUI::ExportMeshTo");
+    GenerateForExport();
 
     Group *g = SK.GetGroup(SS.GW.activeGroup);
-    g->GenerateDisplayItems();
 
-    SMesh *m = &(SK.GetGroup(SS.GW.activeGroup)->displayMesh);
-    if(m->IsEmpty()) {
-        Error(_("Active group mesh is empty; nothing to export."));
-        return;
+    // PLY and glTF are written straight from the shell, one surface at a
+    // time, so there's no need to triangulate everything up front. The other
+    // formats need the whole mesh, for the naked edge check; STL is what gets
+    // 3d printed, so it keeps the check, and is written from the same mesh.
+    bool streamed = filename.HasExtension("ply") ||
+                    filename.HasExtension("glb");
+    SMesh *m = NULL;
+    if(streamed) {
+        Group *dg = g->DisplayMeshGroup();
+        if(dg->runningShell.IsEmpty() && dg->runningMesh.IsEmpty()) {
+            Error(_("Active group mesh is empty; nothing to export."));
+            return;
+        }
+    } else {
+        g->GenerateDisplayItems();
+        m = &(g->displayMesh);
+        if(m->IsEmpty()) {
+            Error(_("Active group mesh is empty; nothing to export."));
+            return;
+        }
     }
 
     FILE *f = OpenFile(filename, "wb");
@@ -811,9 +1018,15 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
         Error("Couldn't write to '%s'", filename.raw.c_str());
         return;
     }
-    ShowNakedEdges(/*reportOnlyWhenNotOkay=*/true);
+    if(!streamed) {
+        ShowNakedEdges(/*reportOnlyWhenNotOkay=*/true);
+    }
     if(filename.HasExtension("stl")) {
         ExportMeshAsStlTo(f, m);
+    } else if(filename.HasExtension("ply")) {
+        ExportMeshAsPlyTo(f, g);
+    } else if(filename.HasExtension("glb")) {
+        ExportMeshAsGltfTo(f, g);
     } else if(filename.HasExtension("obj")) {
         Platform::Path mtlFilename = filename.WithExtension("mtl");
         FILE *fMtl = OpenFile(mtlFilename, "wb");
@@ -832,7 +1045,8 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
         ExportMeshAsThreeJsTo(f, filename, m, e);
     } else {
         Error("Can't identify output file type from file extension of "
-              "filename '%s'; try .stl, .obj, .js, .html.", filename.raw.c_str());
+              "filename '%s'; try .stl, .ply, .glb, .obj, .js, .html.",
+              filename.raw.c_str());
     }
 
     fclose(f);
@@ -842,47 +1056,273 @@ void SolveSpaceUI::ExportMeshTo(const Platform::Path &filename) {
     InvalidateGraphics();
 }
 
+//-----------------------------------------------------------------------------
+// A little helper for the mesh formats, which collects the output in a large
+// buffer and hands it to stdio in big blocks, instead of making one stdio
+// call per field or line. Binary values are written in host byte order, which
+// is little-endian on everything we run on, as those formats require.
+//-----------------------------------------------------------------------------
+class BufferedMeshWriter {
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    FILE                 *f;
+    std::vector<uint8_t>  buffer;
+
+    BufferedMeshWriter(FILE *f) : f(f) {
+        buffer.reserve(BUFFER_SIZE);
+    }
+    ~BufferedMeshWriter() {
+        Flush();
+    }
+
+    void Write(const void *data, size_t size) {
+        if(buffer.size() + size > BUFFER_SIZE) Flush();
+        if(size > BUFFER_SIZE) {
+            fwrite(data, 1, size, f);
+            return;
+        }
+        const uint8_t *bytes = (const uint8_t *)data;
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+    void WriteString(const std::string &str) {
+        Write(str.data(), str.size());
+    }
+    void WriteFloat(double v) {
+        float w = (float)v;
+        Write(&w, sizeof(w));
+    }
+    void WriteUint32(uint32_t v) {
+        Write(&v, sizeof(v));
+    }
+    void WriteUint8(uint8_t v) {
+        Write(&v, sizeof(v));
+    }
+    void Printf(const char *fmt, ...) {
+        va_list va;
+        char str[256];
+        va_start(va, fmt);
+        int size = vsnprintf(str, sizeof(str), fmt, va);
+        va_end(va);
+        if(size < 0) return;
+        if((size_t)size < sizeof(str)) {
+            Write(str, (size_t)size);
+        } else {
+            std::vector<char> longStr((size_t)size + 1);
+            va_start(va, fmt);
+            vsnprintf(longStr.data(), longStr.size(), fmt, va);
+            va_end(va);
+            Write(longStr.data(), (size_t)size);
+        }
+    }
+    void Flush() {
+        if(buffer.empty()) return;
+        fwrite(buffer.data(), 1, buffer.size(), f);
+        buffer.clear();
+    }
+};
+
 //-----------------------------------------------------------------------------
 // Export the mesh as an STL file; it should always be vertex-to-vertex and
 // not self-intersecting, so not much to do.
 //-----------------------------------------------------------------------------
 void SolveSpaceUI::ExportMeshAsStlTo(FILE *f, SMesh *sm) {
+    BufferedMeshWriter w(f);
+
     char str[80] = {};
     strcpy(str, "STL exported mesh");
-    fwrite(str, 1, 80, f);
+    w.Write(str, 80);
+    w.WriteUint32((uint32_t)sm->l.n);
 
-    uint32_t n = sm->l.n;
-    fwrite(&n, 4, 1, f);
+    double s = SS.exportScale;
+    for(const STriangle &tr : sm->l) {
+        Vector n = tr.Normal().WithMagnitude(1);
+        w.WriteFloat(n.x);
+        w.WriteFloat(n.y);
+        w.WriteFloat(n.z);
+        for(int i = 0; i < 3; i++) {
+            w.WriteFloat(tr.vertices[i].x / s);
+            w.WriteFloat(tr.vertices[i].y / s);
+            w.WriteFloat(tr.vertices[i].z / s);
+        }
+        w.WriteUint8(0);
+        w.WriteUint8(0);
+    }
+    w.Flush();
+}
+
+//-----------------------------------------------------------------------------
+// Export the mesh as a binary little-endian PLY file, with shared vertices
+// and a color on each face. PLY wants the element counts in the header, so
+// the indexed mesh is built in compact form first, and then written out.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::ExportMeshAsPlyTo(FILE *f, Group *g) {
+    struct Face {
+        uint32_t  vertex[3];
+        RgbaColor color;
+    };
+    std::unordered_map<Vector, uint32_t, VectorHash, VectorPred> vertexIndex;
+    std::vector<float> vertices;
+    std::vector<Face>  faces;
 
     double s = SS.exportScale;
-    int i;
-    for(i = 0; i < sm->l.n; i++) {
-        STriangle *tr = &(sm->l.elem[i]);
-        Vector n = tr->Normal().WithMagnitude(1);
-        float w;
-        w = (float)n.x;           fwrite(&w, 4, 1, f);
-        w = (float)n.y;           fwrite(&w, 4, 1, f);
-        w = (float)n.z;           fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->a.z)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->b.z)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.x)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.y)/s); fwrite(&w, 4, 1, f);
-        w = (float)((tr->c.z)/s); fwrite(&w, 4, 1, f);
-        fputc(0, f);
-        fputc(0, f);
+    g->ForEachDisplayTriangle([&](const STriangle &tr) {
+        Face face;
+        for(int i = 0; i < 3; i++) {
+            auto it = vertexIndex.emplace(tr.vertices[i], (uint32_t)vertexIndex.size());
+            if(it.second) {
+                vertices.push_back((float)(tr.vertices[i].x / s));
+                vertices.push_back((float)(tr.vertices[i].y / s));
+                vertices.push_back((float)(tr.vertices[i].z / s));
+            }
+            face.vertex[i] = it.first->second;
+        }
+        face.color = tr.meta.color;
+        faces.push_back(face);
+    });
+    vertexIndex.clear();
+
+    BufferedMeshWriter w(f);
+    w.WriteString(ssprintf("ply\n"
+                           "format binary_little_endian 1.0\n"
+                           "comment SolveSpace exported mesh\n"
+                           "element vertex %u\n"
+                           "property float x\n"
+                           "property float y\n"
+                           "property float z\n"
+                           "element face %u\n"
+                           "property list uchar uint vertex_indices\n"
+                           "property uchar red\n"
+                           "property uchar green\n"
+                           "property uchar blue\n"
+                           "property uchar alpha\n"
+                           "end_header\n",
+                           (unsigned)(vertices.size() / 3), (unsigned)faces.size()));
+    w.Write(vertices.data(), vertices.size() * sizeof(float));
+    for(const Face &face : faces) {
+        w.WriteUint8(3);
+        w.Write(face.vertex, sizeof(face.vertex));
+        w.WriteUint8(face.color.red);
+        w.WriteUint8(face.color.green);
+        w.WriteUint8(face.color.blue);
+        w.WriteUint8(face.color.alpha);
     }
 }
 
+//-----------------------------------------------------------------------------
+// Export the mesh as a binary glTF 2.0 (.glb) file: a single indexed triangle
+// primitive, with positions and per-vertex colors. Vertices are shared only
+// between triangles of the same color, so that the colors stay crisp. The
+// model is rotated from our Z-up convention into glTF's Y-up.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::ExportMeshAsGltfTo(FILE *f, Group *g) {
+    std::map<RgbaColor, std::unordered_map<Vector, uint32_t, VectorHash, VectorPred>,
+             RgbaColorCompare> vertexIndex;
+    std::vector<float>    positions;
+    std::vector<uint8_t>  colors;
+    std::vector<uint32_t> indices;
+    Vector bndl = Vector::From(VERY_POSITIVE, VERY_POSITIVE, VERY_POSITIVE),
+           bndh = Vector::From(VERY_NEGATIVE, VERY_NEGATIVE, VERY_NEGATIVE);
+    bool transparent = false;
+
+    double s = SS.exportScale;
+    g->ForEachDisplayTriangle([&](const STriangle &tr) {
+        RgbaColor color = tr.meta.color;
+        auto &colorVertexIndex = vertexIndex[color];
+        for(int i = 0; i < 3; i++) {
+            uint32_t index = (uint32_t)(positions.size() / 3);
+            auto it = colorVertexIndex.emplace(tr.vertices[i], index);
+            if(it.second) {
+                Vector p = tr.vertices[i].ScaledBy(1 / s);
+                positions.push_back((float)p.x);
+                positions.push_back((float)p.y);
+                positions.push_back((float)p.z);
+                colors.push_back(color.red);
+                colors.push_back(color.green);
+                colors.push_back(color.blue);
+                colors.push_back(color.alpha);
+                bndh = Vector::From(max(bndh.x, p.x), max(bndh.y, p.y), max(bndh.z, p.z));
+                bndl = Vector::From(min(bndl.x, p.x), min(bndl.y, p.y), min(bndl.z, p.z));
+            }
+            indices.push_back(it.first->second);
+        }
+        if(color.alpha != 255) transparent = true;
+    });
+    vertexIndex.clear();
+
+    uint32_t vertexCount     = (uint32_t)(positions.size() / 3),
+             positionsLength = (uint32_t)(positions.size() * sizeof(float)),
+             colorsLength    = (uint32_t)(colors.size()),
+             indicesLength   = (uint32_t)(indices.size() * sizeof(uint32_t)),
+             binLength       = positionsLength + colorsLength + indicesLength;
+
+    // The accessor bounds must match the stored single precision values.
+    std::string json = ssprintf(
+        R"({"asset":{"version":"2.0","generator":"SolveSpace"},)"
+        R"("scene":0,"scenes":[{"nodes":[0]}],)"
+        R"("nodes":[{"mesh":0,"rotation":[-0.70710678,0,0,0.70710678]}],)"
+        R"("meshes":[{"primitives":[{"attributes":{"POSITION":0,"COLOR_0":1},)"
+            R"("indices":2,"material":0,"mode":4}]}],)"
+        R"("materials":[{"pbrMetallicRoughness":{"baseColorFactor":[1,1,1,1],)"
+            R"("metallicFactor":0,"roughnessFactor":1},"alphaMode":"%s"}],)"
+        R"("buffers":[{"byteLength":%u}],)"
+        R"("bufferViews":[)"
+            R"({"buffer":0,"byteOffset":0,"byteLength":%u,"target":34962},)"
+            R"({"buffer":0,"byteOffset":%u,"byteLength":%u,"target":34962},)"
+            R"({"buffer":0,"byteOffset":%u,"byteLength":%u,"target":34963}],)"
+        R"("accessors":[)"
+            R"({"bufferView":0,"componentType":5126,"count":%u,"type":"VEC3",)"
+                R"("min":[%.9g,%.9g,%.9g],"max":[%.9g,%.9g,%.9g]},)"
+            R"({"bufferView":1,"componentType":5121,"normalized":true,"count":%u,"type":"VEC4"},)"
+            R"({"bufferView":2,"componentType":5125,"count":%u,"type":"SCALAR"}]})",
+        transparent ? "BLEND" : "OPAQUE",
+        binLength,
+        positionsLength,
+        positionsLength, colorsLength,
+        positionsLength + colorsLength, indicesLength,
+        vertexCount,
+        (float)bndl.x, (float)bndl.y, (float)bndl.z,
+        (float)bndh.x, (float)bndh.y, (float)bndh.z,
+        vertexCount,
+        (unsigned)indices.size());
+    // Both chunks must be padded to a multiple of four bytes; the JSON one
+    // with spaces. The binary one already is, since every part of it is.
+    while(json.size() % 4 != 0) json += ' ';
+
+    BufferedMeshWriter w(f);
+    w.WriteUint32(0x46546C67); // "glTF"
+    w.WriteUint32(2);
+    w.WriteUint32(12 + 8 + (uint32_t)json.size() + 8 + binLength);
+    w.WriteUint32((uint32_t)json.size());
+    w.WriteUint32(0x4E4F534A); // "JSON"
+    w.WriteString(json);
+    w.WriteUint32(binLength);
+    w.WriteUint32(0x004E4942); // "BIN\0"
+    w.Write(positions.data(), positionsLength);
+    w.Write(colors.data(),    colorsLength);
+    w.Write(indices.data(),   indicesLength);
+}
+
 //-----------------------------------------------------------------------------
 // Export the mesh as Wavefront OBJ format. This requires us to reduce all the
-// identical vertices to the same identifier, so do that first.
+// identical vertices (and normals) to the same identifier, so do that first;
+// a hash map makes that linear in the size of the mesh.
 //-----------------------------------------------------------------------------
 void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
     std::map<RgbaColor, std::string, RgbaColorCompare> colors;
+    std::unordered_map<Vector, int, VectorHash, VectorPred> vertexIndex, normalIndex;
+    std::vector<Vector> vertices, normals;
+    std::vector<int> faceVertices, faceNormals;
+    faceVertices.reserve(sm->l.n * 3);
+    faceNormals.reserve(sm->l.n * 3);
+
+    auto IndexFor = [](std::unordered_map<Vector, int, VectorHash, VectorPred> *index,
+                       std::vector<Vector> *list, Vector v) {
+        auto it = index->emplace(v, (int)list->size() + 1);
+        if(it.second) list->push_back(v);
+        return it.first->second;
+    };
+
     for(const STriangle &t : sm->l) {
         RgbaColor color = t.meta.color;
         if(colors.find(color) == colors.end()) {
@@ -893,10 +1333,13 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
             colors.emplace(color, id);
         }
         for(int i = 0; i < 3; i++) {
-            fprintf(fObj, "v %.10f %.10f %.10f\n",
-                    CO(t.vertices[i].ScaledBy(1 / SS.exportScale)));
+            faceVertices.push_back(IndexFor(&vertexIndex, &vertices, t.vertices[i]));
+            faceNormals.push_back(IndexFor(&normalIndex, &normals,
+                                           t.normals[i].WithMagnitude(1.0)));
         }
     }
+    vertexIndex.clear();
+    normalIndex.clear();
 
     for(auto &it : colors) {
         fprintf(fMtl, "newmtl %s\n",
@@ -905,12 +1348,14 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
                 it.first.redF(), it.first.greenF(), it.first.blueF());
     }
 
-    for(const STriangle &t : sm->l) {
-        for(int i = 0; i < 3; i++) {
-            Vector n = t.normals[i].WithMagnitude(1.0);
-            fprintf(fObj, "vn %.10f %.10f %.10f\n",
-                    CO(n));
-        }
+    BufferedMeshWriter w(fObj);
+    for(const Vector &v : vertices) {
+        w.Printf("v %.10f %.10f %.10f\n",
+                 CO(v.ScaledBy(1 / SS.exportScale)));
+    }
+    for(const Vector &n : normals) {
+        w.Printf("vn %.10f %.10f %.10f\n",
+                 CO(n));
     }
 
     RgbaColor currentColor = {};
@@ -918,13 +1363,13 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
         const STriangle &t = sm->l.elem[i];
         if(!currentColor.Equals(t.meta.color)) {
             currentColor = t.meta.color;
-            fprintf(fObj, "usemtl %s\n", colors[currentColor].c_str());
+            w.Printf("usemtl %s\n", colors[currentColor].c_str());
         }
 
-        fprintf(fObj, "f %d//%d %d//%d %d//%d\n",
-                i * 3 + 1, i * 3 + 1,
-                i * 3 + 2, i * 3 + 2,
-                i * 3 + 3, i * 3 + 3);
+        w.Printf("f %d//%d %d//%d %d//%d\n",
+                 faceVertices[i * 3 + 0], faceNormals[i * 3 + 0],
+                 faceVertices[i * 3 + 1], faceNormals[i * 3 + 1],
+                 faceVertices[i * 3 + 2], faceNormals[i * 3 + 2]);
     }
 }
 
@@ -934,7 +1379,6 @@ void SolveSpaceUI::ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm) {
 void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename,
                                          SMesh *sm, SOutlineList *sol)
 {
-    SPointList spl = {};
     STriangle *tr;
     Vector bndl, bndh;
     const char htmlbegin[] = R"(
@@ -1030,64 +1474,73 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
     fprintf(f, "    ],\n"
                "    a: %f\n", SS.ambientIntensity);
 
+    // Reduce identical vertices to the same index; hashing them keeps this
+    // linear in the size of the mesh.
+    std::unordered_map<Vector, int, VectorHash, VectorPred> pointIndex;
+    std::vector<Vector> points;
+    std::vector<int> faces;
+    faces.reserve(sm->l.n * 3);
     for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        spl.IncrementTagFor(tr->a);
-        spl.IncrementTagFor(tr->b);
-        spl.IncrementTagFor(tr->c);
+        for(int i = 0; i < 3; i++) {
+            auto it = pointIndex.emplace(tr->vertices[i], (int)points.size());
+            if(it.second) points.push_back(tr->vertices[i]);
+            faces.push_back(it.first->second);
+        }
     }
+    pointIndex.clear();
+
+    BufferedMeshWriter w(f);
 
     // Output all the vertices.
-    SPoint *sp;
-    fputs("  },\n"
-          "  points: [\n", f);
-    for(sp = spl.l.First(); sp; sp = spl.l.NextAfter(sp)) {
-        fprintf(f, "    [%f, %f, %f],\n",
-                sp->p.x / SS.exportScale,
-                sp->p.y / SS.exportScale,
-                sp->p.z / SS.exportScale);
-    }
-
-    fputs("  ],\n"
-          "  faces: [\n", f);
+    w.Printf("  },\n"
+             "  points: [\n");
+    for(const Vector &p : points) {
+        w.Printf("    [%f, %f, %f],\n",
+                 p.x / SS.exportScale,
+                 p.y / SS.exportScale,
+                 p.z / SS.exportScale);
+    }
+
+    w.Printf("  ],\n"
+             "  faces: [\n");
     // And now all the triangular faces, in terms of those vertices.
     // This time we count from zero.
-    for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    [%d, %d, %d],\n",
-                spl.IndexForPoint(tr->a),
-                spl.IndexForPoint(tr->b),
-                spl.IndexForPoint(tr->c));
+    for(size_t i = 0; i < faces.size(); i += 3) {
+        w.Printf("    [%d, %d, %d],\n",
+                 faces[i + 0], faces[i + 1], faces[i + 2]);
     }
 
     // Output face normals.
-    fputs("  ],\n"
-          "  normals: [\n", f);
+    w.Printf("  ],\n"
+             "  normals: [\n");
     for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    [[%f, %f, %f], [%f, %f, %f], [%f, %f, %f]],\n",
-                CO(tr->an), CO(tr->bn), CO(tr->cn));
+        w.Printf("    [[%f, %f, %f], [%f, %f, %f], [%f, %f, %f]],\n",
+                 CO(tr->an), CO(tr->bn), CO(tr->cn));
     }
 
-    fputs("  ],\n"
-          "  colors: [\n", f);
+    w.Printf("  ],\n"
+             "  colors: [\n");
     // Output triangle colors.
     for(tr = sm->l.First(); tr; tr = sm->l.NextAfter(tr)) {
-        fprintf(f, "    0x%x,\n", tr->meta.color.ToARGB32());
+        w.Printf("    0x%x,\n", tr->meta.color.ToARGB32());
     }
 
-    fputs("  ],\n"
-          "  edges: [\n", f);
+    w.Printf("  ],\n"
+             "  edges: [\n");
     // Output edges. Assume user's model colors do not obscure white edges.
     for(const SOutline &so : sol->l) {
         if(so.tag == 0) continue;
-        fprintf(f, "    [[%f, %f, %f], [%f, %f, %f]],\n",
-                so.a.x / SS.exportScale,
-                so.a.y / SS.exportScale,
-                so.a.z / SS.exportScale,
-                so.b.x / SS.exportScale,
-                so.b.y / SS.exportScale,
-                so.b.z / SS.exportScale);
+        w.Printf("    [[%f, %f, %f], [%f, %f, %f]],\n",
+                 so.a.x / SS.exportScale,
+                 so.a.y / SS.exportScale,
+                 so.a.z / SS.exportScale,
+                 so.b.x / SS.exportScale,
+                 so.b.y / SS.exportScale,
+                 so.b.z / SS.exportScale);
     }
 
-    fputs("  ]\n};\n", f);
+    w.Printf("  ]\n};\n");
+    w.Flush();
 
     if(filename.HasExtension("html")) {
         fprintf(f, htmlend,
@@ -1097,8 +1550,6 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
                 CO(SS.GW.projUp),
                 CO(SS.GW.projRight));
     }
-
-    spl.Clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -1106,6 +1557,7 @@ void SolveSpaceUI::ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename
 // rendering the view in the usual way and then copying the pixels.
 //-----------------------------------------------------------------------------
 void SolveSpaceUI::ExportAsPngTo(const Platform::Path &filename) {
+    TRACE_SCOPE("SolveSpaceUI::ExportAsPngTo");
     screenshotFile = filename;
     // The rest of the work is done in the next redraw.
     InvalidateGraphics();
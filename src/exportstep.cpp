@@ -81,150 +81,212 @@ void StepFileWriter::WriteProductHeader() {
 		"\n"
 		);
 }
-int StepFileWriter::ExportCurve(SBezier *sb) {
-    int i, ret = id;
+//-----------------------------------------------------------------------------
+// Write a point, unless an identical one has already been written, and return
+// its id. Control points and vertices that coincide all share one entity.
+//-----------------------------------------------------------------------------
+static std::string PointText(Vector p) {
+    return ssprintf("(%.10f,%.10f,%.10f)", CO(p));
+}
+
+int StepFileWriter::ExportPoint(Vector p) {
+    auto it = points.find(p);
+    if(it != points.end()) return it->second;
 
-    fprintf(f, "#%d=(\n", ret);
-    fprintf(f, "BOUNDED_CURVE()\n");
-    fprintf(f, "B_SPLINE_CURVE(%d,(", sb->deg);
+    int ret = id++;
+    fprintf(f, "#%d=CARTESIAN_POINT('',%s);\n", ret, PointText(p).c_str());
+    points.emplace(p, ret);
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+// The text of a rational Bezier curve entity, everything after its "#id=",
+// given the references to its control points.
+//-----------------------------------------------------------------------------
+static std::string CurveText(const SBezier *sb, const std::string *ctrl) {
+    int i;
+    std::string text = "(\nBOUNDED_CURVE()\n";
+    text += ssprintf("B_SPLINE_CURVE(%d,(", sb->deg);
     for(i = 0; i <= sb->deg; i++) {
-        fprintf(f, "#%d", ret + i + 1);
-        if(i != sb->deg) fprintf(f, ",");
+        text += ctrl[i];
+        if(i != sb->deg) text += ",";
     }
-    fprintf(f, "),.UNSPECIFIED.,.F.,.F.)\n");
-    fprintf(f, "B_SPLINE_CURVE_WITH_KNOTS((%d,%d),",
+    text += "),.UNSPECIFIED.,.F.,.F.)\n";
+    text += ssprintf("B_SPLINE_CURVE_WITH_KNOTS((%d,%d),",
         (sb->deg + 1), (sb-> deg + 1));
-    fprintf(f, "(0.000,1.000),.UNSPECIFIED.)\n");
-    fprintf(f, "CURVE()\n");
-    fprintf(f, "GEOMETRIC_REPRESENTATION_ITEM()\n");
-    fprintf(f, "RATIONAL_B_SPLINE_CURVE((");
+    text += "(0.000,1.000),.UNSPECIFIED.)\n";
+    text += "CURVE()\n";
+    text += "GEOMETRIC_REPRESENTATION_ITEM()\n";
+    text += "RATIONAL_B_SPLINE_CURVE((";
     for(i = 0; i <= sb->deg; i++) {
-        fprintf(f, "%.10f", sb->weight[i]);
-        if(i != sb->deg) fprintf(f, ",");
+        text += ssprintf("%.10f", sb->weight[i]);
+        if(i != sb->deg) text += ",";
     }
-    fprintf(f, "))\n");
-    fprintf(f, "REPRESENTATION_ITEM('')\n);\n");
+    text += "))\n";
+    text += "REPRESENTATION_ITEM('')\n);\n";
+    return text;
+}
 
-    for(i = 0; i <= sb->deg; i++) {
-        fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-            id + 1 + i,
-            CO(sb->ctrl[i]));
+int StepFileWriter::ExportCurve(SBezier *sb) {
+    std::string ctrl[4];
+    for(int i = 0; i <= sb->deg; i++) {
+        ctrl[i] = ssprintf("#%d", ExportPoint(sb->ctrl[i]));
     }
-    fprintf(f, "\n");
 
-    id = ret + 1 + (sb->deg + 1);
+    int ret = id++;
+    fprintf(f, "#%d=%s\n", ret, CurveText(sb, ctrl).c_str());
     return ret;
 }
 
-int StepFileWriter::ExportCurveLoop(SBezierLoop *loop, bool inner) {
-    ssassert(loop->l.n >= 1, "Expected at least one loop");
+//-----------------------------------------------------------------------------
+// Formatting of a single surface, with symbolic references. The points,
+// vertices and edges are listed in the order that they're first needed, so
+// each only ever refers to shared entities listed before it.
+//-----------------------------------------------------------------------------
+void StepFileWriter::SurfaceText::Printf(const char *fmt, ...) {
+    va_list va;
+    char str[256];
+    va_start(va, fmt);
+    int size = vsnprintf(str, sizeof(str), fmt, va);
+    va_end(va);
+    ssassert(size >= 0 && (size_t)size < sizeof(str), "Unexpectedly long STEP line");
+    text.append(str, (size_t)size);
+}
 
-    List<int> listOfTrims = {};
+int StepFileWriter::SurfaceText::Point(Vector p) {
+    auto it = pointIndex.find(p);
+    if(it != pointIndex.end()) return it->second;
+
+    SharedEntity se = {};
+    se.type = SharedEntity::Type::POINT;
+    se.p    = p;
+    se.text = PointText(p);
+    shared.push_back(se);
+    pointIndex.emplace(p, (int)shared.size() - 1);
+    return (int)shared.size() - 1;
+}
 
-    SBezier *sb = &(loop->l.elem[loop->l.n - 1]);
+int StepFileWriter::SurfaceText::Vertex(Vector p) {
+    auto it = vertexIndex.find(p);
+    if(it != vertexIndex.end()) return it->second;
+
+    SharedEntity se = {};
+    se.type   = SharedEntity::Type::VERTEX;
+    se.p      = p;
+    se.ref[0] = Point(p);
+    shared.push_back(se);
+    vertexIndex.emplace(p, (int)shared.size() - 1);
+    return (int)shared.size() - 1;
+}
 
-    // Generate "exactly closed" contours, with the same vertex id for the
-    // finish of a previous edge and the start of the next one. So we need
-    // the finish of the last Bezier in the loop before we start our process.
-    fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-        id, CO(sb->Finish()));
-    fprintf(f, "#%d=VERTEX_POINT('',#%d);\n", id+1, id);
-    int lastFinish = id + 1, prevFinish = lastFinish;
-    id += 2;
+int StepFileWriter::SurfaceText::Edge(SBezier *sb, int startVertex, int finishVertex) {
+    std::string ctrl[4];
+    for(int i = 0; i <= sb->deg; i++) {
+        ctrl[i] = ssprintf("#@%d", Point(sb->ctrl[i]));
+    }
+
+    SharedEntity se = {};
+    se.type   = SharedEntity::Type::EDGE;
+    se.p      = sb->ctrl[1];
+    se.ref[0] = startVertex;
+    se.ref[1] = finishVertex;
+    se.curve  = sb->entity;
+    se.text   = CurveText(sb, ctrl);
+    shared.push_back(se);
+    return (int)shared.size() - 1;
+}
+
+int StepFileWriter::SurfaceText::CurveLoop(SBezierLoop *loop, bool inner) {
+    ssassert(loop->l.n >= 1, "Expected at least one loop");
 
+    // Generate "exactly closed" contours, with the same vertex id for the
+    // finish of a previous edge and the start of the next one. So find the
+    // vertex at the start of every Bezier first.
+    std::vector<int> startVertices;
+    SBezier *sb;
     for(sb = loop->l.First(); sb; sb = loop->l.NextAfter(sb)) {
-        int curveId = ExportCurve(sb);
-
-        int thisFinish;
-        if(loop->l.NextAfter(sb) != NULL) {
-            fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-                id, CO(sb->Finish()));
-            fprintf(f, "#%d=VERTEX_POINT('',#%d);\n", id+1, id);
-            thisFinish = id + 1;
-            id += 2;
-        } else {
-            thisFinish = lastFinish;
-        }
+        startVertices.push_back(Vertex(sb->Start()));
+    }
 
-        fprintf(f, "#%d=EDGE_CURVE('',#%d,#%d,#%d,%s);\n",
-            id, prevFinish, thisFinish, curveId, ".T.");
-        fprintf(f, "#%d=ORIENTED_EDGE('',*,*,#%d,.T.);\n",
-            id+1, id);
+    List<int> listOfTrims = {};
+    for(int i = 0; i < loop->l.n; i++) {
+        sb = &(loop->l.elem[i]);
+        int thisStart  = startVertices[i],
+            thisFinish = startVertices[(i + 1) % loop->l.n];
 
-        int oe = id+1;
-        listOfTrims.Add(&oe);
-        id += 2;
+        int edge = Edge(sb, thisStart, thisFinish);
+        Printf("#%d=ORIENTED_EDGE('',*,*,#@%d,.@%d.);\n",
+            entities, edge, edge);
 
-        prevFinish = thisFinish;
+        int oe = entities;
+        listOfTrims.Add(&oe);
+        entities++;
     }
 
-    fprintf(f, "#%d=EDGE_LOOP('',(", id);
+    Printf("#%d=EDGE_LOOP('',(", entities);
     int *oe;
     for(oe = listOfTrims.First(); oe; oe = listOfTrims.NextAfter(oe)) {
-        fprintf(f, "#%d", *oe);
-        if(listOfTrims.NextAfter(oe) != NULL) fprintf(f, ",");
+        Printf("#%d", *oe);
+        if(listOfTrims.NextAfter(oe) != NULL) Printf(",");
     }
-    fprintf(f, "));\n");
+    Printf("));\n");
 
-    int fb = id + 1;
-        fprintf(f, "#%d=%s('',#%d,.T.);\n",
-            fb, inner ? "FACE_BOUND" : "FACE_OUTER_BOUND", id);
+    int fb = entities + 1;
+        Printf("#%d=%s('',#%d,.T.);\n",
+            fb, inner ? "FACE_BOUND" : "FACE_OUTER_BOUND", entities);
 
-    id += 2;
+    entities += 2;
     listOfTrims.Clear();
 
     return fb;
 }
 
-void StepFileWriter::ExportSurface(SSurface *ss, SBezierList *sbl) {
-    int i, j, srfid = id;
+void StepFileWriter::SurfaceText::Surface(SSurface *ss, SBezierList *sbl) {
+    int i, j, ctrl[4][4];
 
-    // First, we create the untrimmed surface. We always specify a rational
-    // B-spline surface (in fact, just a Bezier surface).
-    fprintf(f, "#%d=(\n", srfid);
-    fprintf(f, "BOUNDED_SURFACE()\n");
-    fprintf(f, "B_SPLINE_SURFACE(%d,%d,(", ss->degm, ss->degn);
+    // The control points for the untrimmed surface.
     for(i = 0; i <= ss->degm; i++) {
-        fprintf(f, "(");
         for(j = 0; j <= ss->degn; j++) {
-            fprintf(f, "#%d", srfid + 1 + j + i*(ss->degn + 1));
-            if(j != ss->degn) fprintf(f, ",");
+            ctrl[i][j] = Point(ss->ctrl[i][j]);
         }
-        fprintf(f, ")");
-        if(i != ss->degm) fprintf(f, ",");
     }
-    fprintf(f, "),.UNSPECIFIED.,.F.,.F.,.F.)\n");
-    fprintf(f, "B_SPLINE_SURFACE_WITH_KNOTS((%d,%d),(%d,%d),",
-        (ss->degm + 1), (ss->degm + 1),
-        (ss->degn + 1), (ss->degn + 1));
-    fprintf(f, "(0.000,1.000),(0.000,1.000),.UNSPECIFIED.)\n");
-    fprintf(f, "GEOMETRIC_REPRESENTATION_ITEM()\n");
-    fprintf(f, "RATIONAL_B_SPLINE_SURFACE((");
+
+    // Then we create the untrimmed surface. We always specify a rational
+    // B-spline surface (in fact, just a Bezier surface).
+    int srfid = entities++;
+    Printf("#%d=(\n", srfid);
+    Printf("BOUNDED_SURFACE()\n");
+    Printf("B_SPLINE_SURFACE(%d,%d,(", ss->degm, ss->degn);
     for(i = 0; i <= ss->degm; i++) {
-        fprintf(f, "(");
+        Printf("(");
         for(j = 0; j <= ss->degn; j++) {
-            fprintf(f, "%.10f", ss->weight[i][j]);
-            if(j != ss->degn) fprintf(f, ",");
+            Printf("#@%d", ctrl[i][j]);
+            if(j != ss->degn) Printf(",");
         }
-        fprintf(f, ")");
-        if(i != ss->degm) fprintf(f, ",");
+        Printf(")");
+        if(i != ss->degm) Printf(",");
     }
-    fprintf(f, "))\n");
-    fprintf(f, "REPRESENTATION_ITEM('')\n");
-    fprintf(f, "SURFACE()\n");
-    fprintf(f, ");\n");
-
-    // The control points for the untrimmed surface.
+    Printf("),.UNSPECIFIED.,.F.,.F.,.F.)\n");
+    Printf("B_SPLINE_SURFACE_WITH_KNOTS((%d,%d),(%d,%d),",
+        (ss->degm + 1), (ss->degm + 1),
+        (ss->degn + 1), (ss->degn + 1));
+    Printf("(0.000,1.000),(0.000,1.000),.UNSPECIFIED.)\n");
+    Printf("GEOMETRIC_REPRESENTATION_ITEM()\n");
+    Printf("RATIONAL_B_SPLINE_SURFACE((");
     for(i = 0; i <= ss->degm; i++) {
+        Printf("(");
         for(j = 0; j <= ss->degn; j++) {
-            fprintf(f, "#%d=CARTESIAN_POINT('',(%.10f,%.10f,%.10f));\n",
-                srfid + 1 + j + i*(ss->degn + 1),
-                CO(ss->ctrl[i][j]));
+            Printf("%.10f", ss->weight[i][j]);
+            if(j != ss->degn) Printf(",");
         }
+        Printf(")");
+        if(i != ss->degm) Printf(",");
     }
-    fprintf(f, "\n");
-
-    id = srfid + 1 + (ss->degm + 1)*(ss->degn + 1);
+    Printf("))\n");
+    Printf("REPRESENTATION_ITEM('')\n");
+    Printf("SURFACE()\n");
+    Printf(");\n");
+    Printf("\n");
 
     // Now we do the trim curves. We must group each outer loop separately
     // along with its inner faces, so do that now.
@@ -251,38 +313,193 @@ void StepFileWriter::ExportSurface(SSurface *ss, SBezierList *sbl) {
 
         List<int> listOfLoops = {};
         // Create the face outer boundary from the outer loop.
-        int fob = ExportCurveLoop(loop, /*inner=*/false);
+        int fob = CurveLoop(loop, /*inner=*/false);
         listOfLoops.Add(&fob);
 
         // And create the face inner boundaries from any inner loops that
         // lie within this contour.
         loop = sbls->l.NextAfter(loop);
         for(; loop; loop = sbls->l.NextAfter(loop)) {
-            int fib = ExportCurveLoop(loop, /*inner=*/true);
+            int fib = CurveLoop(loop, /*inner=*/true);
             listOfLoops.Add(&fib);
         }
 
         // And now create the face that corresponds to this outer loop
         // and all of its holes.
-        int advFaceId = id;
-        fprintf(f, "#%d=ADVANCED_FACE('',(", advFaceId);
+        int advFaceId = entities;
+        Printf("#%d=ADVANCED_FACE('',(", advFaceId);
         int *fb;
         for(fb = listOfLoops.First(); fb; fb = listOfLoops.NextAfter(fb)) {
-            fprintf(f, "#%d", *fb);
-            if(listOfLoops.NextAfter(fb) != NULL) fprintf(f, ",");
+            Printf("#%d", *fb);
+            if(listOfLoops.NextAfter(fb) != NULL) Printf(",");
         }
 
-        fprintf(f, "),#%d,.T.);\n", srfid);
-        fprintf(f, "\n");
-        advancedFaces.Add(&advFaceId);
+        Printf("),#%d,.T.);\n", srfid);
+        Printf("\n");
+        faces.push_back(advFaceId);
 
-        id++;
+        entities++;
         listOfLoops.Clear();
     }
     sblss.Clear();
     spxyz.Clear();
 }
 
+//-----------------------------------------------------------------------------
+// Work out the trim loops of a surface and format it. This doesn't touch the
+// writer or the shell, so it's safe to run for many surfaces at once.
+//-----------------------------------------------------------------------------
+void StepFileWriter::FormatSurface(SShell *shell, SSurface *ss, SurfaceText *st) {
+    // Get all of the loops of Beziers that trim our surface (with each
+    // Bezier split so that we use the section as t goes from 0 to 1), and
+    // the piecewise linearization of those loops in xyz space.
+    SBezierList sbl = {};
+    ss->MakeSectionEdgesInto(shell, NULL, &sbl);
+
+    // Apply the export scale factor; to a copy, since the trim curves of
+    // the other surfaces are still worked out from this one.
+    SSurface srf = *ss;
+    srf.ScaleSelfBy(1.0/SS.exportScale);
+    sbl.ScaleSelfBy(1.0/SS.exportScale);
+
+    st->Surface(&srf, &sbl);
+
+    sbl.Clear();
+    st->pointIndex.clear();
+    st->vertexIndex.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Replace the symbolic references in a formatted surface with real ids.
+//-----------------------------------------------------------------------------
+static std::string ResolveReferences(const std::string &text, int base,
+                                     const std::vector<int> &sharedIds,
+                                     const std::vector<bool> &sameSense) {
+    std::string out;
+    out.reserve(text.size() + text.size() / 8);
+
+    size_t i = 0;
+    while(i < text.size()) {
+        size_t next = text.find_first_of("#.", i);
+        if(next == std::string::npos) {
+            out.append(text, i, std::string::npos);
+            break;
+        }
+        out.append(text, i, next - i);
+
+        char c = text[next];
+        i = next + 1;
+        bool isShared = (i < text.size() && text[i] == '@');
+        if(c == '.' && !isShared) {
+            out += '.';
+            continue;
+        }
+        if(isShared) i++;
+
+        int n = 0;
+        while(i < text.size() && isdigit(text[i])) {
+            n = n * 10 + (text[i] - '0');
+            i++;
+        }
+        if(c == '#') {
+            out += ssprintf("#%d", isShared ? sharedIds[n] : base + n);
+        } else {
+            // The sense of a shared edge, ".@n."; skip the closing dot.
+            out += sameSense[n] ? ".T." : ".F.";
+            i++;
+        }
+    }
+    return out;
+}
+
+//-----------------------------------------------------------------------------
+// Assign ids to a formatted surface and write it out. Points, vertices and
+// edges that an earlier surface already wrote are used from there; every
+// trim curve of a closed shell bounds two faces, so the second face to get
+// here uses the edge in the opposite sense. Edges are keyed on their vertices
+// and on the SCurve that they came from, which MakeSectionEdgesInto leaves in
+// each Bezier's entity field.
+//-----------------------------------------------------------------------------
+size_t StepFileWriter::EdgeKeyHash::operator()(const EdgeKey &k) const {
+    return (size_t)k.curve * 31 * 31 + (size_t)k.vertexA * 31 + (size_t)k.vertexB;
+}
+
+void StepFileWriter::WriteSurface(SurfaceText *st) {
+    std::vector<int>  sharedIds(st->shared.size());
+    std::vector<bool> sameSense(st->shared.size(), true);
+
+    for(size_t i = 0; i < st->shared.size(); i++) {
+        const SharedEntity &se = st->shared[i];
+        switch(se.type) {
+            case SharedEntity::Type::POINT: {
+                auto it = points.find(se.p);
+                if(it != points.end()) {
+                    sharedIds[i] = it->second;
+                    break;
+                }
+                sharedIds[i] = id++;
+                fprintf(f, "#%d=CARTESIAN_POINT('',%s);\n",
+                    sharedIds[i], se.text.c_str());
+                points.emplace(se.p, sharedIds[i]);
+                break;
+            }
+
+            case SharedEntity::Type::VERTEX: {
+                auto it = vertices.find(se.p);
+                if(it != vertices.end()) {
+                    sharedIds[i] = it->second;
+                    break;
+                }
+                sharedIds[i] = id++;
+                fprintf(f, "#%d=VERTEX_POINT('',#%d);\n",
+                    sharedIds[i], sharedIds[se.ref[0]]);
+                vertices.emplace(se.p, sharedIds[i]);
+                break;
+            }
+
+            case SharedEntity::Type::EDGE: {
+                int startVertex  = sharedIds[se.ref[0]],
+                    finishVertex = sharedIds[se.ref[1]];
+                EdgeKey key = { se.curve,
+                                min(startVertex, finishVertex),
+                                max(startVertex, finishVertex) };
+                auto it = edges.find(key);
+                if(it != edges.end()) {
+                    const SharedEdge &e = it->second;
+                    sharedIds[i] = e.id;
+                    if(startVertex != finishVertex) {
+                        sameSense[i] = (e.startVertex == startVertex);
+                    } else {
+                        // A closed curve; both ends are at the same vertex,
+                        // so tell the direction from the control points.
+                        sameSense[i] = e.secondCtrl.Equals(se.p);
+                    }
+                    break;
+                }
+
+                int curveId = id++;
+                fprintf(f, "#%d=%s\n", curveId,
+                    ResolveReferences(se.text, 0, sharedIds, sameSense).c_str());
+                sharedIds[i] = id++;
+                fprintf(f, "#%d=EDGE_CURVE('',#%d,#%d,#%d,%s);\n",
+                    sharedIds[i], startVertex, finishVertex, curveId, ".T.");
+                edges.emplace(key, SharedEdge { sharedIds[i], startVertex, se.p });
+                break;
+            }
+        }
+    }
+
+    int base = id;
+    id += st->entities;
+    std::string text = ResolveReferences(st->text, base, sharedIds, sameSense);
+    fwrite(text.data(), 1, text.size(), f);
+
+    for(int face : st->faces) {
+        int advFaceId = base + face;
+        advancedFaces.Add(&advFaceId);
+    }
+}
+
 void StepFileWriter::WriteFooter() {
     fprintf(f,
 "\n"
@@ -293,6 +510,7 @@ void StepFileWriter::WriteFooter() {
 }
 
 void StepFileWriter::ExportSurfacesTo(const Platform::Path &filename) {
+    TRACE_SCOPE("StepFileWriter::ExportSurfacesTo");
     Group *g = SK.GetGroup(SS.GW.activeGroup);
     SShell *shell = &(g->runningShell);
 
@@ -311,28 +529,33 @@ void StepFileWriter::ExportSurfacesTo(const Platform::Path &filename) {
         return;
     }
 
+    // A STEP file for a large shell is a lot of text, so don't make a system
+    // call for every few lines of it.
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+
     WriteHeader();
 	WriteProductHeader();
 
     advancedFaces = {};
 
+    // Formatting the surfaces is most of the work, and each one is formatted
+    // on its own, so spread them over all the cores. Then assign ids and
+    // write them in order, which keeps the output the same from run to run.
+    std::vector<SSurface *> surfaces;
     SSurface *ss;
     for(ss = shell->surface.First(); ss; ss = shell->surface.NextAfter(ss)) {
         if(ss->trim.n == 0) continue;
+        surfaces.push_back(ss);
+    }
 
-        // Get all of the loops of Beziers that trim our surface (with each
-        // Bezier split so that we use the section as t goes from 0 to 1), and
-        // the piecewise linearization of those loops in xyz space.
-        SBezierList sbl = {};
-        ss->MakeSectionEdgesInto(shell, NULL, &sbl);
-
-        // Apply the export scale factor.
-        ss->ScaleSelfBy(1.0/SS.exportScale);
-        sbl.ScaleSelfBy(1.0/SS.exportScale);
-
-        ExportSurface(ss, &sbl);
+    std::vector<SurfaceText> texts(surfaces.size());
+    ParallelFor(surfaces.size(), [&](size_t i) {
+        FormatSurface(shell, surfaces[i], &texts[i]);
+    });
 
-        sbl.Clear();
+    for(SurfaceText &st : texts) {
+        WriteSurface(&st);
+        st = {};
     }
 
     fprintf(f, "#%d=CLOSED_SHELL('',(", id);
@@ -352,6 +575,9 @@ void StepFileWriter::ExportSurfacesTo(const Platform::Path &filename) {
 
     fclose(f);
     advancedFaces.Clear();
+    points.clear();
+    vertices.clear();
+    edges.clear();
 }
 
 void StepFileWriter::WriteWireframe() {
@@ -221,13 +221,17 @@ struct SAVEDptr {
     uint32_t  &x() { return *((uint32_t *)this); }
 };
 
-void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
+void SolveSpaceUI::SaveUsingTable(FILE *fh, const Platform::Path &filename,
+                                  const SaveVars &sv, int type) {
     int i;
     for(i = 0; SAVED[i].type != 0; i++) {
         if(SAVED[i].type != type) continue;
 
         int fmt = SAVED[i].fmt;
-        SAVEDptr *p = (SAVEDptr *)SAVED[i].ptr;
+        // The table points into SS.sv; rebase that onto the variables we were
+        // given, which need not be the global ones.
+        ptrdiff_t offset = (const char *)SAVED[i].ptr - (const char *)&SS.sv;
+        SAVEDptr *p = (SAVEDptr *)((const char *)&sv + offset);
         // Any items that aren't specified are assumed to be zero
         if(fmt == 'S' && p->S().empty())          continue;
         if(fmt == 'P' && p->P().IsEmpty())        continue;
@@ -274,11 +278,108 @@ void SolveSpaceUI::SaveUsingTable(const Platform::Path &filename, int type) {
     }
 }
 
-bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
-    // Make sure all the entities are regenerated up to date, since they will be exported.
-    SS.ScheduleShowTW();
-    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+// The fields of one type of record that are compared, with their offsets in
+// the record. Undo compares every record in the sketch, so these are picked
+// out of SAVED once, instead of going through all of it for each record.
+struct SavedField {
+    ptrdiff_t   offset;
+    char        fmt;
+};
+
+static const std::vector<SavedField> &SavedFieldsFor(int type) {
+    static const char types[] = "gprecs";
+    static const std::vector<std::vector<SavedField>> fields = [] {
+        const void *bases[] = {
+            &SS.sv.g, &SS.sv.p, &SS.sv.r, &SS.sv.e, &SS.sv.c, &SS.sv.s
+        };
+        std::vector<std::vector<SavedField>> fields(sizeof(bases) / sizeof(bases[0]));
+        for(int i = 0; SolveSpaceUI::SAVED[i].type != 0; i++) {
+            const SolveSpaceUI::SaveTable &st = SolveSpaceUI::SAVED[i];
+            if(st.fmt == 'i') continue;
+            size_t k = strchr(types, st.type) - types;
+            SavedField field = { (const char *)st.ptr - (const char *)bases[k], st.fmt };
+            fields[k].push_back(field);
+        }
+        return fields;
+    }();
+
+    const char *t = (type != 0) ? strchr(types, type) : NULL;
+    ssassert(t != NULL, "Unexpected record type");
+    return fields[t - types];
+}
+
+//-----------------------------------------------------------------------------
+// Whether two records of the given type agree in everything that we save for
+// them; anything else about them gets regenerated anyways.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::EqualUsingTable(const void *a, const void *b, int type) {
+    for(const SavedField &field : SavedFieldsFor(type)) {
+        SAVEDptr *pa = (SAVEDptr *)((const char *)a + field.offset);
+        SAVEDptr *pb = (SAVEDptr *)((const char *)b + field.offset);
+        switch(field.fmt) {
+            case 'S': if(pa->S() != pb->S())                    return false; break;
+            case 'P': if(pa->P().raw != pb->P().raw)            return false; break;
+            case 'b': if(pa->b() != pb->b())                    return false; break;
+            case 'c': if(!pa->c().Equals(pb->c()))              return false; break;
+            case 'd': if(pa->d() != pb->d())                    return false; break;
+            case 'f': if(!EXACT(pa->f() == pb->f()))            return false; break;
+            case 'x': if(pa->x() != pb->x())                    return false; break;
+
+            case 'M': {
+                if(pa->M().n != pb->M().n) return false;
+                for(int j = 0; j < pa->M().n; j++) {
+                    EntityMap *ema = &(pa->M().elem[j]),
+                              *emb = &(pb->M().elem[j]);
+                    if(ema->h.v != emb->h.v ||
+                       ema->input.v != emb->input.v ||
+                       ema->copyNumber != emb->copyNumber) return false;
+                }
+                break;
+            }
+
+            default: ssassert(false, "Unexpected value format");
+        }
+    }
+    return true;
+}
+
+static Platform::Path TemporaryFileFor(const Platform::Path &filename) {
+    return Platform::Path::From(filename.raw + ".tmp");
+}
+
+// Close the temporary file that we were writing, and if everything went well,
+// move it over the real one; so an interrupted save never clobbers the
+// previous version of the file.
+static bool CommitTemporaryFile(FILE *fh, const Platform::Path &filename, bool ok) {
+    if(ferror(fh)) ok = false;
+    if(fclose(fh) != 0) ok = false;
+
+    Platform::Path tempFile = TemporaryFileFor(filename);
+    if(ok && Platform::RenameFile(tempFile, filename)) return true;
 
+    RemoveFile(tempFile);
+    return false;
+}
+
+void SolveSpaceUI::SaveSnapshot::Clear() {
+    for(Group &g : group) {
+        g.remap.Clear();
+    }
+    group.clear();
+    param.clear();
+    request.clear();
+    entity.clear();
+    constraint.clear();
+    style.clear();
+    mesh.Clear();
+    shell.Clear();
+}
+
+//-----------------------------------------------------------------------------
+// Copy everything that we save out of the sketch. The copy shares no memory
+// with the sketch, so that it stays valid while the user keeps editing.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::MakeSaveSnapshot(const Platform::Path &filename, SaveSnapshot *snap) {
     for(Group &g : SK.group) {
         if(g.type != Group::Type::LINKED) continue;
 
@@ -289,115 +390,237 @@ bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
         }
     }
 
-    fh = OpenFile(filename, "wb");
-    if(!fh) {
-        Error("Couldn't write to file '%s'", filename.raw.c_str());
-        return false;
+    snap->group.reserve(SK.group.n);
+    for(Group &g : SK.group) {
+        Group dest = g;
+        // Only the fields from the save table get written, so zero out
+        // all the generated stuff instead of copying it.
+        dest.polyLoops = {};
+        dest.bezierLoops = {};
+        dest.bezierOpens = {};
+        dest.thisMesh = {};
+        dest.runningMesh = {};
+        dest.thisShell = {};
+        dest.runningShell = {};
+        dest.displayMesh = {};
+        dest.displayOutlines = {};
+        dest.impMesh = {};
+        dest.impShell = {};
+        dest.impEntity = {};
+
+        dest.remap = {};
+        g.remap.DeepCopyInto(&dest.remap);
+        snap->group.push_back(dest);
+    }
+
+    snap->param.assign(SK.param.begin(), SK.param.end());
+    snap->request.assign(SK.request.begin(), SK.request.end());
+
+    snap->entity.reserve(SK.entity.n);
+    for(Entity &e : SK.entity) {
+        e.CalculateNumerical(/*forExport=*/true);
+        Entity dest = e;
+        dest.beziers = {};
+        dest.edges = {};
+        snap->entity.push_back(dest);
     }
 
+    snap->constraint.assign(SK.constraint.begin(), SK.constraint.end());
+    for(Style &s : SK.style) {
+        if(s.h.v >= Style::FIRST_CUSTOM) {
+            snap->style.push_back(s);
+        }
+    }
+
+    // A group will have either a mesh or a shell, but not both; but the code
+    // to copy or print either of those just does nothing if it is empty.
+    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
+    snap->mesh.MakeFromCopyOf(&g->runningMesh);
+    snap->shell.MakeFromCopyOf(&g->runningShell);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Serialize a snapshot; this touches no global state at all, so it is safe
+// to call from any thread.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::WriteSaveSnapshot(FILE *fh, const Platform::Path &filename,
+                                     const SaveSnapshot &snap) {
+    // Models with large meshes and shells produce many megabytes of text,
+    // so don't make a system call for every few lines of it.
+    setvbuf(fh, NULL, _IOFBF, 1 << 20);
+
     fprintf(fh, "%s\n\n\n", VERSION_STRING);
 
-    int i, j;
-    for(i = 0; i < SK.group.n; i++) {
-        sv.g = SK.group.elem[i];
-        SaveUsingTable(filename, 'g');
+    SaveVars sv = {};
+    for(const Group &g : snap.group) {
+        sv.g = g;
+        SaveUsingTable(fh, filename, sv, 'g');
         fprintf(fh, "AddGroup\n\n");
     }
 
-    for(i = 0; i < SK.param.n; i++) {
-        sv.p = SK.param.elem[i];
-        SaveUsingTable(filename, 'p');
+    for(const Param &p : snap.param) {
+        sv.p = p;
+        SaveUsingTable(fh, filename, sv, 'p');
         fprintf(fh, "AddParam\n\n");
     }
 
-    for(i = 0; i < SK.request.n; i++) {
-        sv.r = SK.request.elem[i];
-        SaveUsingTable(filename, 'r');
+    for(const Request &r : snap.request) {
+        sv.r = r;
+        SaveUsingTable(fh, filename, sv, 'r');
         fprintf(fh, "AddRequest\n\n");
     }
 
-    for(i = 0; i < SK.entity.n; i++) {
-        (SK.entity.elem[i]).CalculateNumerical(/*forExport=*/true);
-        sv.e = SK.entity.elem[i];
-        SaveUsingTable(filename, 'e');
+    for(const Entity &e : snap.entity) {
+        sv.e = e;
+        SaveUsingTable(fh, filename, sv, 'e');
         fprintf(fh, "AddEntity\n\n");
     }
 
-    for(i = 0; i < SK.constraint.n; i++) {
-        sv.c = SK.constraint.elem[i];
-        SaveUsingTable(filename, 'c');
+    for(const Constraint &c : snap.constraint) {
+        sv.c = c;
+        SaveUsingTable(fh, filename, sv, 'c');
         fprintf(fh, "AddConstraint\n\n");
     }
 
-    for(i = 0; i < SK.style.n; i++) {
-        sv.s = SK.style.elem[i];
-        if(sv.s.h.v >= Style::FIRST_CUSTOM) {
-            SaveUsingTable(filename, 's');
-            fprintf(fh, "AddStyle\n\n");
-        }
+    for(const Style &s : snap.style) {
+        sv.s = s;
+        SaveUsingTable(fh, filename, sv, 's');
+        fprintf(fh, "AddStyle\n\n");
     }
 
-    // A group will have either a mesh or a shell, but not both; but the code
-    // to print either of those just does nothing if the mesh/shell is empty.
-
-    Group *g = SK.GetGroup(SK.groupOrder.elem[SK.groupOrder.n - 1]);
-    SMesh *m = &g->runningMesh;
+    int i, j;
+    const SMesh *m = &snap.mesh;
     for(i = 0; i < m->l.n; i++) {
-        STriangle *tr = &(m->l.elem[i]);
+        const STriangle *tr = &(m->l.elem[i]);
         fprintf(fh, "Triangle %08x %08x "
                 "%.20f %.20f %.20f  %.20f %.20f %.20f  %.20f %.20f %.20f\n",
             tr->meta.face, tr->meta.color.ToPackedInt(),
             CO(tr->a), CO(tr->b), CO(tr->c));
     }
 
-    SShell *s = &g->runningShell;
-    SSurface *srf;
-    for(srf = s->surface.First(); srf; srf = s->surface.NextAfter(srf)) {
+    const SShell *s = &snap.shell;
+    for(const SSurface &srf : s->surface) {
         fprintf(fh, "Surface %08x %08x %08x %d %d\n",
-            srf->h.v, srf->color.ToPackedInt(), srf->face, srf->degm, srf->degn);
-        for(i = 0; i <= srf->degm; i++) {
-            for(j = 0; j <= srf->degn; j++) {
+            srf.h.v, srf.color.ToPackedInt(), srf.face, srf.degm, srf.degn);
+        for(i = 0; i <= srf.degm; i++) {
+            for(j = 0; j <= srf.degn; j++) {
                 fprintf(fh, "SCtrl %d %d %.20f %.20f %.20f Weight %20.20f\n",
-                    i, j, CO(srf->ctrl[i][j]), srf->weight[i][j]);
+                    i, j, CO(srf.ctrl[i][j]), srf.weight[i][j]);
             }
         }
 
-        STrimBy *stb;
-        for(stb = srf->trim.First(); stb; stb = srf->trim.NextAfter(stb)) {
+        for(const STrimBy &stb : srf.trim) {
             fprintf(fh, "TrimBy %08x %d %.20f %.20f %.20f  %.20f %.20f %.20f\n",
-                stb->curve.v, stb->backwards ? 1 : 0,
-                CO(stb->start), CO(stb->finish));
+                stb.curve.v, stb.backwards ? 1 : 0,
+                CO(stb.start), CO(stb.finish));
         }
 
         fprintf(fh, "AddSurface\n");
     }
-    SCurve *sc;
-    for(sc = s->curve.First(); sc; sc = s->curve.NextAfter(sc)) {
+    for(const SCurve &sc : s->curve) {
         fprintf(fh, "Curve %08x %d %d %08x %08x\n",
-            sc->h.v,
-            sc->isExact ? 1 : 0, sc->exact.deg,
-            sc->surfA.v, sc->surfB.v);
+            sc.h.v,
+            sc.isExact ? 1 : 0, sc.exact.deg,
+            sc.surfA.v, sc.surfB.v);
 
-        if(sc->isExact) {
-            for(i = 0; i <= sc->exact.deg; i++) {
+        if(sc.isExact) {
+            for(i = 0; i <= sc.exact.deg; i++) {
                 fprintf(fh, "CCtrl %d %.20f %.20f %.20f Weight %.20f\n",
-                    i, CO(sc->exact.ctrl[i]), sc->exact.weight[i]);
+                    i, CO(sc.exact.ctrl[i]), sc.exact.weight[i]);
             }
         }
-        SCurvePt *scpt;
-        for(scpt = sc->pts.First(); scpt; scpt = sc->pts.NextAfter(scpt)) {
+        for(const SCurvePt &scpt : sc.pts) {
             fprintf(fh, "CurvePt %d %.20f %.20f %.20f\n",
-                scpt->vertex ? 1 : 0, CO(scpt->p));
+                scpt.vertex ? 1 : 0, CO(scpt.p));
         }
 
         fprintf(fh, "AddCurve\n");
     }
 
-    fclose(fh);
+    return !ferror(fh);
+}
+
+bool SolveSpaceUI::SaveToFile(const Platform::Path &filename) {
+    TRACE_SCOPE("SolveSpaceUI::SaveToFile");
+    FinishBackgroundSave(/*wait=*/true);
+
+    // Make sure all the entities are regenerated up to date, since they will be exported.
+    SS.ScheduleShowTW();
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+
+    SaveSnapshot snap = {};
+    if(!MakeSaveSnapshot(filename, &snap)) return false;
 
+    FILE *fh = OpenFile(TemporaryFileFor(filename), "wb");
+    if(!fh) {
+        Error("Couldn't write to file '%s'", filename.raw.c_str());
+        snap.Clear();
+        return false;
+    }
+
+    bool ok = WriteSaveSnapshot(fh, filename, snap);
+    snap.Clear();
+    if(!CommitTemporaryFile(fh, filename, ok)) {
+        Error("Couldn't write to file '%s'", filename.raw.c_str());
+        return false;
+    }
     return true;
 }
 
+//-----------------------------------------------------------------------------
+// Like SaveToFile, but only the snapshot is taken here; formatting and writing
+// it out happens on another thread, and FinishBackgroundSave collects the
+// result. Errors that can be detected up front are still reported right away.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::SaveToFileInBackground(const Platform::Path &filename, bool isAutosave) {
+    FinishBackgroundSave(/*wait=*/true);
+
+    // Only the groups that changed since the last regeneration need to be
+    // brought up to date; everything else already is.
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+
+    std::shared_ptr<SaveSnapshot> snap = std::make_shared<SaveSnapshot>();
+    if(!MakeSaveSnapshot(filename, snap.get())) return false;
+
+    FILE *fh = OpenFile(TemporaryFileFor(filename), "wb");
+    if(!fh) {
+        Error("Couldn't write to file '%s'", filename.raw.c_str());
+        snap->Clear();
+        return false;
+    }
+
+    backgroundSave.filename   = filename;
+    backgroundSave.isAutosave = isAutosave;
+    backgroundSave.result     = std::async(std::launch::async, [=] {
+        bool ok = WriteSaveSnapshot(fh, filename, *snap);
+        snap->Clear();
+        return CommitTemporaryFile(fh, filename, ok);
+    });
+    return true;
+}
+
+bool SolveSpaceUI::FinishBackgroundSave(bool wait) {
+    if(!backgroundSave.result.valid()) return true;
+    if(!wait && backgroundSave.result.wait_for(std::chrono::seconds(0)) !=
+                    std::future_status::ready) {
+        return true;
+    }
+
+    bool saved = backgroundSave.result.get();
+    if(!saved) {
+        Error("Couldn't write to file '%s'", backgroundSave.filename.raw.c_str());
+        if(!backgroundSave.isAutosave) {
+            unsaved = true;
+            UpdateWindowTitle();
+        }
+    } else if(!backgroundSave.isAutosave) {
+        RemoveFile(backgroundSave.filename.WithExtension(AUTOSAVE_EXT));
+    }
+    return saved;
+}
+
 void SolveSpaceUI::LoadUsingTable(const Platform::Path &filename, char *key, char *val) {
     int i;
     for(i = 0; SAVED[i].type != 0; i++) {
@@ -459,6 +682,7 @@ void SolveSpaceUI::LoadUsingTable(const Platform::Path &filename, char *key, cha
 }
 
 bool SolveSpaceUI::LoadFromFile(const Platform::Path &filename, bool canCancel) {
+    TRACE_SCOPE("SolveSpaceUI::LoadFromFile");
     allConsistent = false;
     fileLoadError = false;
 
@@ -826,13 +1050,48 @@ bool SolveSpaceUI::LoadEntitiesFromFile(const Platform::Path &filename, EntityLi
     return true;
 }
 
-bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCancel) {
+//-----------------------------------------------------------------------------
+// Load the entities, mesh and shell of a linked sketch; or, if we're keeping
+// a cache of linked sketches, copy them from there, loading only on a miss.
+// Entries are never invalidated, so a file that changes after it is cached is
+// not seen again; the cache is only meant to last for one command-line run.
+//-----------------------------------------------------------------------------
+bool SolveSpaceUI::LoadLinkedFile(const Platform::Path &filename, EntityList *le,
+                                  SMesh *m, SShell *sh)
+{
+    if(!cacheLinkedFiles) {
+        return LoadEntitiesFromFile(filename, le, m, sh);
+    }
+
+    auto it = linkedFiles.find(filename);
+    if(it == linkedFiles.end()) {
+        LinkedFile lf = {};
+        if(!LoadEntitiesFromFile(filename, &lf.entity, &lf.mesh, &lf.shell)) {
+            lf.entity.Clear();
+            lf.mesh.Clear();
+            lf.shell.Clear();
+            return false;
+        }
+        it = linkedFiles.emplace(filename, lf).first;
+    }
+
+    LinkedFile *lf = &it->second;
+    lf->entity.DeepCopyInto(le);
+    m->MakeFromCopyOf(&lf->mesh);
+    sh->MakeFromCopyOf(&lf->shell);
+    return true;
+}
+
+bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCancel,
+                                   bool onlyUnloaded) {
     std::map<Platform::Path, Platform::Path, Platform::PathLess> linkMap;
 
     allConsistent = false;
 
     for(Group &g : SK.group) {
         if(g.type != Group::Type::LINKED) continue;
+        if(onlyUnloaded &&
+           (g.impEntity.n > 0 || !g.impMesh.IsEmpty() || !g.impShell.IsEmpty())) continue;
 
         g.impEntity.Clear();
         g.impMesh.Clear();
@@ -844,7 +1103,7 @@ bool SolveSpaceUI::ReloadAllLinked(const Platform::Path &saveFile, bool canCance
         }
 
 try_again:
-        if(LoadEntitiesFromFile(g.linkFile, &g.impEntity, &g.impMesh, &g.impShell)) {
+        if(LoadLinkedFile(g.linkFile, &g.impEntity, &g.impMesh, &g.impShell)) {
             // We loaded the data, good. Now import its dependencies as well.
             for(Entity &e : g.impEntity) {
                 if(e.type != Entity::Type::IMAGE) continue;
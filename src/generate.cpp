@@ -23,6 +23,7 @@ void SolveSpaceUI::MarkGroupDirty(hGroup hg, bool onlyThis) {
         }
         if(go) {
             g->clean = false;
+            UndoTouchGroup(g->h);
             if(onlyThis) break;
         }
     }
@@ -139,6 +140,7 @@ bool SolveSpaceUI::PruneConstraints(hGroup hg) {
 }
 
 void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox) {
+    TRACE_SCOPE("SolveSpaceUI::GenerateAll");
     int first = 0, last = 0, i, j;
 
     uint64_t startMillis = GetMilliseconds(),
@@ -273,6 +275,7 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
             if(i >= first && i <= last) {
                 // The group falls inside the range, so really solve it,
                 // and then regenerate the mesh based on the solved stuff.
+                UndoTouchGroup(g->h);
                 if(genForBBox) {
                     SolveGroupAndReport(g->h, andFindFree);
                     g->GenerateLoops();
@@ -493,6 +496,7 @@ void SolveSpaceUI::MarkDraggedParams() {
 }
 
 void SolveSpaceUI::SolveGroupAndReport(hGroup hg, bool andFindFree) {
+    TRACE_SCOPE("SolveSpaceUI::SolveGroupAndReport", hg.v);
     SolveGroup(hg, andFindFree);
 
     Group *g = SK.GetGroup(hg);
@@ -105,6 +105,7 @@ const GraphicsWindow::MenuEntry GraphicsWindow::menu[] = {
 { 0, N_("&Help"),                       Command::NONE,             0,       TN, NULL  },
 { 1, N_("&Website / Manual"),           Command::WEBSITE,          0,       TN, mHelp },
 { 1, N_("&Language"),                   Command::LOCALE,           0,       TN, mHelp },
+{ 1, N_("Record Performance &Trace..."), Command::RECORD_TRACE,    0,       TC, mHelp },
 #ifndef __APPLE__
 { 1, N_("&About"),                      Command::ABOUT,            0,       TN, mHelp },
 #endif
@@ -705,6 +706,7 @@ void GraphicsWindow::EnsureValidActives() {
     CheckMenuByCmd(Command::PERSPECTIVE_PROJ, /*checked=*/SS.usePerspectiveProj);
     CheckMenuByCmd(Command::SHOW_GRID,/*checked=*/SS.GW.showSnapGrid);
     CheckMenuByCmd(Command::FULL_SCREEN, /*checked=*/FullScreenIsActive());
+    CheckMenuByCmd(Command::RECORD_TRACE, /*checked=*/TraceScope::TraceIsActive());
 
     if(change) SS.ScheduleShowTW();
 }
@@ -943,6 +945,7 @@ void GraphicsWindow::MenuEdit(Command id) {
                     std::vector<Vector> refs;
                     c->GetReferencePoints(SS.GW.GetCamera(), &refs);
                     c->disp.offset = c->disp.offset.Plus(SS.GW.SnapToGrid(refs[0]).Minus(refs[0]));
+                    SS.UndoTouchGroup(c->group);
                 }
             }
             // Regenerate, with these points marked as dragged so that they
@@ -290,6 +290,34 @@ void Group::MenuGroup(Command id) {
     SS.ScheduleShowTW();
 }
 
+//-----------------------------------------------------------------------------
+// Add a new sketch in the XY plane, through the origin, after every other
+// group, and make it active, as when a program rather than the user builds
+// the sketch. The group order isn't rebuilt until we regenerate, so look at
+// the groups themselves. Its workplane entity doesn't exist until then either.
+//-----------------------------------------------------------------------------
+hGroup Group::AddWorkplaneGroup(const std::string &name) {
+    Group g = {};
+    g.visible = true;
+    g.color = RGBi(100, 100, 100);
+    g.scale = 1;
+    g.type = Type::DRAWING_WORKPLANE;
+    g.subtype = Subtype::WORKPLANE_BY_POINT_ORTHO;
+    g.name = name;
+    g.predef.q = Quaternion::From(1, 0, 0, 0);
+    g.predef.origin = Request::HREQUEST_REFERENCE_XY.entity(1);
+    for(const Group &gi : SK.group) {
+        g.order = max(g.order, gi.order + 1);
+    }
+
+    SK.group.AddAndAssignId(&g);
+    Group *gg = SK.GetGroup(g.h);
+    gg->clean = false;
+    gg->activeWorkplane = gg->h.entity(0);
+    SS.GW.activeGroup = gg->h;
+    return gg->h;
+}
+
 void Group::TransformImportedBy(Vector t, Quaternion q) {
     ssassert(type == Type::LINKED, "Expected a linked group");
 
@@ -357,6 +385,7 @@ void Group::Activate() {
 void Group::Generate(IdList<Entity,hEntity> *entity,
                      IdList<Param,hParam> *param)
 {
+    TRACE_SCOPE("Group::Generate", h.v);
     Vector gn = (SS.GW.projRight).Cross(SS.GW.projUp);
     Vector gp = SS.GW.projRight.Plus(SS.GW.projUp);
     Vector gc = (SS.GW.offset).ScaledBy(-1);
@@ -178,6 +178,7 @@ void Group::GenerateForBoolean(T *prevs, T *thiss, T *outs, Group::CombineAs how
 }
 
 void Group::GenerateShellAndMesh() {
+    TRACE_SCOPE("Group::GenerateShellAndMesh", h.v);
     bool prevBooleanFailed = booleanFailed;
     booleanFailed = false;
 
@@ -371,6 +372,7 @@ void Group::GenerateShellAndMesh() {
 }
 
 void Group::GenerateDisplayItems() {
+    TRACE_SCOPE("Group::GenerateDisplayItems", h.v);
     // This is potentially slow (since we've got to triangulate a shell, or
     // to find the emphasized edges for a mesh), so we will run it only
     // if its inputs have changed.
@@ -440,6 +442,49 @@ void Group::GenerateDisplayItems() {
     }
 }
 
+//-----------------------------------------------------------------------------
+// The group whose running shell and mesh actually make up our display mesh;
+// that's us, unless we contribute no solid model of our own, in which case
+// GenerateDisplayItems() just copies it from the running mesh group.
+//-----------------------------------------------------------------------------
+Group *Group::DisplayMeshGroup() {
+    Group *pg = RunningMeshGroup();
+    if(pg && thisMesh.IsEmpty() && thisShell.IsEmpty()) {
+        return pg->DisplayMeshGroup();
+    }
+    return this;
+}
+
+//-----------------------------------------------------------------------------
+// Produce the same triangles as GenerateDisplayItems() puts in displayMesh,
+// but hand them to fn one surface at a time, so that the whole mesh never
+// has to be held in memory. This is what the streaming mesh exporters use.
+//-----------------------------------------------------------------------------
+void Group::ForEachDisplayTriangle(const std::function<void(const STriangle &)> &fn) {
+    Group *g = DisplayMeshGroup();
+
+    SMesh sm = {};
+    SSurface *srf;
+    for(srf = g->runningShell.surface.First(); srf;
+        srf = g->runningShell.surface.NextAfter(srf)) {
+        srf->TriangulateInto(&g->runningShell, &sm);
+        for(const STriangle &tr : sm.l) {
+            fn(tr);
+        }
+        sm.Clear();
+    }
+
+    STriangle *t;
+    for(t = g->runningMesh.l.First(); t; t = g->runningMesh.l.NextAfter(t)) {
+        STriangle trn = *t;
+        Vector n = trn.Normal();
+        trn.an = n;
+        trn.bn = n;
+        trn.cn = n;
+        fn(trn);
+    }
+}
+
 Group *Group::PreviousGroup() const {
     int i;
     for(i = 0; i < SK.groupOrder.n; i++) {
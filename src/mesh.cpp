@@ -60,26 +60,30 @@ void SMesh::GetBounding(Vector *vmax, Vector *vmin) const {
 
 //----------------------------------------------------------------------------
 // Report the edges of the boundary of the region(s) of our mesh that lie
-// within the plane n dot p = d.
+// within the plane n dot p = d. If we're given a bvh for the mesh, then only
+// the triangles that it reports near the plane need to be tested.
 //----------------------------------------------------------------------------
-void SMesh::MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d) {
+void SMesh::MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d,
+                                 const SBvh *bvh)
+{
+    // Gather only the triangles that lie in our export plane.
     SMesh m = {};
-    m.MakeFromCopyOf(this);
-
-    // Delete all triangles in the mesh that do not lie in our export plane.
-    m.l.ClearTags();
-    int i;
-    for(i = 0; i < m.l.n; i++) {
-        STriangle *tr = &(m.l.elem[i]);
-
-        if((fabs(n.Dot(tr->a) - d) >= LENGTH_EPS) ||
-           (fabs(n.Dot(tr->b) - d) >= LENGTH_EPS) ||
-           (fabs(n.Dot(tr->c) - d) >= LENGTH_EPS))
+    auto addIfInPlane = [&](const STriangle *tr) {
+        if((fabs(n.Dot(tr->a) - d) < LENGTH_EPS) &&
+           (fabs(n.Dot(tr->b) - d) < LENGTH_EPS) &&
+           (fabs(n.Dot(tr->c) - d) < LENGTH_EPS))
         {
-            tr->tag  = 1;
+            m.AddTriangle(tr);
         }
+    };
+    if(bvh) {
+        std::vector<int> found;
+        bvh->ItemsMeetingPlane(n, d, LENGTH_EPS, &found);
+        for(int i : found) addIfInPlane(&l.elem[i]);
+    } else {
+        for(int i = 0; i < l.n; i++) addIfInPlane(&l.elem[i]);
     }
-    m.l.RemoveTagged();
+    if(m.l.n == 0) return;
 
     // Select the naked edges in our resulting open mesh.
     SKdNode *root = SKdNode::From(&m);
@@ -90,6 +94,54 @@ void SMesh::MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d) {
     m.Clear();
 }
 
+//----------------------------------------------------------------------------
+// Cut the mesh with the plane n dot p = d, and report the line segments along
+// which its triangles cross that plane. Each segment is directed along n cross
+// the triangle's normal, so that a closed mesh gives consistent loops.
+// Triangles that lie in the plane are ignored; an edge that lies in the plane
+// is reported by whichever of its triangles is on the positive side.
+//----------------------------------------------------------------------------
+void SMesh::MakeSectionInto(SEdgeList *sel, Vector n, double d, const SBvh *bvh) {
+    auto cutTriangle = [&](const STriangle *tr) {
+        Vector vt[3] = { tr->a, tr->b, tr->c };
+        double dt[3];
+        int on = 0, above = 0;
+        for(int i = 0; i < 3; i++) {
+            dt[i] = n.Dot(vt[i]) - d;
+            if(fabs(dt[i]) < LENGTH_EPS) {
+                on++;
+            } else if(dt[i] > 0) {
+                above++;
+            }
+        }
+        if(on == 3 || (on == 2 && above == 0)) return;
+
+        Vector pts[3];
+        int np = 0;
+        for(int i = 0; i < 3; i++) {
+            int j = WRAP(i + 1, 3);
+            if(fabs(dt[i]) < LENGTH_EPS) {
+                pts[np++] = vt[i];
+            } else if(fabs(dt[j]) >= LENGTH_EPS && (dt[i] < 0) != (dt[j] < 0)) {
+                double t = dt[i] / (dt[i] - dt[j]);
+                pts[np++] = vt[i].Plus((vt[j].Minus(vt[i])).ScaledBy(t));
+            }
+        }
+        if(np != 2 || pts[0].Equals(pts[1])) return;
+
+        Vector dir = n.Cross(tr->Normal());
+        if((pts[1].Minus(pts[0])).Dot(dir) < 0) swap(pts[0], pts[1]);
+        sel->AddEdge(pts[0], pts[1]);
+    };
+    if(bvh) {
+        std::vector<int> found;
+        bvh->ItemsMeetingPlane(n, d, LENGTH_EPS, &found);
+        for(int i : found) cutTriangle(&l.elem[i]);
+    } else {
+        for(int i = 0; i < l.n; i++) cutTriangle(&l.elem[i]);
+    }
+}
+
 void SMesh::MakeOutlinesInto(SOutlineList *sol, EdgeKind edgeKind) {
     SKdNode *root = SKdNode::From(this);
     root->MakeOutlinesInto(sol, edgeKind);
@@ -799,6 +851,332 @@ void SKdNode::OcclusionTestLine(SEdge orig, SEdgeList *sel, int cnt) const {
     }
 }
 
+//-----------------------------------------------------------------------------
+// An alternative to the kd-tree for occlusion testing, for meshes with many
+// edges to test: rasterize the front-facing triangles of the (already
+// projected) mesh into a depth buffer with the given number of pixels along
+// its longer side, recording the frontmost triangle at each pixel. Since the
+// frontmost triangle at a pixel center need not be the frontmost one
+// everywhere in the pixel, also bin the triangles into tiles of pixels, so
+// that we can test every triangle that might cover a point.
+//-----------------------------------------------------------------------------
+SDepthBuffer SDepthBuffer::From(const SMesh *m, int resolution) {
+    SDepthBuffer db = {};
+    if(m->IsEmpty()) return db;
+    resolution = max(1, min(resolution, MAX_RESOLUTION));
+
+    Vector bmax, bmin;
+    m->GetBounding(&bmax, &bmin);
+    double size = max(bmax.x - bmin.x, bmax.y - bmin.y);
+    db.pixel  = max(size, LENGTH_EPS) / resolution;
+    db.origin = Point2d::From(bmin.x - db.pixel, bmin.y - db.pixel);
+    db.width  = (int)ceil((bmax.x - bmin.x) / db.pixel) + 3;
+    db.height = (int)ceil((bmax.y - bmin.y) / db.pixel) + 3;
+
+    for(const STriangle &tr : m->l) {
+        Occluder oc;
+        oc.tn = tr.Normal().WithMagnitude(1);
+        // Only front-facing triangles can hide anything.
+        if(!(oc.tn.z > LENGTH_EPS)) continue;
+        oc.td = oc.tn.Dot(tr.a);
+
+        Point2d a = tr.a.ProjectXy(),
+                b = tr.b.ProjectXy(),
+                c = tr.c.ProjectXy();
+        oc.n[0] = (b.Minus(a)).Normal().WithMagnitude(1);
+        oc.n[1] = (c.Minus(b)).Normal().WithMagnitude(1);
+        oc.n[2] = (a.Minus(c)).Normal().WithMagnitude(1);
+        oc.d[0] = oc.n[0].Dot(b);
+        oc.d[1] = oc.n[1].Dot(c);
+        oc.d[2] = oc.n[2].Dot(a);
+        oc.xmin = min(a.x, min(b.x, c.x));
+        oc.xmax = max(a.x, max(b.x, c.x));
+        oc.ymin = min(a.y, min(b.y, c.y));
+        oc.ymax = max(a.y, max(b.y, c.y));
+        oc.centroid = (a.Plus(b).Plus(c)).ScaledBy(1.0 / 3);
+        db.occluders.push_back(oc);
+    }
+
+    // List the triangles in each tile that they may cover, leaving out tiles
+    // that lie entirely outside one of their edges. Count them first, so that
+    // the lists can be packed into one array.
+    double tile = db.pixel * TILE_SIZE;
+    db.tilesX = (db.width  + TILE_SIZE - 1) / TILE_SIZE;
+    db.tilesY = (db.height + TILE_SIZE - 1) / TILE_SIZE;
+    auto forEachTile = [&](const Occluder &oc, const std::function<void(int)> &fn) {
+        int ti0 = max(0,             (int)floor((oc.xmin - LENGTH_EPS - db.origin.x) / tile)),
+            ti1 = min(db.tilesX - 1, (int)floor((oc.xmax + LENGTH_EPS - db.origin.x) / tile)),
+            tj0 = max(0,             (int)floor((oc.ymin - LENGTH_EPS - db.origin.y) / tile)),
+            tj1 = min(db.tilesY - 1, (int)floor((oc.ymax + LENGTH_EPS - db.origin.y) / tile));
+        for(int tj = tj0; tj <= tj1; tj++) {
+            for(int ti = ti0; ti <= ti1; ti++) {
+                Point2d c[4] = {
+                    Point2d::From(db.origin.x + ti*tile,       db.origin.y + tj*tile),
+                    Point2d::From(db.origin.x + (ti + 1)*tile, db.origin.y + tj*tile),
+                    Point2d::From(db.origin.x + ti*tile,       db.origin.y + (tj + 1)*tile),
+                    Point2d::From(db.origin.x + (ti + 1)*tile, db.origin.y + (tj + 1)*tile),
+                };
+                bool outside = false;
+                for(int e = 0; e < 3 && !outside; e++) {
+                    outside = true;
+                    for(int v = 0; v < 4; v++) {
+                        if(oc.n[e].Dot(c[v]) - oc.d[e] <= LENGTH_EPS) {
+                            outside = false;
+                            break;
+                        }
+                    }
+                }
+                if(!outside) fn(tj * db.tilesX + ti);
+            }
+        }
+    };
+    db.tileStart.assign((size_t)db.tilesX * db.tilesY + 1, 0);
+    for(const Occluder &oc : db.occluders) {
+        forEachTile(oc, [&](int t) { db.tileStart[t + 1]++; });
+    }
+    for(size_t t = 1; t < db.tileStart.size(); t++) {
+        db.tileStart[t] += db.tileStart[t - 1];
+    }
+    db.tileItems.resize(db.tileStart.back());
+    std::vector<int> tileFill(db.tileStart.begin(), db.tileStart.end() - 1);
+    for(size_t k = 0; k < db.occluders.size(); k++) {
+        forEachTile(db.occluders[k], [&](int t) { db.tileItems[tileFill[t]++] = (int)k; });
+    }
+
+    db.depth.assign((size_t)db.width * db.height, -std::numeric_limits<float>::max());
+    db.index.assign((size_t)db.width * db.height, -1);
+
+    // Rasterize in horizontal bands, one per worker, so that each pixel is
+    // only ever written by one thread, in the order of the triangles.
+    const int bandHeight = 64;
+    int bands = (db.height + bandHeight - 1) / bandHeight;
+    ParallelFor((size_t)bands, [&](size_t band) {
+        int y0 = (int)band * bandHeight,
+            y1 = min(db.height, y0 + bandHeight);
+        for(size_t k = 0; k < db.occluders.size(); k++) {
+            const Occluder &oc = db.occluders[k];
+            int j0 = max(y0, (int)floor((oc.ymin - db.origin.y) / db.pixel)),
+                j1 = min(y1 - 1, (int)ceil((oc.ymax - db.origin.y) / db.pixel));
+            if(j0 > j1) continue;
+            int i0 = max(0, (int)floor((oc.xmin - db.origin.x) / db.pixel)),
+                i1 = min(db.width - 1, (int)ceil((oc.xmax - db.origin.x) / db.pixel));
+
+            auto plot = [&](int i, int j, Point2d p) {
+                float z = (float)((oc.td - oc.tn.x*p.x - oc.tn.y*p.y) / oc.tn.z);
+                size_t at = (size_t)j * db.width + i;
+                if(z > db.depth[at]) {
+                    db.depth[at] = z;
+                    db.index[at] = (int)k;
+                }
+            };
+
+            for(int j = j0; j <= j1; j++) {
+                for(int i = i0; i <= i1; i++) {
+                    Point2d p = db.PixelCenter(i, j);
+                    if(oc.n[0].Dot(p) > oc.d[0] ||
+                       oc.n[1].Dot(p) > oc.d[1] ||
+                       oc.n[2].Dot(p) > oc.d[2]) continue;
+                    plot(i, j, p);
+                }
+            }
+
+            // A triangle smaller than a pixel may not cover any pixel center
+            // at all, so make sure that it shows up at least where its
+            // centroid lies.
+            int ic = (int)floor((oc.centroid.x - db.origin.x) / db.pixel),
+                jc = (int)floor((oc.centroid.y - db.origin.y) / db.pixel);
+            if(jc >= y0 && jc < y1 && ic >= 0 && ic < db.width) {
+                plot(ic, jc, oc.centroid);
+            }
+        }
+    });
+
+    return db;
+}
+
+Point2d SDepthBuffer::PixelCenter(int i, int j) const {
+    return Point2d::From(origin.x + (i + 0.5) * pixel,
+                         origin.y + (j + 0.5) * pixel);
+}
+
+//-----------------------------------------------------------------------------
+// Test whether a point is hidden by a triangle, exactly; the same test as
+// SplitLinesAgainstTriangle, so points on or in front of the triangle's plane,
+// or on its boundary, are not hidden by it.
+//-----------------------------------------------------------------------------
+bool SDepthBuffer::HidesPoint(const Occluder &oc, Vector p) {
+    Point2d pt = p.ProjectXy();
+    if(p.Dot(oc.tn) - oc.td > -LENGTH_EPS) return false;
+    if(oc.n[0].Dot(pt) - oc.d[0] > -LENGTH_EPS ||
+       oc.n[1].Dot(pt) - oc.d[1] > -LENGTH_EPS ||
+       oc.n[2].Dot(pt) - oc.d[2] > -LENGTH_EPS) return false;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Test whether a point is hidden by any triangle. The frontmost triangle at
+// its pixel usually decides that, so try it first; if it doesn't hide the
+// point, test every triangle that may cover the point's tile.
+//-----------------------------------------------------------------------------
+bool SDepthBuffer::IsOccluded(Vector p) const {
+    int ic = (int)floor((p.x - origin.x) / pixel),
+        jc = (int)floor((p.y - origin.y) / pixel);
+    if(ic < 0 || ic >= width || jc < 0 || jc >= height) return false;
+
+    int front = index[(size_t)jc * width + ic];
+    if(front >= 0 && HidesPoint(occluders[front], p)) return true;
+
+    int t = (jc / TILE_SIZE) * tilesX + ic / TILE_SIZE;
+    for(int at = tileStart[t]; at < tileStart[t + 1]; at++) {
+        int k = tileItems[at];
+        if(k != front && HidesPoint(occluders[k], p)) return true;
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// Split an edge into visible and hidden pieces, like SKdNode does, and add
+// those to sel, with tag 1 for the hidden ones. The edge is sampled twice per
+// pixel, and each change in visibility between samples is then found
+// exactly by bisection. This only reads the depth buffer, so many edges may
+// be tested at once.
+//-----------------------------------------------------------------------------
+void SDepthBuffer::OcclusionTestLine(SEdge orig, SEdgeList *sel) const {
+    Vector a = orig.a,
+           d = orig.b.Minus(orig.a);
+    double len = (orig.a.ProjectXy()).DistanceTo(orig.b.ProjectXy());
+    int n = max(1, (int)ceil(len / (pixel / 2)));
+
+    auto pointAt = [&](double t) { return a.Plus(d.ScaledBy(t)); };
+
+    double start = 0;
+    bool hidden = IsOccluded(pointAt(0.5 / n));
+    for(int i = 1; i < n; i++) {
+        double t = (i + 0.5) / n;
+        bool thisHidden = IsOccluded(pointAt(t));
+        if(thisHidden == hidden) continue;
+
+        double lo = (i - 0.5) / n, hi = t;
+        while((hi - lo) * len > LENGTH_EPS) {
+            double mid = (lo + hi) / 2;
+            if(IsOccluded(pointAt(mid)) == hidden) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        double split = (lo + hi) / 2;
+        sel->AddEdge(pointAt(start), pointAt(split), orig.auxA, 0, hidden ? 1 : 0);
+        start  = split;
+        hidden = thisHidden;
+    }
+    sel->AddEdge(pointAt(start), orig.b, orig.auxA, 0, hidden ? 1 : 0);
+}
+
+//-----------------------------------------------------------------------------
+// Build a bounding volume hierarchy over a list of boxes, by recursively
+// splitting at the median of the box centers along the longest axis.
+//-----------------------------------------------------------------------------
+SBvh SBvh::From(const std::vector<BBox> &boxes) {
+    static const int LEAF_ITEMS = 4;
+
+    SBvh bvh = {};
+    if(boxes.empty()) return bvh;
+
+    bvh.items.resize(boxes.size());
+    std::vector<Vector> centers(boxes.size());
+    for(size_t i = 0; i < boxes.size(); i++) {
+        bvh.items[i] = (int)i;
+        centers[i]   = boxes[i].GetOrigin();
+    }
+    bvh.nodes.reserve(2 * boxes.size() / LEAF_ITEMS + 1);
+
+    std::function<int(int, int)> build = [&](int first, int count) {
+        Node node = {};
+        node.left  = -1;
+        node.right = -1;
+        node.box   = boxes[bvh.items[first]];
+        BBox cbox  = BBox::From(centers[bvh.items[first]], centers[bvh.items[first]]);
+        for(int i = first + 1; i < first + count; i++) {
+            node.box.Include(boxes[bvh.items[i]].minp);
+            node.box.Include(boxes[bvh.items[i]].maxp);
+            cbox.Include(centers[bvh.items[i]]);
+        }
+
+        int index = (int)bvh.nodes.size();
+        bvh.nodes.push_back(node);
+        if(count <= LEAF_ITEMS) {
+            bvh.nodes[index].first = first;
+            bvh.nodes[index].count = count;
+            return index;
+        }
+
+        Vector ext = cbox.GetExtents();
+        int axis = (ext.x >= ext.y && ext.x >= ext.z) ? 0 :
+                   (ext.y >= ext.z)                   ? 1 : 2;
+        int half = count / 2;
+        std::nth_element(bvh.items.begin() + first,
+                         bvh.items.begin() + first + half,
+                         bvh.items.begin() + first + count,
+                         [&](int a, int b) {
+            return centers[a].Element(axis) < centers[b].Element(axis);
+        });
+
+        int left  = build(first, half);
+        int right = build(first + half, count - half);
+        bvh.nodes[index].left  = left;
+        bvh.nodes[index].right = right;
+        return index;
+    };
+    build(0, (int)boxes.size());
+    return bvh;
+}
+
+SBvh SBvh::From(const SMesh *m) {
+    std::vector<BBox> boxes;
+    boxes.reserve(m->l.n);
+    for(int i = 0; i < m->l.n; i++) {
+        const STriangle *tr = &m->l.elem[i];
+        BBox box = BBox::From(tr->a, tr->b);
+        box.Include(tr->c);
+        boxes.push_back(box);
+    }
+    return From(boxes);
+}
+
+bool SBvh::IsEmpty() const {
+    return nodes.empty();
+}
+
+//-----------------------------------------------------------------------------
+// Report, in ascending order, the items whose boxes come within tol of the
+// plane n dot p = d.
+//-----------------------------------------------------------------------------
+void SBvh::ItemsMeetingPlane(Vector n, double d, double tol,
+                             std::vector<int> *found) const {
+    if(nodes.empty()) return;
+
+    Vector an = Vector::From(fabs(n.x), fabs(n.y), fabs(n.z));
+    std::vector<int> stack = { 0 };
+    while(!stack.empty()) {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+
+        // The box spans a slab of half-width |n| dot extents about its center.
+        double dist = n.Dot(node.box.GetOrigin()) - d;
+        if(fabs(dist) > an.Dot(node.box.GetExtents()) + tol) continue;
+
+        if(node.left < 0) {
+            found->insert(found->end(), items.begin() + node.first,
+                          items.begin() + node.first + node.count);
+        } else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+    std::sort(found->begin(), found->end());
+}
+
 //-----------------------------------------------------------------------------
 // Search the mesh for a triangle with an edge from b to a (i.e., the mate
 // for the edge from a to b), and increment info->count each time that we
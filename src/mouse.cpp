@@ -281,6 +281,7 @@ void GraphicsWindow::MouseMoved(double x, double y, bool leftDown,
         case Pending::DRAGGING_CONSTRAINT: {
             Constraint *c = SK.constraint.FindById(pending.constraint);
             UpdateDraggedNum(&(c->disp.offset), x, y);
+            SS.UndoTouchGroup(c->group);
             orig.mouse = mp;
             InvalidateGraphics();
             return;
@@ -1437,6 +1438,7 @@ void GraphicsWindow::EditControlDone(const char *s) {
     if(c->type == Constraint::Type::COMMENT) {
         SS.UndoRemember();
         c->comment = s;
+        SS.UndoTouchGroup(c->group);
         return;
     }
 
@@ -1445,41 +1447,14 @@ void GraphicsWindow::EditControlDone(const char *s) {
         SS.UndoRemember();
 
         switch(c->type) {
-            case Constraint::Type::PROJ_PT_DISTANCE:
-            case Constraint::Type::PT_LINE_DISTANCE:
-            case Constraint::Type::PT_FACE_DISTANCE:
-            case Constraint::Type::PT_PLANE_DISTANCE:
-            case Constraint::Type::LENGTH_DIFFERENCE: {
-                // The sign is not displayed to the user, but this is a signed
-                // distance internally. To flip the sign, the user enters a
-                // negative distance.
-                bool wasNeg = (c->valA < 0);
-                if(wasNeg) {
-                    c->valA = -SS.ExprToMm(e);
-                } else {
-                    c->valA = SS.ExprToMm(e);
-                }
-                break;
-            }
             case Constraint::Type::ANGLE:
             case Constraint::Type::LENGTH_RATIO:
-                // These don't get the units conversion for distance, and
-                // they're always positive
-                c->valA = fabs(e->Eval());
-                break;
-
-            case Constraint::Type::DIAMETER:
-                c->valA = fabs(SS.ExprToMm(e));
-
-                // If displayed and edited as radius, convert back
-                // to diameter
-                if(c->other)
-                    c->valA *= 2;
+                // These don't get the units conversion for distance.
+                c->ModifyValueTo(e->Eval());
                 break;
 
             default:
-                // These are always positive, and they get the units conversion.
-                c->valA = fabs(SS.ExprToMm(e));
+                c->ModifyValueTo(SS.ExprToMm(e));
                 break;
         }
         SS.MarkGroupDirty(c->group);
@@ -179,8 +179,8 @@ class Wall: public Color {
 	double width = 0;
 	double height = 0;
 
-// Vector of vector of panels that best fit the wall
-	std::vector<Panel *> bestFitPanelList;
+// Panels that best fit the wall, each with the number of them used
+	std::vector<Panel> bestFitPanelList;
 	
 // Cordinates of the wall in the print
 	std::vector<Point2f> rectPoints;
@@ -210,7 +210,7 @@ public:
 		return height;
 	}
 	
-	std::vector<Panel *> getBestFitPanelList() const {
+	const std::vector<Panel> &getBestFitPanelList() const {
 		return bestFitPanelList;
 	}
 	
@@ -219,9 +219,9 @@ public:
 	}
 	
 	bool panelIsListed(uint32_t width) {
-		std::vector<Panel *>::iterator panel = bestFitPanelList.begin();
+		std::vector<Panel>::iterator panel = bestFitPanelList.begin();
 		while(panel != bestFitPanelList.end()) {
-			if((*panel)->getWidth() == width)
+			if(panel->getWidth() == width)
 				return true;
 			panel++;
 		}
@@ -253,9 +253,9 @@ public:
 		rectPoints.push_back(wallCoordinates[3]);
 	}
 	
-	void addBestFitPanels(Panel *panel, uint32_t numPanels = 1) {
+	void addBestFitPanels(const Panel &panel, uint32_t numPanels = 1) {
 		bestFitPanelList.push_back(panel);
-		panel->incrementNumPanels(numPanels);
+		bestFitPanelList.back().incrementNumPanels(numPanels);
 	}
 	
 // Verify wall info is correct
@@ -286,9 +286,9 @@ public:
 		std::cout << "Wall Color: " << getColor() << "\n";
 		
 	// Print Best fit Panel info
-		std::vector<Panel *>::iterator panel_it = bestFitPanelList.begin();
+		std::vector<Panel>::iterator panel_it = bestFitPanelList.begin();
 		while(panel_it != bestFitPanelList.end()) {
-			(*panel_it)->printPanelInfo();
+			panel_it->printPanelInfo();
 			panel_it++;
 		}
 		
@@ -367,10 +367,23 @@ private:
 											 std::vector<Vec4i> &hierarchy) {
 		findContours(image, contours, hierarchy, RETR_EXTERNAL, 
 										CHAIN_APPROX_SIMPLE, Point(0, 0));
-		std::sort(contours.begin(), contours.end(), 
-				[this](std::vector<Point> a, std::vector<Point> b) {
-					return compareContourAreas(a, b); 
+
+	// Sort the contours smallest first. Each area is computed once, and the
+	// indices are sorted by it, so that each contour is moved only once.
+		std::vector<double> areas(contours.size());
+		std::vector<size_t> order(contours.size());
+		for(size_t i = 0; i < contours.size(); i++) {
+			areas[i] = fabs(contourArea(contours[i]));
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(),
+				[&areas](size_t a, size_t b) {
+					return areas[a] < areas[b];
 				});
+		std::vector<std::vector<Point>> sorted(contours.size());
+		for(size_t i = 0; i < order.size(); i++)
+			sorted[i] = std::move(contours[order[i]]);
+		contours.swap(sorted);
 	}
 	
 	void drawImageContours(Image &newImage, std::vector<std::vector<Point>> &contours, 
@@ -401,10 +414,16 @@ private:
 			                                       int interpolation = INTER_LINEAR) {
 		resizeImage(*this, outputSize, xScale, yScale, interpolation);
 	}
-	
-	bool compareContourAreas(std::vector<Point> contour1, std::vector<Point> contour2) {
-		return (fabs(contourArea(Mat(contour1))) < fabs(contourArea(Mat(contour2))));
-	}
+};
+
+// How panels are fitted to a wall. The best fit leaves the least of the wall
+// uncovered, and uses the fewest panels among those that do. Fits that leave
+// at most maxWaste uncovered all count as perfect, so then the fewest panels
+// win outright.
+struct FitOptions {
+// Wall and panel lengths are rounded to multiples of this before fitting
+	double resolution = 0.01;
+	double maxWaste = 0;
 };
 
 // Most of the functions of Processor are private so outside functions or 
@@ -412,7 +431,7 @@ private:
 // with the front-end could be added under public acess-modifier.
 class Processor {
 // Wall list
-	std::vector<Wall *> wallList;
+	std::vector<Wall> wallList;
 	
 // List of panels
 	std::vector<Panel> panelList;
@@ -426,8 +445,20 @@ class Processor {
 	
 // Map color names to HSV values
 	std::map<const String, std::vector<uint8_t>> colorNameHSVMap;
+
+// Number of panels of one width in a fit
+	struct PanelCount {
+		double width;
+		uint32_t numPanels;
+	};
+
+// How to fit panels to walls
+	FitOptions fitOptions;
 public:
-	Processor(const String &imageName, double scale = 0.1, double noiseThreshold = 10) {
+	Processor(const String &imageName, double scale = 0.1, double noiseThreshold = 10,
+			  const FitOptions &fitOptions = FitOptions()) {
+		this->fitOptions = fitOptions;
+
 	// Get the image
 		Image image(imageName);
 		image.convertBGR2HSV();
@@ -472,7 +503,7 @@ public:
 	}
 	
 // Get data collected by Processor
-	const std::vector<Wall *> &getWallList() const {
+	const std::vector<Wall> &getWallList() const {
 		return wallList;
 	}
 	
@@ -493,9 +524,9 @@ public:
 // Print wall list
 	void printWallList() {
 		std::cout << "===================== PRINTING WALL LIST ===================\n";
-		std::vector<Wall *>::iterator it = wallList.begin();
+		std::vector<Wall>::iterator it = wallList.begin();
 		while(it != wallList.end()) {
-			(*it)->printWallInfo();
+			it->printWallInfo();
 			it++;
 		}
 		std::cout << "============================================================\n";
@@ -547,14 +578,16 @@ private:
 	void boxContours(std::vector<std::vector<Point>> &contours, const Color &color) {
 	// Store the contour rectangles in an array	
 		std::vector<RotatedRect> minRect(contours.size());	
+		wallList.reserve(wallList.size() + contours.size());
 		unsigned long i = 0;
 		while(i != contours.size()) {
 			minRect[i] = minAreaRect(Mat(contours[i]));
 			
-		// Allocate wall
-			Wall *wall = allocateWall(color);
+		// Add a wall of the color to the wall list
+			wallList.push_back(Wall(color));
+			Wall &wall = wallList.back();
 			
-		// Get the rectangle points and add it to the allocated wall
+		// Get the rectangle points and add it to the wall
 			Point2f rect_points[4];
 			minRect[i].points(rect_points);
 			std::vector<Point2f> vect;
@@ -562,327 +595,133 @@ private:
 			vect.push_back(rect_points[1]);
 			vect.push_back(rect_points[2]);
 			vect.push_back(rect_points[3]);
-			wall->setRectPoints(vect);
-			
-		// Add the wall to wall list
-			wallList.push_back(wall);
+			wall.setRectPoints(vect);
 			
 			i++;
 		}
 	}
-	
-	Wall *allocateWall(const Color &color) {
-		Wall *wall = new Wall(color);
-		if(!wall) {
-			std::cout << "Error in allocating wall.\n";
-			exit(-1);
-		}
-		return wall;
-	}
-	
-	Wall *allocateWall(double length = 0, double width = 0, double height = 0) {
-		Wall *wall = new Wall(length, width, height);
-		if(!wall) {
-			std::cout << "Error in allocating wall.\n";
-			exit(-1);
-		}
-		return wall;
-	}
-	
-	Panel *allocatePanel(double width = 0, double height = 0) {
-		Panel *panel = new Panel(width, height);
-		if(!panel) {
-			std::cout << "Error in allocating panel.\n";
-			exit(-1);
-		}
-		return panel;
-	}
 
 	void computeNumPanelsBestFit() {
-	// Iterate over the wall list and compute the number of panels needed
-		std::vector<Wall *>::iterator wall = wallList.begin();
+	// Iterate over the wall list and fit panels to each wall
+		std::vector<Wall>::iterator wall = wallList.begin();
 		while(wall != wallList.end()) {
-		// Check if any panel type fits perfectly with the half wall of given length. 
-		// If not, we keep track of error and panel width the lowest leftover wall space
-		// to get the "best" panel. Put half panels in vector too.
-			double wallLength = ((*wall)->getLength()) / 2;
-			std::cout << "****************************************\n";
-			std::cout << "WALL LENGTH: " << 2 * wallLength << "\n";
-			double extraSpace = wallLength;
-			double optPanelWidth = 0;
-			double optPanelWidth2 = 0;
-			double smallerExtraSpace;
-			int zeroSpaceFitFound = -1;
-			std::vector<Panel> panelVect = panelList;
-			std::vector<Panel>::iterator panel = panelList.begin();
-			while(panel != panelList.end()) {
-				Panel temp_panel(((*panel).getWidth()) / 2);
-				panelVect.push_back(temp_panel);
-				panel++;
-			}
-			panel = panelVect.begin();
-			std::vector<double> panelsAdded;
-			while(panel != panelVect.end()) {
-				double panelWidth = panel->getWidth();
-				if(wallLength >= panelWidth) {
-					if(zeroSpaceFitFound == -1)
-						zeroSpaceFitFound = 0;
-					uint32_t numPanels = wallLength / panelWidth;
-					double spaceLeft = wallLength - (numPanels * panelWidth);
-					std::cout << "PANEL WIDTH: " << panelWidth << "\n";
-					std::cout << "SPACE LEFT: " << spaceLeft << "\n";
-					if(!spaceLeft) {
-					// Perfect match found! Allocate panel. But before that, check if
-					// its a half panel.
-						zeroSpaceFitFound = 1;
-						std::vector<Panel>::iterator temp_panel = panelList.begin();
-						while(temp_panel != panelList.end()) {
-							if(panelWidth == (*temp_panel).getWidth()) {
-								Panel *panel = allocatePanel(panelWidth);
-								numPanels = wallLength / panelWidth;
-								(*wall)->addBestFitPanels(panel, 2 * numPanels);
-								std::cout << "NUM PANELS: " << 2 * numPanels << "\n";
-								panelsAdded.push_back(panelWidth);
-								goto next_panel;
-							}
-							temp_panel++;
-						}
-						
-					// Check if the full panel corresponding to the full panel has already
-					// been added to the wall. If yes, we can move on.
-						panelWidth *= 2;
-						if(find(panelsAdded.begin(), panelsAdded.end(), 
-											panelWidth) == panelsAdded.end()) {
-							Panel *panel = allocatePanel(panelWidth);
-							numPanels = wallLength / panelWidth;
-							(*wall)->addBestFitPanels(panel, (2 * numPanels) + 1);
-							std::cout << "NUM PANELS: " << (2 * numPanels) + 1 << "\n";	
-						}
-						goto next_panel;
-					}
-					
-					std::vector<Panel>::iterator temp_panel = panelList.begin();
-					while(temp_panel != panelList.end()) {
-						if(panelWidth == (*temp_panel).getWidth()) {
-						// Get the lowest space left over
-							if(spaceLeft < extraSpace) {
-								extraSpace = spaceLeft;
-								optPanelWidth = panelWidth;
-								std::cout << "EXTRA\n";
-							}
-						
-						// Check if the space left can be filled up by some other panels
-							std::vector<double> panelsAdded2;
-							Panel *optPanel = nullptr;
-							smallerExtraSpace = extraSpace;
-							std::vector<Panel>::iterator panel_it = panelVect.begin();
-							while(panel_it != panelVect.end()) {
-								double panelWidth = panel_it->getWidth();
-								if(extraSpace >= panelWidth) {
-									uint32_t numPanels = extraSpace / panelWidth;
-									double spaceLeft = extraSpace - (numPanels * panelWidth);
-									std::cout << "--PANEL WIDTH: " << panelWidth << "\n";
-									std::cout << "--SPACE LEFT: " << spaceLeft << "\n";
-									if(!spaceLeft) {
-									// Perfect match found! Allocate panel. But before that, 
-									// check if its a half panel.
-										zeroSpaceFitFound = 1;
-										std::vector<Panel>::iterator temp_panel = panelList.begin();
-										while(temp_panel != panelList.end()) {
-											if(panelWidth == (*temp_panel).getWidth()) {
-											// Add the panel that we found fits first
-												if(!optPanel) {
-													std::cout << "--OPT PANEL WIDTH: " << optPanelWidth << "\n";
-													optPanel = allocatePanel(optPanelWidth);
-													numPanels = wallLength / optPanelWidth;
-													(*wall)->addBestFitPanels(optPanel, 2 * numPanels);
-													std::cout << "--NUM PANELS: " << 2 * numPanels << "\n";
-												}
-												
-											// Alocate the rest of panels	
-												Panel *panel = allocatePanel(panelWidth);
-												numPanels = extraSpace / panelWidth;
-												(*wall)->addBestFitPanels(panel, 2 * numPanels);
-												std::cout << "--NUM PANELS: " << 2 * numPanels << "\n";
-												panelsAdded2.push_back(panelWidth);
-												goto next_panel_in;
-											}
-											temp_panel++;
-										}
-										panelWidth *= 2;
-										if(find(panelsAdded2.begin(), panelsAdded2.end(), 
-																panelWidth) == panelsAdded2.end()) {
-										// Add the panel that we found fits first
-											if(!optPanel) {
-												std::cout << "--OPT PANEL WIDTH: " << optPanelWidth << "\n";
-												optPanel = allocatePanel(optPanelWidth);
-												numPanels = wallLength / optPanelWidth;
-												(*wall)->addBestFitPanels(optPanel, 2 * numPanels);	
-												std::cout << "--NUM PANELS: " << 2 * numPanels << "\n";
-											}
-											
-											Panel *panel = allocatePanel(panelWidth);
-											numPanels = extraSpace / panelWidth;
-											(*wall)->addBestFitPanels(panel, (2 * numPanels) + 1);
-											std::cout << "--NUM PANELS: " << (2 * numPanels) + 1 << "\n";
-										}
-										goto next_panel_in;
-									}
-									std::vector<Panel>::iterator temp_panel = panelList.begin();
-									while(temp_panel != panelList.end()) {
-										if(panelWidth == (*temp_panel).getWidth()) {
-											if(spaceLeft < smallerExtraSpace) {
-												smallerExtraSpace = spaceLeft;
-												optPanelWidth2 = panelWidth;
-												std::cout << "--EXTRA\n";
-											}
-											break;
-										}
-										temp_panel++;
-									}
-								}
-							next_panel_in:
-								panel_it++;
-							}
-							
-						// If the extra space after panelizing small space is less than what we
-						// got earlier, this is a better solution.
-							if(smallerExtraSpace < extraSpace)
-								extraSpace = smallerExtraSpace;
-							
-							break;
-						}
-						temp_panel++;
-					}
-				}
-			next_panel:
-				panel++;
+			std::vector<PanelCount> fit;
+			fitPanels(wall->getLength(), fit);
+
+			std::vector<PanelCount>::iterator it = fit.begin();
+			while(it != fit.end()) {
+				wall->addBestFitPanels(Panel(it->width), it->numPanels);
+				it++;
 			}
-			
-		// If the best fit with zero space left is not found deal with the panels that work	
-			if(!zeroSpaceFitFound && optPanelWidth) {
-				Panel *panel = allocatePanel(optPanelWidth);
-				uint32_t numPanels = wallLength / optPanelWidth;
-				(*wall)->addBestFitPanels(panel, 2 * numPanels);
-				std::cout << "zPANEL WIDTH: " << optPanelWidth << "\n";
-				std::cout << "zNUM PANELS: " << 2 * numPanels << "\n";
-				
-			// Get the extra space left after panelizing using "best" panel. 
-				extraSpace = wallLength - ((uint32_t)(wallLength / optPanelWidth) * optPanelWidth);
-				
-			// Check if there is a second panel type that needs to be added
-				if(optPanelWidth2) {
-					Panel *panel = allocatePanel(optPanelWidth2);
-					uint32_t numPanels = extraSpace / optPanelWidth2;
-					(*wall)->addBestFitPanels(panel, 2 * numPanels);
-					std::cout << "zPANEL WIDTH2: " << optPanelWidth2 << "\n";
-					std::cout << "zNUM PANELS: " << 2 * numPanels << "\n";
-					
-				// Recompute the extra space	
-					extraSpace = extraSpace - 
-									((uint32_t)(extraSpace / optPanelWidth2) * optPanelWidth2);
+			wall++;
+		}
+	}
+
+// Fit panels from the panel list to a wall of the given length, as an unbounded
+// knapsack over the length in units of fitOptions.resolution. For every length
+// up to the wall's, we find the fewest panels that cover it exactly; the best
+// fit is then read off the longest of those lengths, or the one with fewest
+// panels among those within maxWaste of the wall. This takes time in
+// O(length * panel types). Returns the length left uncovered.
+	double fitPanels(double wallLength, std::vector<PanelCount> &fit) const {
+		fit.clear();
+		double resolution = fitOptions.resolution;
+		if(wallLength <= 0 || resolution <= 0)
+			return std::max(wallLength, 0.0);
+		size_t length = lengthInUnits(wallLength);
+
+	// Panel widths in units, without duplicates
+		std::vector<size_t> widths;
+		std::vector<Panel>::const_iterator panel = panelList.begin();
+		while(panel != panelList.end()) {
+			size_t width = lengthInUnits(panel->getWidth() + resolution / 2);
+			if(width > 0 && std::find(widths.begin(), widths.end(), width) == widths.end())
+				widths.push_back(width);
+			panel++;
+		}
+
+		const uint32_t unreachable = UINT32_MAX;
+		std::vector<uint32_t> numPanels(length + 1, unreachable);
+		std::vector<uint32_t> lastPanel(length + 1, 0);
+		numPanels[0] = 0;
+		for(size_t covered = 1; covered <= length; covered++) {
+			for(size_t k = 0; k < widths.size(); k++) {
+				if(widths[k] > covered || numPanels[covered - widths[k]] == unreachable)
+					continue;
+				if(numPanels[covered - widths[k]] + 1 < numPanels[covered]) {
+					numPanels[covered] = numPanels[covered - widths[k]] + 1;
+					lastPanel[covered] = (uint32_t)k;
 				}
-				std::cout << "EXTRA SPACE LEFT: " << 2 * extraSpace << "\n";
-			} else {
-				goto next_wall;
 			}
-				
-		// Try to fit panels in the left over space. Half panels would do as well.
-			zeroSpaceFitFound = -1;
-			panelsAdded.clear();
-			smallerExtraSpace = extraSpace;
-			optPanelWidth = 0;
-			panel = panelVect.begin();
-			while(panel != panelVect.end()) {
-				double panelWidth = panel->getWidth();
-				if(extraSpace >= panelWidth) {
-					if(zeroSpaceFitFound == -1)
-						zeroSpaceFitFound = 0;
-					uint32_t numPanels = extraSpace / panelWidth;
-					double spaceLeft = extraSpace - (numPanels * panelWidth);
-					std::cout << "--PANEL WIDTH: " << panelWidth << "\n";
-					std::cout << "--SPACE LEFT: " << spaceLeft << "\n";
-					if(!spaceLeft) {
-					// Perfect match found! Allocate panel. But before that, check if
-					// its a half panel.
-						zeroSpaceFitFound = 1;
-						std::vector<Panel>::iterator temp_panel = panelList.begin();
-						while(temp_panel != panelList.end()) {
-							if(panelWidth == (*temp_panel).getWidth()) {
-								Panel *panel = allocatePanel(panelWidth);
-								numPanels = extraSpace / panelWidth;
-								(*wall)->addBestFitPanels(panel, 2 * numPanels);
-								std::cout << "--NUM PANELS: " << 2 * numPanels << "\n";
-								panelsAdded.push_back(panelWidth);
-								goto next_panel2;
-							}
-							temp_panel++;
-						}
-						panelWidth *= 2;
-						if(find(panelsAdded.begin(), panelsAdded.end(), 
-												panelWidth) == panelsAdded.end()) {
-							Panel *panel = allocatePanel(panelWidth);
-							numPanels = extraSpace / panelWidth;
-							(*wall)->addBestFitPanels(panel, (2 * numPanels) + 1);
-							std::cout << "--NUM PANELS: " << (2 * numPanels) + 1 << "\n";
-						}
-						goto next_panel2;
-					}
-					if(spaceLeft < smallerExtraSpace) {
-						smallerExtraSpace = spaceLeft;
-						optPanelWidth = panelWidth;
-						std::cout << "--EXTRA\n";
-					}	
-				}
-			next_panel2:
-				panel++;
+		}
+
+	// Pick the best covered length
+		size_t tolerance = lengthInUnits(fitOptions.maxWaste + resolution / 2);
+		size_t best = 0;
+		for(size_t covered = length; covered > 0; covered--) {
+			if(numPanels[covered] == unreachable)
+				continue;
+			if(length - covered > tolerance) {
+				if(best == 0)
+					best = covered;
+				break;
 			}
-			
-		// If the best fit with zero space left is not found deal with the panels that work	
-			if(!zeroSpaceFitFound && optPanelWidth) {
-			// Now, add the rest of the panels
-				Panel *panel = allocatePanel(optPanelWidth);
-				uint32_t numPanels = extraSpace / optPanelWidth;
-				(*wall)->addBestFitPanels(panel, 2 * numPanels);
-				std::cout << "--zPANEL WIDTH: " << optPanelWidth << "\n";
-				std::cout << "--zNUM PANELS: " << 2 * numPanels << "\n";
+			if(best == 0 || numPanels[covered] < numPanels[best])
+				best = covered;
+		}
+
+	// And walk back through the panels that make it up
+		std::vector<uint32_t> counts(widths.size(), 0);
+		for(size_t covered = best; covered > 0; covered -= widths[lastPanel[covered]])
+			counts[lastPanel[covered]]++;
+		for(size_t k = 0; k < widths.size(); k++) {
+			if(counts[k]) {
+				PanelCount count = { widths[k] * resolution, counts[k] };
+				fit.push_back(count);
 			}
-	
-		next_wall:
-			std::cout << "***********************************************\n";
-			wall++;
 		}
+		return std::max(wallLength - best * resolution, 0.0);
+	}
+
+	size_t lengthInUnits(double length) const {
+		if(length <= 0 || fitOptions.resolution <= 0)
+			return 0;
+		return (size_t)floor(length / fitOptions.resolution + 1e-9);
 	}
 
 	void filterNoise(double scale, double noiseThreshold) {
 	// Filter noise. Avoid anything that does not have a proper, significant size
 	// Traverse the object list and filter the bugger noise out. For rectangles,
 	// there are only three unique distances. We pick two shortest lengths, ignoring
-	// the longest one which is most likely to be the diagonal.
-		std::vector<Wall *> tempList = wallList;
-		wallList.clear();
-		std::vector<Wall *>::iterator wall_it = tempList.begin();
-		while(wall_it != tempList.end()) {
+	// the longest one which is most likely to be the diagonal. The walls that are
+	// kept are moved down over the ones that are not.
+		std::vector<Wall>::iterator kept = wallList.begin();
+		std::vector<Wall>::iterator wall_it = wallList.begin();
+		while(wall_it != wallList.end()) {
 		// Walls are treated as rectangles. Get two rectangle sides	and check if the ratio of
-		// sides is more than the threshold. If it is, put the wall in the wall list and save 
+		// sides is more than the threshold. If it is, keep the wall in the wall list and save 
 		// the scaled lengths of the walls.
-			double side1 = euclideanDistance((*wall_it)->getVertex(0), (*wall_it)->getVertex(1));
-			double side2 = euclideanDistance((*wall_it)->getVertex(1), (*wall_it)->getVertex(2));
+			double side1 = euclideanDistance(wall_it->getVertex(0), wall_it->getVertex(1));
+			double side2 = euclideanDistance(wall_it->getVertex(1), wall_it->getVertex(2));
+			double length = 0;
 			if(side1 && side2) {
 				if(side1 > side2) {
-					if(side1 / side2 >= noiseThreshold) {
-						wallList.push_back(*wall_it);
-						(*wall_it)->setLength(side1 * scale);
-					}
+					if(side1 / side2 >= noiseThreshold)
+						length = side1;
 				} else {
-					if(side2 / side1 >= noiseThreshold) {
-						wallList.push_back(*wall_it);
-						(*wall_it)->setLength(side2 * scale);
-					}
+					if(side2 / side1 >= noiseThreshold)
+						length = side2;
 				}
 			}
+			if(length) {
+				wall_it->setLength(length * scale);
+				if(kept != wall_it)
+					*kept = std::move(*wall_it);
+				kept++;
+			}
 			wall_it++;
 		}
+		wallList.erase(kept, wallList.end());
 	}
 
 // Calculate the euclidean distance between the points
@@ -4,11 +4,17 @@
 // Copyright 2016 whitequark
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
+#include "platform/headless.h"
+#if !defined(WIN32)
+#   include <unistd.h>
+#   include <poll.h>
+#   include <signal.h>
+#   include <sys/wait.h>
+#endif
 
-namespace SolveSpace {
-    // These are defined in headless.cpp, and aren't exposed in solvespace.h.
-    extern std::shared_ptr<Pixmap> framebuffer;
-}
+// There is one worker process per job, so this keeps a mistyped --jobs from
+// forking thousands of them.
+static const int MAX_JOBS = 256;
 
 static void ShowUsage(const std::string &cmd) {
     fprintf(stderr, "Usage: %s <command> <options> <filename> [filename...]", cmd.c_str());
@@ -30,6 +36,19 @@ Common options:
         piecewise linear, and exact surfaces into triangle meshes.
         For export commands, the unit is mm, and the default is 1.0 mm.
         For non-export commands, the unit is %%, and the default is 1.0 %%.
+    --trace <filename>
+        Records where the time goes, as a Chrome trace (for chrome://tracing
+        or Perfetto). Setting SOLVESPACE_TRACE=<filename> does the same.
+        With --jobs, each worker records its own trace next to it, with the
+        process id of the worker before the extension.
+    -j, --jobs <count>
+        Processes up to <count> input files at once, each in a separate
+        worker process, with at most 256 at once. Messages are still
+        reported in the order of the input files, and processing stops at
+        the first file that fails. Linked files are loaded once, before
+        the workers start, and shared between them; like the files linked
+        from one input, they are read only once per run, so changes made
+        to them while it runs are not seen.
 
 Commands:
     thumbnail --output <pattern> --size <size> --view <direction>
@@ -39,6 +58,11 @@ Commands:
         not used, and the output may look slightly different from the GUI.
     export-view --output <pattern> --view <direction> [--chord-tol <tolerance>]
         Exports a view of the sketch, in a 2d vector format.
+    export-slices --output <pattern> --view <direction> --step <distance>
+                  [--chord-tol <tolerance>]
+        Exports sections through solids in the sketch, in planes normal to
+        the view direction and <distance> mm apart, in a 2d vector format.
+        Sections are written to the output file name with a -NNN suffix.
     export-wireframe --output <pattern> [--chord-tol <tolerance>]
         Exports a wireframe of the sketch, in a 3d vector format.
     export-mesh --output <pattern> [--chord-tol <tolerance>]
@@ -48,6 +72,44 @@ Commands:
         Exports exact surfaces of solids in the sketch, if any.
     regenerate
         Reloads all imported files, regenerates the sketch, and saves it.
+    sweep --output <pattern> --table <table> [--view <direction>]
+          [--chord-tol <tolerance>]
+        Exports a family of variants of the sketch. <table> is a CSV file
+        whose header lists the handles of dimensions (as in "c01a"), and
+        optionally a "name" column; each further row gives the values of
+        those dimensions, in mm or degrees, for one variant. The '#' symbol
+        in <pattern> is replaced with the name, or the number of the
+        variant. The format is chosen from the extension of <pattern>, as
+        for export-mesh, export-surfaces, or export-view (which needs
+        --view); a .slvs extension saves each variant as a sketch.
+        Each variant is solved starting from the previous one, and only
+        the groups after the first changed dimension are regenerated.
+        With --jobs, the variants are split between the workers.
+    daemon
+        Reads requests from standard input, one JSON object per line, and
+        writes one JSON object per line to standard output in response.
+        The sketch stays loaded and solved between requests, and is
+        regenerated only from the first group that an edit affects.
+        Each request has a "command", and optionally an "id" that is echoed
+        in the response; the response has "ok", and "error" if it failed.
+        Commands:
+            {"command": "load", "file": <filename>}
+            {"command": "set-constraint", "constraint": <handle>,
+             "value": <value>}
+                Sets a dimension, in mm or degrees, and regenerates.
+                The response has "solved", false if the sketch failed to
+                solve. <handle> is a number, or a hex string like "c01a".
+            {"command": "set-param", "param": <handle>, "value": <value>}
+                Sets a parameter of a request, and regenerates.
+            {"command": "export-view", "output": <filename>,
+             "view": <direction>, ["chord-tol": <tolerance>]}
+            {"command": "export-wireframe", "output": <filename>,
+             ["chord-tol": <tolerance>]}
+            {"command": "export-mesh", "output": <filename>,
+             ["chord-tol": <tolerance>]}
+            {"command": "export-surfaces", "output": <filename>}
+            {"command": "save", "output": <filename>}
+            {"command": "quit"}
 )");
 
     auto FormatListFromFileFilter = [](const FileFilter *filter) {
@@ -73,17 +135,876 @@ Commands:
 File formats:
     thumbnail:%s
     export-view:%s
+    export-slices:%s
     export-wireframe:%s
     export-mesh:%s
     export-surfaces:%s
 )", FormatListFromFileFilter(RasterFileFilter).c_str(),
+    FormatListFromFileFilter(VectorFileFilter).c_str(),
     FormatListFromFileFilter(VectorFileFilter).c_str(),
     FormatListFromFileFilter(Vector3dFileFilter).c_str(),
     FormatListFromFileFilter(MeshFileFilter).c_str(),
     FormatListFromFileFilter(SurfaceFileFilter).c_str());
 }
 
-static bool RunCommand(const std::vector<std::string> args) {
+// A unit of work: an input file, and for a sweep, a range of the variants.
+struct WorkItem {
+    Platform::Path  inputFile;
+    size_t          firstRow;
+    size_t          rowCount;
+};
+
+#if !defined(WIN32)
+static bool ReadAll(int fd, void *data, size_t size) {
+    char *ptr = (char *)data;
+    while(size > 0) {
+        ssize_t count = read(fd, ptr, size);
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0) return false;
+        ptr  += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+static bool WriteAll(int fd, const void *data, size_t size) {
+    const char *ptr = (const char *)data;
+    while(size > 0) {
+        ssize_t count = write(fd, ptr, size);
+        if(count < 0 && errno == EINTR) continue;
+        if(count <= 0) return false;
+        ptr  += count;
+        size -= (size_t)count;
+    }
+    return true;
+}
+
+// The body of a worker process: read the indexes of work items to process,
+// until the pipe is closed, and answer each with the success flag and with
+// everything that was written to stderr while processing it.
+static void RunWorker(int fromParent, int toParent,
+                      const std::vector<WorkItem> &items,
+                      const std::function<bool(const WorkItem &)> &process) {
+    // Our events can't reach the trace of the parent, and we leave with _exit,
+    // which wouldn't write them anyway; so record a trace of our own instead,
+    // e.g. trace.1234.json next to trace.json.
+    if(TraceScope::TraceIsActive()) {
+        Platform::Path trace = TraceScope::Filename();
+        std::string pid = std::to_string(getpid());
+        std::string ext = trace.Extension();
+        TraceScope::Start(trace.WithExtension(ext.empty() ? pid : pid + "." + ext));
+    }
+
+    uint32_t index;
+    while(ReadAll(fromParent, &index, sizeof(index))) {
+        FILE *log = tmpfile();
+        int savedStderr = dup(STDERR_FILENO);
+        fflush(stderr);
+        if(log) dup2(fileno(log), STDERR_FILENO);
+
+        uint8_t success = process(items[index]) ? 1 : 0;
+
+        fflush(stderr);
+        dup2(savedStderr, STDERR_FILENO);
+        close(savedStderr);
+
+        std::string messages;
+        if(log) {
+            fseek(log, 0, SEEK_END);
+            messages.resize((size_t)ftell(log));
+            fseek(log, 0, SEEK_SET);
+            messages.resize(fread(&messages[0], 1, messages.size(), log));
+            fclose(log);
+        }
+
+        uint32_t length = (uint32_t)messages.size();
+        if(!(WriteAll(toParent, &index, sizeof(index)) &&
+             WriteAll(toParent, &success, sizeof(success)) &&
+             WriteAll(toParent, &length, sizeof(length)) &&
+             WriteAll(toParent, messages.data(), messages.size()))) break;
+    }
+    TraceScope::Stop();
+}
+
+//-----------------------------------------------------------------------------
+// Process the work items in a pool of worker processes. The sketch is global
+// state, so each worker is a forked copy of us that handles one item at a
+// time, as they become free. We print the messages for each item in order,
+// and stop at the first failure, so that the output is the same as when
+// processing the items one after another.
+//-----------------------------------------------------------------------------
+static bool RunInWorkers(const std::vector<WorkItem> &items, unsigned jobs,
+                         const std::function<bool(const WorkItem &)> &process) {
+    struct Worker {
+        pid_t   pid;
+        int     toWorker;
+        int     fromWorker;
+        int     index;      // of the file being processed, or -1 if idle
+    };
+    struct Result {
+        bool        done;
+        bool        success;
+        std::string messages;
+    };
+
+    signal(SIGPIPE, SIG_IGN);
+    fflush(stdout);
+    fflush(stderr);
+
+    std::vector<Worker> workers;
+    for(unsigned i = 0; i < jobs && i < items.size(); i++) {
+        int toWorker[2], fromWorker[2];
+        if(pipe(toWorker) != 0) break;
+        if(pipe(fromWorker) != 0) {
+            close(toWorker[0]);
+            close(toWorker[1]);
+            break;
+        }
+
+        pid_t pid = fork();
+        if(pid == 0) {
+            // Don't hold the pipes of the other workers open.
+            for(const Worker &w : workers) {
+                close(w.toWorker);
+                close(w.fromWorker);
+            }
+            close(toWorker[1]);
+            close(fromWorker[0]);
+            RunWorker(toWorker[0], fromWorker[1], items, process);
+            _exit(0);
+        }
+
+        close(toWorker[0]);
+        close(fromWorker[1]);
+        if(pid < 0) {
+            close(toWorker[1]);
+            close(fromWorker[0]);
+            break;
+        }
+        workers.push_back({ pid, toWorker[1], fromWorker[0], -1 });
+    }
+    if(workers.empty()) {
+        fprintf(stderr, "Cannot start worker processes; processing files sequentially.\n");
+        for(const WorkItem &item : items) {
+            if(!process(item)) return false;
+        }
+        return true;
+    }
+
+    std::vector<Result> results(items.size());
+    size_t nextToStart = 0, nextToReport = 0;
+    bool failed = false;
+
+    auto Dispatch = [&](Worker *w) {
+        while(!failed && nextToStart < items.size()) {
+            uint32_t index = (uint32_t)nextToStart++;
+            if(WriteAll(w->toWorker, &index, sizeof(index))) {
+                w->index = (int)index;
+                return;
+            }
+            // The worker died; nothing else will be sent to it.
+            results[index] = { true, false, ssprintf("Worker process for '%s' failed.\n",
+                                                     items[index].inputFile.raw.c_str()) };
+            w->index = -1;
+            break;
+        }
+    };
+    for(Worker &w : workers) {
+        Dispatch(&w);
+    }
+
+    while(nextToReport < items.size() && !failed) {
+        std::vector<pollfd> fds;
+        std::vector<Worker *> polled;
+        for(Worker &w : workers) {
+            if(w.index < 0) continue;
+            fds.push_back({ w.fromWorker, POLLIN, 0 });
+            polled.push_back(&w);
+        }
+
+        if(!fds.empty()) {
+            if(poll(fds.data(), fds.size(), -1) < 0) {
+                if(errno == EINTR) continue;
+                fprintf(stderr, "Cannot wait for worker processes.\n");
+                failed = true;
+                break;
+            }
+            for(size_t i = 0; i < fds.size(); i++) {
+                if(fds[i].revents == 0) continue;
+                Worker *w = polled[i];
+
+                uint32_t index, length;
+                uint8_t success;
+                Result result = { true, false, "" };
+                if(ReadAll(w->fromWorker, &index, sizeof(index)) &&
+                   ReadAll(w->fromWorker, &success, sizeof(success)) &&
+                   ReadAll(w->fromWorker, &length, sizeof(length))) {
+                    result.messages.resize(length);
+                    if(ReadAll(w->fromWorker, &result.messages[0], length)) {
+                        result.success = (success != 0);
+                    }
+                }
+                if(!result.success && result.messages.empty()) {
+                    result.messages = ssprintf("Worker process for '%s' failed.\n",
+                                               items[w->index].inputFile.raw.c_str());
+                }
+                results[w->index] = result;
+                w->index = -1;
+                Dispatch(w);
+            }
+        }
+
+        bool progress = false;
+        while(nextToReport < items.size() && results[nextToReport].done) {
+            const Result &result = results[nextToReport++];
+            fputs(result.messages.c_str(), stderr);
+            progress = true;
+            if(!result.success) {
+                failed = true;
+                break;
+            }
+        }
+        if(fds.empty() && !progress) {
+            // All workers are gone, and there is nothing left to report.
+            failed = true;
+        }
+    }
+
+    for(Worker &w : workers) {
+        close(w.toWorker);
+        if(failed) kill(w.pid, SIGTERM);
+    }
+    for(Worker &w : workers) {
+        waitpid(w.pid, NULL, 0);
+        close(w.fromWorker);
+    }
+    return !failed;
+}
+
+//-----------------------------------------------------------------------------
+// Fill the linked-file cache with the parts that the input files link, by
+// loading each of them once. Failures are left to be reported when the file
+// is processed for real, so any messages are discarded.
+//-----------------------------------------------------------------------------
+static void WarmLinkedFileCache(const std::vector<Platform::Path> &inputFiles) {
+    std::vector<std::string> messages;
+    messageLog = &messages;
+
+    std::set<Platform::Path, Platform::PathLess> loaded;
+    for(const Platform::Path &inputFile : inputFiles) {
+        Platform::Path absInputFile = inputFile.Expand(/*fromCurrentDirectory=*/true);
+        if(!loaded.insert(absInputFile).second) continue;
+
+        SS.Init();
+        SS.LoadFromFile(absInputFile);
+        SK.Clear();
+        SS.Clear();
+    }
+
+    messageLog = NULL;
+}
+#else
+static bool RunInWorkers(const std::vector<WorkItem> &items, unsigned jobs,
+                         const std::function<bool(const WorkItem &)> &process) {
+    fprintf(stderr, "Worker processes are not supported on this platform; "
+                    "processing files sequentially.\n");
+    for(const WorkItem &item : items) {
+        if(!process(item)) return false;
+    }
+    return true;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// The variants of a sweep: a CSV file whose header names the dimensions to
+// change, by constraint handle as shown in the GUI (e.g. "c01a"), and
+// optionally a "name" column that is substituted for # in the output pattern
+// instead of the variant number. Every other row gives the values, in mm or
+// degrees, for one variant.
+//-----------------------------------------------------------------------------
+struct SweepTable {
+    enum class ExportAs { MESH, SURFACES, VIEW, SKETCH };
+
+    std::vector<hConstraint>            constraints;
+    std::vector<std::vector<double>>    values;
+    std::vector<std::string>            names;
+    ExportAs                            exportAs;
+};
+
+static std::vector<std::string> SplitCsvLine(const std::string &line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for(size_t i = 0; i < line.size(); i++) {
+        char c = line[i];
+        if(quoted) {
+            if(c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+                field += '"';
+                i++;
+            } else if(c == '"') {
+                quoted = false;
+            } else {
+                field += c;
+            }
+        } else if(c == '"') {
+            quoted = true;
+        } else if(c == ',') {
+            fields.push_back(field);
+            field.clear();
+        } else if(c != '\r') {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+
+    for(std::string &f : fields) {
+        size_t first = f.find_first_not_of(" \t"),
+               last  = f.find_last_not_of(" \t");
+        f = (first == std::string::npos) ? "" : f.substr(first, last - first + 1);
+    }
+    return fields;
+}
+
+static bool ReadSweepTable(const Platform::Path &filename, SweepTable *table) {
+    FILE *f = OpenFile(filename, "rb");
+    if(!f) {
+        fprintf(stderr, "Cannot open '%s'!\n", filename.raw.c_str());
+        return false;
+    }
+
+    std::vector<std::vector<std::string>> rows;
+    std::string line;
+    int c;
+    do {
+        c = fgetc(f);
+        if(c == EOF || c == '\n') {
+            if(line.find_first_not_of(" \t\r") != std::string::npos) {
+                rows.push_back(SplitCsvLine(line));
+            }
+            line.clear();
+        } else {
+            line += (char)c;
+        }
+    } while(c != EOF);
+    fclose(f);
+
+    if(rows.empty()) return true;
+
+    int nameColumn = -1;
+    std::vector<int> valueColumns;
+    for(size_t i = 0; i < rows[0].size(); i++) {
+        const std::string &header = rows[0][i];
+        if(header == "name") {
+            nameColumn = (int)i;
+            continue;
+        }
+
+        const char *start = header.c_str();
+        if(*start == 'c') start++;
+        char *end;
+        hConstraint hc = { (uint32_t)strtoul(start, &end, 16) };
+        if(*start == '\0' || *end != '\0') {
+            fprintf(stderr, "Column '%s' is not a constraint handle.\n", header.c_str());
+            return false;
+        }
+        table->constraints.push_back(hc);
+        valueColumns.push_back((int)i);
+    }
+
+    for(size_t r = 1; r < rows.size(); r++) {
+        const std::vector<std::string> &row = rows[r];
+        if(row.size() != rows[0].size()) {
+            fprintf(stderr, "Row %d of the table has %d columns instead of %d.\n",
+                    (int)r + 1, (int)row.size(), (int)rows[0].size());
+            return false;
+        }
+
+        std::vector<double> values;
+        for(int column : valueColumns) {
+            const char *start = row[column].c_str();
+            char *end;
+            values.push_back(strtod(start, &end));
+            if(end == start || *end != '\0') {
+                fprintf(stderr, "Row %d of the table has a bad value '%s'.\n",
+                        (int)r + 1, start);
+                return false;
+            }
+        }
+        table->values.push_back(values);
+        table->names.push_back(nameColumn >= 0 ? row[nameColumn] : "");
+    }
+    return true;
+}
+
+static bool MatchesFileFilter(const Platform::Path &filename, const FileFilter *filter) {
+    for(; filter->name; filter++) {
+        for(const char *const *pattern = filter->patterns; *pattern; pattern++) {
+            if(filename.HasExtension(*pattern)) return true;
+        }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// Generate and export a range of the variants of a sweep, from the loaded
+// sketch. Each variant only changes the dimensions whose values differ from
+// the previous one, so regeneration starts from the first group they affect,
+// and the solver starts from the previous variant's solution. A variant that
+// fails to solve is reported and skipped, and the next one starts from the
+// last good solution instead.
+//-----------------------------------------------------------------------------
+static bool RunSweep(const SweepTable &sweep, const WorkItem &item,
+                     const Platform::Path &absOutput, const Platform::Path &output) {
+    for(hConstraint hc : sweep.constraints) {
+        Constraint *c = SK.constraint.FindByIdNoOops(hc);
+        if(!c || !c->HasLabel() || c->type == Constraint::Type::COMMENT || c->reference) {
+            fprintf(stderr, "No dimension c%03x in '%s'!\n", hc.v, item.inputFile.raw.c_str());
+            return false;
+        }
+    }
+
+    // Bring the sketch up to the export tolerances once, so that each variant
+    // only regenerates what it changes.
+    SS.GenerateForExport();
+
+    IdList<Param,hParam> goodParams = {};
+    SK.param.DeepCopyInto(&goodParams);
+
+    int digits = (int)std::to_string(sweep.values.size()).length();
+    bool success = true;
+    for(size_t row = item.firstRow; row < item.firstRow + item.rowCount; row++) {
+        std::string name = sweep.names[row];
+        if(name.empty()) name = ssprintf("%0*d", digits, (int)row + 1);
+
+        if(!SS.GenerateVariantForExport(sweep.constraints, sweep.values[row], &goodParams)) {
+            fprintf(stderr, "Variant '%s' failed to solve; skipped.\n", name.c_str());
+            success = false;
+            continue;
+        }
+
+        Platform::Path absOutputFile = absOutput, outputFile = output;
+        size_t replaceAt;
+        if((replaceAt = absOutputFile.raw.rfind('#')) != std::string::npos) {
+            absOutputFile.raw.replace(replaceAt, 1, name);
+        }
+        if((replaceAt = outputFile.raw.rfind('#')) != std::string::npos) {
+            outputFile.raw.replace(replaceAt, 1, name);
+        }
+
+        switch(sweep.exportAs) {
+            case SweepTable::ExportAs::MESH:
+                SS.ExportMeshTo(absOutputFile);
+                break;
+            case SweepTable::ExportAs::SURFACES: {
+                StepFileWriter sfw = {};
+                sfw.ExportSurfacesTo(absOutputFile);
+                break;
+            }
+            case SweepTable::ExportAs::VIEW:
+                SS.ExportViewOrWireframeTo(absOutputFile, /*exportWireframe=*/false);
+                break;
+            case SweepTable::ExportAs::SKETCH:
+                SS.SaveToFile(absOutputFile);
+                break;
+        }
+        fprintf(stderr, "Written '%s'.\n", outputFile.raw.c_str());
+    }
+    goodParams.Clear();
+    return success;
+}
+
+//-----------------------------------------------------------------------------
+// A minimal reader and writer for the JSON of the daemon protocol, which only
+// uses flat objects with string, number, boolean and null values.
+//-----------------------------------------------------------------------------
+struct JsonValue {
+    enum class Type { NUL, BOOLEAN, NUMBER, STRING };
+
+    Type        type;
+    bool        boolean;
+    double      number;
+    std::string string;
+};
+typedef std::map<std::string, JsonValue> JsonObject;
+
+static bool ParseJsonString(const std::string &text, size_t *pos, std::string *str) {
+    size_t &i = *pos;
+    if(i >= text.size() || text[i] != '"') return false;
+    i++;
+
+    auto AppendUtf8 = [&](uint32_t cp) {
+        if(cp < 0x80) {
+            *str += (char)cp;
+        } else if(cp < 0x800) {
+            *str += (char)(0xc0 | (cp >> 6));
+            *str += (char)(0x80 | (cp & 0x3f));
+        } else if(cp < 0x10000) {
+            *str += (char)(0xe0 | (cp >> 12));
+            *str += (char)(0x80 | ((cp >> 6) & 0x3f));
+            *str += (char)(0x80 | (cp & 0x3f));
+        } else {
+            *str += (char)(0xf0 | (cp >> 18));
+            *str += (char)(0x80 | ((cp >> 12) & 0x3f));
+            *str += (char)(0x80 | ((cp >> 6) & 0x3f));
+            *str += (char)(0x80 | (cp & 0x3f));
+        }
+    };
+    auto ParseHex4 = [&](uint32_t *cp) {
+        if(i + 4 > text.size()) return false;
+        *cp = 0;
+        for(int k = 0; k < 4; k++) {
+            char c = text[i++];
+            *cp <<= 4;
+            if(c >= '0' && c <= '9')      *cp |= (uint32_t)(c - '0');
+            else if(c >= 'a' && c <= 'f') *cp |= (uint32_t)(c - 'a' + 10);
+            else if(c >= 'A' && c <= 'F') *cp |= (uint32_t)(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    };
+
+    while(i < text.size()) {
+        char c = text[i++];
+        if(c == '"') return true;
+        if(c != '\\') {
+            *str += c;
+            continue;
+        }
+        if(i >= text.size()) return false;
+        switch(text[i++]) {
+            case '"':  *str += '"';  break;
+            case '\\': *str += '\\'; break;
+            case '/':  *str += '/';  break;
+            case 'b':  *str += '\b'; break;
+            case 'f':  *str += '\f'; break;
+            case 'n':  *str += '\n'; break;
+            case 'r':  *str += '\r'; break;
+            case 't':  *str += '\t'; break;
+            case 'u': {
+                uint32_t cp;
+                if(!ParseHex4(&cp)) return false;
+                if(cp >= 0xd800 && cp < 0xdc00 && i + 1 < text.size() &&
+                   text[i] == '\\' && text[i + 1] == 'u') {
+                    i += 2;
+                    uint32_t low;
+                    if(!ParseHex4(&low)) return false;
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                }
+                AppendUtf8(cp);
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+static bool ParseJsonObject(const std::string &text, JsonObject *object) {
+    size_t i = 0;
+    auto SkipSpace = [&]() {
+        while(i < text.size() && isspace((unsigned char)text[i])) i++;
+    };
+    auto Expect = [&](char c) {
+        SkipSpace();
+        if(i < text.size() && text[i] == c) {
+            i++;
+            return true;
+        } else return false;
+    };
+
+    if(!Expect('{')) return false;
+    if(Expect('}')) {
+        SkipSpace();
+        return i == text.size();
+    }
+    do {
+        std::string key;
+        SkipSpace();
+        if(!ParseJsonString(text, &i, &key)) return false;
+        if(!Expect(':')) return false;
+        SkipSpace();
+
+        JsonValue value = {};
+        if(i < text.size() && text[i] == '"') {
+            value.type = JsonValue::Type::STRING;
+            if(!ParseJsonString(text, &i, &value.string)) return false;
+        } else if(text.compare(i, 4, "true") == 0) {
+            value.type    = JsonValue::Type::BOOLEAN;
+            value.boolean = true;
+            i += 4;
+        } else if(text.compare(i, 5, "false") == 0) {
+            value.type    = JsonValue::Type::BOOLEAN;
+            value.boolean = false;
+            i += 5;
+        } else if(text.compare(i, 4, "null") == 0) {
+            value.type = JsonValue::Type::NUL;
+            i += 4;
+        } else {
+            const char *start = text.c_str() + i;
+            char *end;
+            value.type   = JsonValue::Type::NUMBER;
+            value.number = strtod(start, &end);
+            if(end == start) return false;
+            i += (size_t)(end - start);
+        }
+        (*object)[key] = value;
+    } while(Expect(','));
+
+    if(!Expect('}')) return false;
+    SkipSpace();
+    return i == text.size();
+}
+
+static std::string JsonQuote(const std::string &str) {
+    std::string result = "\"";
+    for(char c : str) {
+        switch(c) {
+            case '"':  result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n";  break;
+            case '\r': result += "\\r";  break;
+            case '\t': result += "\\t";  break;
+            default:
+                if((unsigned char)c < 0x20) {
+                    result += ssprintf("\\u%04x", (unsigned char)c);
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result + "\"";
+}
+
+static bool ParseViewName(const std::string &name, Vector *projRight, Vector *projUp) {
+    if(name == "top") {
+        *projRight = Vector::From(1, 0, 0);
+        *projUp    = Vector::From(0, 1, 0);
+    } else if(name == "bottom") {
+        *projRight = Vector::From(-1, 0, 0);
+        *projUp    = Vector::From(0, 1, 0);
+    } else if(name == "left") {
+        *projRight = Vector::From(0, 1, 0);
+        *projUp    = Vector::From(0, 0, 1);
+    } else if(name == "right") {
+        *projRight = Vector::From(0, -1, 0);
+        *projUp    = Vector::From(0, 0, 1);
+    } else if(name == "front") {
+        *projRight = Vector::From(-1, 0, 0);
+        *projUp    = Vector::From(0, 0, 1);
+    } else if(name == "back") {
+        *projRight = Vector::From(1, 0, 0);
+        *projUp    = Vector::From(0, 0, 1);
+    } else if(name == "isometric") {
+        *projRight = Vector::From(0.707,  0.000, -0.707);
+        *projUp    = Vector::From(-0.408, 0.816, -0.408);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Serve requests from stdin until it's closed, keeping the sketch loaded and
+// solved in between; see ShowUsage() for the protocol. Anything that would be
+// shown to the user in a message box is reported as an error instead.
+//-----------------------------------------------------------------------------
+static bool RunDaemon() {
+    std::vector<std::string> messages;
+    messageLog = &messages;
+    bool loaded = false;
+
+    std::string line;
+    int c;
+    while(true) {
+        line.clear();
+        while((c = getchar()) != EOF && c != '\n') line += (char)c;
+        if(c == EOF && line.empty()) break;
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.find_first_not_of(" \t") == std::string::npos) continue;
+
+        messages.clear();
+        std::string error, extra;
+        bool quit = false;
+
+        JsonObject request;
+        auto GetString = [&](const char *key, std::string *str) {
+            auto it = request.find(key);
+            if(it == request.end() || it->second.type != JsonValue::Type::STRING) {
+                error = ssprintf("A string \"%s\" must be specified.", key);
+                return false;
+            }
+            *str = it->second.string;
+            return true;
+        };
+        auto GetNumber = [&](const char *key, double *number) {
+            auto it = request.find(key);
+            if(it == request.end() || it->second.type != JsonValue::Type::NUMBER) {
+                error = ssprintf("A number \"%s\" must be specified.", key);
+                return false;
+            }
+            *number = it->second.number;
+            return true;
+        };
+        auto GetHandle = [&](const char *key, char prefix, uint32_t *v) {
+            auto it = request.find(key);
+            if(it != request.end() && it->second.type == JsonValue::Type::NUMBER) {
+                *v = (uint32_t)it->second.number;
+                return true;
+            } else if(it != request.end() && it->second.type == JsonValue::Type::STRING) {
+                const char *start = it->second.string.c_str();
+                if(*start == prefix) start++;
+                char *end;
+                *v = (uint32_t)strtoul(start, &end, 16);
+                if(*start != '\0' && *end == '\0') return true;
+            }
+            error = ssprintf("A handle \"%s\" must be specified.", key);
+            return false;
+        };
+        auto SetChordTolerance = [&]() {
+            SS.exportChordTol = 1.0;
+            if(request.count("chord-tol")) {
+                return GetNumber("chord-tol", &SS.exportChordTol);
+            }
+            return true;
+        };
+        auto Regenerate = [&]() {
+            SS.GenerateEditForExport();
+            extra += ssprintf(", \"solved\": %s", SS.ActiveGroupsOkay() ? "true" : "false");
+        };
+
+        std::string command, output;
+        if(!ParseJsonObject(line, &request)) {
+            error = "Malformed request.";
+        } else if(!GetString("command", &command)) {
+            // Error already reported.
+        } else if(command == "quit") {
+            quit = true;
+        } else if(command == "load") {
+            std::string file;
+            if(GetString("file", &file)) {
+                if(loaded) {
+                    SK.Clear();
+                    SS.Clear();
+                    loaded = false;
+                }
+                Platform::Path path = Platform::Path::From(file)
+                                        .Expand(/*fromCurrentDirectory=*/true);
+                SS.Init();
+                if(SS.LoadFromFile(path)) {
+                    SS.AfterNewFile();
+                    loaded = true;
+                } else {
+                    SK.Clear();
+                    SS.Clear();
+                    error = ssprintf("Cannot load '%s'.", file.c_str());
+                }
+            }
+        } else if(!loaded) {
+            error = "No sketch is loaded.";
+        } else if(command == "set-constraint") {
+            uint32_t v;
+            double value;
+            if(GetHandle("constraint", 'c', &v) && GetNumber("value", &value)) {
+                Constraint *c = SK.constraint.FindByIdNoOops(hConstraint { v });
+                if(!c || !c->HasLabel() || c->type == Constraint::Type::COMMENT) {
+                    error = ssprintf("No dimension c%03x.", v);
+                } else if(c->reference) {
+                    error = ssprintf("Dimension c%03x is a reference.", v);
+                } else {
+                    c->ModifyValueTo(value);
+                    SS.MarkGroupDirty(c->group);
+                    Regenerate();
+                }
+            }
+        } else if(command == "set-param") {
+            uint32_t v;
+            double value;
+            if(GetHandle("param", 'p', &v) && GetNumber("value", &value)) {
+                hParam hp = { v };
+                Param *p = SK.param.FindByIdNoOops(hp);
+                Request *r = SK.request.FindByIdNoOops(hp.request());
+                if(!p || !r) {
+                    error = ssprintf("No parameter %08x of a request.", v);
+                } else {
+                    p->val = value;
+                    SS.MarkGroupDirty(r->group);
+                    Regenerate();
+                }
+            }
+        } else if(command == "export-view") {
+            std::string view;
+            if(GetString("output", &output) && GetString("view", &view) &&
+               SetChordTolerance()) {
+                if(ParseViewName(view, &SS.GW.projRight, &SS.GW.projUp)) {
+                    SS.ExportViewOrWireframeTo(Platform::Path::From(output),
+                                               /*exportWireframe=*/false);
+                } else {
+                    error = ssprintf("Unrecognized view direction '%s'.", view.c_str());
+                }
+            }
+        } else if(command == "export-wireframe") {
+            if(GetString("output", &output) && SetChordTolerance()) {
+                SS.ExportViewOrWireframeTo(Platform::Path::From(output),
+                                           /*exportWireframe=*/true);
+            }
+        } else if(command == "export-mesh") {
+            if(GetString("output", &output) && SetChordTolerance()) {
+                SS.ExportMeshTo(Platform::Path::From(output));
+            }
+        } else if(command == "export-surfaces") {
+            if(GetString("output", &output)) {
+                StepFileWriter sfw = {};
+                sfw.ExportSurfacesTo(Platform::Path::From(output));
+            }
+        } else if(command == "save") {
+            if(GetString("output", &output)) {
+                if(!SS.SaveToFile(Platform::Path::From(output))) {
+                    error = ssprintf("Cannot save '%s'.", output.c_str());
+                }
+            }
+        } else {
+            error = ssprintf("Unrecognized command '%s'.", command.c_str());
+        }
+
+        if(error.empty() && !messages.empty()) {
+            error = messages.front();
+        }
+
+        std::string response = "{";
+        auto id = request.find("id");
+        if(id != request.end()) {
+            switch(id->second.type) {
+                case JsonValue::Type::STRING:
+                    response += "\"id\": " + JsonQuote(id->second.string) + ", ";
+                    break;
+                case JsonValue::Type::NUMBER:
+                    response += ssprintf("\"id\": %.17g, ", id->second.number);
+                    break;
+                default:
+                    break;
+            }
+        }
+        if(error.empty()) {
+            response += "\"ok\": true" + extra;
+        } else {
+            response += "\"ok\": false, \"error\": " + JsonQuote(error) + extra;
+        }
+        response += "}\n";
+        fputs(response.c_str(), stdout);
+        fflush(stdout);
+
+        if(quit) break;
+    }
+
+    if(loaded) {
+        SK.Clear();
+        SS.Clear();
+    }
+    messageLog = NULL;
+    return true;
+}
+
+static bool RunCommand(std::vector<std::string> args) {
     if(args.size() < 2) return false;
 
     for(const std::string &arg : args) {
@@ -93,7 +1014,53 @@ static bool RunCommand(const std::vector<std::string> args) {
         }
     }
 
-    std::function<void(const Platform::Path &)> runner;
+    // Recording a trace applies to every command, so take it out here.
+    for(size_t argn = 2; argn + 1 < args.size(); argn++) {
+        if(args[argn] != "--trace") continue;
+        TraceScope::Start(Platform::Path::From(args[argn + 1])
+                            .Expand(/*fromCurrentDirectory=*/true));
+        args.erase(args.begin() + argn, args.begin() + argn + 2);
+        argn--;
+    }
+
+    if(args[1] == "daemon") {
+        if(args.size() > 2) {
+            fprintf(stderr, "Unrecognized option '%s'.\n", args[2].c_str());
+            return false;
+        }
+        return RunDaemon();
+    }
+
+    // The number of jobs applies to every command as well. It's read as a
+    // signed number, so that "-1" is rejected rather than read as UINT_MAX.
+    unsigned jobs = 1;
+    for(size_t argn = 2; argn < args.size(); argn++) {
+        if(args[argn] != "--jobs" && args[argn] != "-j") continue;
+        int count;
+        char trailing;
+        if(argn + 1 >= args.size() ||
+           sscanf(args[argn + 1].c_str(), "%d%c", &count, &trailing) != 1 ||
+           count <= 0) {
+            fprintf(stderr, "A positive number of jobs must be specified.\n");
+            return false;
+        }
+        if(count > MAX_JOBS) {
+            fprintf(stderr, "At most %d jobs can be run at once.\n", MAX_JOBS);
+            return false;
+        }
+        jobs = (unsigned)count;
+        args.erase(args.begin() + argn, args.begin() + argn + 2);
+        argn--;
+    }
+
+    std::function<bool(const Platform::Path &)> runner;
+
+    // The work item being processed, for commands that need more than the
+    // output file, and the output file as given rather than absolute.
+    const WorkItem *currentItem = NULL;
+    Platform::Path currentOutput;
+    SweepTable sweep = {};
+    size_t sweepRows = 0;
 
     std::vector<Platform::Path> inputFiles;
     auto ParseInputFile = [&](size_t &argn) {
@@ -119,28 +1086,7 @@ static bool RunCommand(const std::vector<std::string> args) {
         if(argn + 1 < args.size() && (args[argn] == "--view" ||
                                       args[argn] == "-v")) {
             argn++;
-            if(args[argn] == "top") {
-                projRight = Vector::From(1, 0, 0);
-                projUp    = Vector::From(0, 1, 0);
-            } else if(args[argn] == "bottom") {
-                projRight = Vector::From(-1, 0, 0);
-                projUp    = Vector::From(0, 1, 0);
-            } else if(args[argn] == "left") {
-                projRight = Vector::From(0, 1, 0);
-                projUp    = Vector::From(0, 0, 1);
-            } else if(args[argn] == "right") {
-                projRight = Vector::From(0, -1, 0);
-                projUp    = Vector::From(0, 0, 1);
-            } else if(args[argn] == "front") {
-                projRight = Vector::From(-1, 0, 0);
-                projUp    = Vector::From(0, 0, 1);
-            } else if(args[argn] == "back") {
-                projRight = Vector::From(1, 0, 0);
-                projUp    = Vector::From(0, 0, 1);
-            } else if(args[argn] == "isometric") {
-                projRight = Vector::From(0.707,  0.000, -0.707);
-                projUp    = Vector::From(-0.408, 0.816, -0.408);
-            } else {
+            if(!ParseViewName(args[argn], &projRight, &projUp)) {
                 fprintf(stderr, "Unrecognized view direction '%s'\n", args[argn].c_str());
             }
             return true;
@@ -201,6 +1147,7 @@ static bool RunCommand(const std::vector<std::string> args) {
             SS.GenerateAll();
             PaintGraphics();
             framebuffer->WritePng(output, /*flip=*/true);
+            return true;
         };
     } else if(args[1] == "export-view") {
         for(size_t argn = 2; argn < args.size(); argn++) {
@@ -224,6 +1171,47 @@ static bool RunCommand(const std::vector<std::string> args) {
             SS.exportChordTol = chordTol;
 
             SS.ExportViewOrWireframeTo(output, /*exportWireframe=*/false);
+            return true;
+        };
+    } else if(args[1] == "export-slices") {
+        double step = 0.0;
+        auto ParseStep = [&](size_t &argn) {
+            if(argn + 1 < args.size() && args[argn] == "--step") {
+                argn++;
+                if(sscanf(args[argn].c_str(), "%lf", &step) == 1) {
+                    return true;
+                } else return false;
+            } else return false;
+        };
+
+        for(size_t argn = 2; argn < args.size(); argn++) {
+            if(!(ParseInputFile(argn) ||
+                 ParseOutputPattern(argn) ||
+                 ParseViewDirection(argn) ||
+                 ParseChordTolerance(argn) ||
+                 ParseStep(argn))) {
+                fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
+                return false;
+            }
+        }
+
+        if(EXACT(projUp.Magnitude() == 0 || projRight.Magnitude() == 0)) {
+            fprintf(stderr, "View direction must be specified.\n");
+            return false;
+        }
+
+        if(step <= 0) {
+            fprintf(stderr, "A positive slice step must be specified.\n");
+            return false;
+        }
+
+        runner = [=](const Platform::Path &output) {
+            SS.GW.projRight   = projRight;
+            SS.GW.projUp      = projUp;
+            SS.exportChordTol = chordTol;
+
+            SS.ExportSlicesTo(output, step);
+            return true;
         };
     } else if(args[1] == "export-wireframe") {
         for(size_t argn = 2; argn < args.size(); argn++) {
@@ -239,6 +1227,7 @@ static bool RunCommand(const std::vector<std::string> args) {
             SS.exportChordTol = chordTol;
 
             SS.ExportViewOrWireframeTo(output, /*exportWireframe=*/true);
+            return true;
         };
     } else if(args[1] == "export-mesh") {
         for(size_t argn = 2; argn < args.size(); argn++) {
@@ -254,6 +1243,7 @@ static bool RunCommand(const std::vector<std::string> args) {
             SS.exportChordTol = chordTol;
 
             SS.ExportMeshTo(output);
+            return true;
         };
     } else if(args[1] == "export-surfaces") {
         for(size_t argn = 2; argn < args.size(); argn++) {
@@ -267,6 +1257,70 @@ static bool RunCommand(const std::vector<std::string> args) {
         runner = [&](const Platform::Path &output) {
             StepFileWriter sfw = {};
             sfw.ExportSurfacesTo(output);
+            return true;
+        };
+    } else if(args[1] == "sweep") {
+        std::string tableFile;
+        auto ParseTable = [&](size_t &argn) {
+            if(argn + 1 < args.size() && args[argn] == "--table") {
+                argn++;
+                tableFile = args[argn];
+                return true;
+            } else return false;
+        };
+
+        for(size_t argn = 2; argn < args.size(); argn++) {
+            if(!(ParseInputFile(argn) ||
+                 ParseOutputPattern(argn) ||
+                 ParseViewDirection(argn) ||
+                 ParseChordTolerance(argn) ||
+                 ParseTable(argn))) {
+                fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
+                return false;
+            }
+        }
+
+        if(tableFile.empty()) {
+            fprintf(stderr, "A table of variants must be specified.\n");
+            return false;
+        }
+        if(!ReadSweepTable(Platform::Path::From(tableFile), &sweep)) {
+            return false;
+        }
+        sweepRows = sweep.values.size();
+        if(sweepRows == 0) {
+            fprintf(stderr, "The table of variants is empty.\n");
+            return false;
+        }
+        if(sweepRows > 1 && outputPattern.find('#') == std::string::npos) {
+            fprintf(stderr, "Output pattern must include a # symbol for a sweep.\n");
+            return false;
+        }
+
+        Platform::Path outputPath = Platform::Path::From(outputPattern);
+        if(MatchesFileFilter(outputPath, MeshFileFilter)) {
+            sweep.exportAs = SweepTable::ExportAs::MESH;
+        } else if(MatchesFileFilter(outputPath, SurfaceFileFilter)) {
+            sweep.exportAs = SweepTable::ExportAs::SURFACES;
+        } else if(MatchesFileFilter(outputPath, VectorFileFilter)) {
+            sweep.exportAs = SweepTable::ExportAs::VIEW;
+            if(EXACT(projUp.Magnitude() == 0 || projRight.Magnitude() == 0)) {
+                fprintf(stderr, "View direction must be specified.\n");
+                return false;
+            }
+        } else if(outputPath.HasExtension("slvs")) {
+            sweep.exportAs = SweepTable::ExportAs::SKETCH;
+        } else {
+            fprintf(stderr, "Unrecognized output format '%s'.\n", outputPattern.c_str());
+            return false;
+        }
+
+        runner = [&](const Platform::Path &output) {
+            SS.GW.projRight   = projRight;
+            SS.GW.projUp      = projUp;
+            SS.exportChordTol = chordTol;
+
+            return RunSweep(sweep, *currentItem, output, currentOutput);
         };
     } else if(args[1] == "regenerate") {
         for(size_t argn = 2; argn < args.size(); argn++) {
@@ -280,6 +1334,7 @@ static bool RunCommand(const std::vector<std::string> args) {
 
         runner = [&](const Platform::Path &output) {
             SS.SaveToFile(output);
+            return true;
         };
     } else {
         fprintf(stderr, "Unrecognized command '%s'.\n", args[1].c_str());
@@ -300,7 +1355,28 @@ static bool RunCommand(const std::vector<std::string> args) {
         return false;
     }
 
+    // Files processed in a row often link the same parts, so keep those
+    // loaded. The cache is never invalidated, by modification time or
+    // otherwise: it is only valid for this one run, during which we assume
+    // that nothing changes on disk.
+    SS.cacheLinkedFiles = true;
+
+    // A sweep is split into ranges of variants, so that it can use several
+    // workers even for a single input file; each range starts from a fresh
+    // load, and then warm-starts every variant from the previous one.
+    std::vector<WorkItem> items;
     for(const Platform::Path &inputFile : inputFiles) {
+        size_t ranges = 1;
+        if(sweepRows > 0 && jobs > 1) ranges = std::min((size_t)jobs, sweepRows);
+        for(size_t i = 0; i < ranges; i++) {
+            size_t first = sweepRows * i / ranges,
+                   last  = sweepRows * (i + 1) / ranges;
+            items.push_back({ inputFile, first, last - first });
+        }
+    }
+
+    auto ProcessItem = [&](const WorkItem &item) {
+        const Platform::Path &inputFile = item.inputFile;
         Platform::Path absInputFile = inputFile.Expand(/*fromCurrentDirectory=*/true);
 
         Platform::Path outputFile = Platform::Path::From(outputPattern);
@@ -318,11 +1394,31 @@ static bool RunCommand(const std::vector<std::string> args) {
             return false;
         }
         SS.AfterNewFile();
-        runner(absOutputFile);
+        currentItem   = &item;
+        currentOutput = outputFile;
+        bool success = runner(absOutputFile);
         SK.Clear();
         SS.Clear();
 
-        fprintf(stderr, "Written '%s'.\n", outputFile.raw.c_str());
+        if(success && sweepRows == 0) {
+            fprintf(stderr, "Written '%s'.\n", outputFile.raw.c_str());
+        }
+        return success;
+    };
+
+    if(jobs > 1 && items.size() > 1) {
+#if !defined(WIN32)
+        // Each worker is a fork of us, so it starts with our copy of the cache
+        // and shares it copy-on-write, but anything it loads itself stays in
+        // that worker. So load every linked part once here, before forking,
+        // rather than once in every worker that needs it.
+        WarmLinkedFileCache(inputFiles);
+#endif
+        return RunInWorkers(items, jobs, ProcessItem);
+    }
+
+    for(const WorkItem &item : items) {
+        if(!ProcessItem(item)) return false;
     }
 
     return true;
@@ -330,6 +1426,7 @@ static bool RunCommand(const std::vector<std::string> args) {
 
 int main(int argc, char **argv) {
     std::vector<std::string> args = InitPlatform(argc, argv);
+    TraceScope::StartFromEnvironment();
 
     if(args.size() == 1) {
         ShowUsage(args[0]);
@@ -1383,6 +1383,7 @@ int main(int argc, const char *argv[]) {
     }
 
     connexionInit();
+    SolveSpace::TraceScope::StartFromEnvironment();
     SolveSpace::SS.Init();
 
     [GW makeKeyAndOrderFront:nil];
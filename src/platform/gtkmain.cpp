@@ -1460,6 +1460,7 @@ int main(int argc, char** argv) {
     }
 #endif
 
+    TraceScope::StartFromEnvironment();
     SS.Init();
 
     if(argc >= 2) {
@@ -4,6 +4,7 @@
 // Copyright 2016 whitequark
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
+#include "platform/headless.h"
 #include <cairo.h>
 
 namespace SolveSpace {
@@ -224,12 +225,25 @@ DialogChoice SaveFileYesNoCancel() {
 DialogChoice LoadAutosaveYesNo() {
     ssassert(false, "Not implemented");
 }
+// When set, messages that would be shown to the user are collected here
+// instead of being treated as a bug; the command-line daemon reports them
+// to its client.
+std::vector<std::string> *messageLog;
+
 DialogChoice LocateImportedFileYesNoCancel(const Platform::Path &filename,
                                            bool canCancel) {
+    if(messageLog) {
+        messageLog->push_back("Cannot find linked file '" + filename.raw + "'.");
+        return canCancel ? DIALOG_CANCEL : DIALOG_NO;
+    }
     ssassert(false, "Not implemented");
 }
 void DoMessageBox(const char *message, int rows, int cols, bool error) {
     dbp("%s box: %s", error ? "error" : "message", message);
+    if(messageLog) {
+        messageLog->push_back(message);
+        return;
+    }
     ssassert(false, "Not implemented");
 }
 void OpenWebsite(const char *url) {
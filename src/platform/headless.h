@@ -0,0 +1,24 @@
+//-----------------------------------------------------------------------------
+// The parts of the headless platform that the programs built on it (the
+// command-line interface, the test suite and the benchmarks) use directly.
+//-----------------------------------------------------------------------------
+
+#ifndef SOLVESPACE_HEADLESS_H
+#define SOLVESPACE_HEADLESS_H
+
+namespace SolveSpace {
+
+// The fonts that the platform offers, instead of the system ones.
+extern std::vector<Platform::Path> fontFiles;
+
+// Whether to antialias, and where the result of the last paint goes.
+extern bool antialias;
+extern std::shared_ptr<Pixmap> framebuffer;
+
+// When set, messages that would be shown to the user are collected here
+// instead of being treated as a bug.
+extern std::vector<std::string> *messageLog;
+
+}
+
+#endif
@@ -415,6 +415,20 @@ void RemoveFile(const Platform::Path &filename) {
 #endif
 }
 
+// Replaces `to` with `from` atomically, as far as the OS allows; a reader
+// of `to` sees either the old file or the new one, never a partial write.
+bool RenameFile(const Platform::Path &from, const Platform::Path &to) {
+    ssassert(from.raw.length() == strlen(from.raw.c_str()) &&
+             to.raw.length() == strlen(to.raw.c_str()),
+             "Unexpected null byte in middle of a path");
+#if defined(WIN32)
+    return MoveFileExW(Widen(from.Expand().raw).c_str(), Widen(to.Expand().raw).c_str(),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.raw.c_str(), to.raw.c_str()) == 0;
+#endif
+}
+
 bool ReadFile(const Platform::Path &filename, std::string *data) {
     FILE *f = OpenFile(filename, "rb");
     if(f == NULL) return false;
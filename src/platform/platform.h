@@ -59,6 +59,7 @@ FILE *OpenFile(const Platform::Path &filename, const char *mode);
 bool ReadFile(const Platform::Path &filename, std::string *data);
 bool WriteFile(const Platform::Path &filename, const std::string &data);
 void RemoveFile(const Platform::Path &filename);
+bool RenameFile(const Platform::Path &from, const Platform::Path &to);
 
 // Resource loading function.
 const void *LoadResource(const std::string &name, size_t *size);
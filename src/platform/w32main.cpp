@@ -1634,6 +1634,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     }
 
     // Call in to the platform-independent code, and let them do their init
+    TraceScope::StartFromEnvironment();
     SS.Init();
 
     // A filename may have been specified on the command line; if so, then
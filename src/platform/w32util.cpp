@@ -71,12 +71,12 @@ void FreeAllTemporary()
 }
 
 void *MemAlloc(size_t n) {
-    void *p = HeapAlloc(PermHeap, HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY, n);
+    void *p = HeapAlloc(PermHeap, HEAP_ZERO_MEMORY, n);
     ssassert(p != NULL, "Cannot allocate memory");
     return p;
 }
 void MemFree(void *p) {
-    HeapFree(PermHeap, HEAP_NO_SERIALIZE, p);
+    HeapFree(PermHeap, 0, p);
 }
 
 void vl() {
@@ -86,7 +86,9 @@ void vl() {
 
 std::vector<std::string> InitPlatform(int argc, char **argv) {
     // Create the heap used for long-lived stuff (that gets freed piecewise).
-    PermHeap = HeapCreate(HEAP_NO_SERIALIZE, 1024*1024*20, 0);
+    // The permanent heap is also used from worker threads (when exporting,
+    // or saving in the background), so it must be serialized.
+    PermHeap = HeapCreate(0, 1024*1024*20, 0);
     // Create the heap that we use to store Exprs and other temp stuff.
     FreeAllTemporary();
 
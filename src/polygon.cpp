@@ -326,11 +326,26 @@ bool SEdgeList::ContainsEdge(const SEdge *set) const {
 //-----------------------------------------------------------------------------
 void SEdgeList::CullExtraneousEdges() {
     l.ClearTags();
+
+    // Two edges can only match if the lesser x coordinates of their endpoints
+    // are within epsilon, so sort on that and compare only within the window.
+    std::vector<double> key(l.n);
+    std::vector<int>    order(l.n);
     int i, j;
     for(i = 0; i < l.n; i++) {
-        SEdge *se = &(l.elem[i]);
-        for(j = i+1; j < l.n; j++) {
-            SEdge *set = &(l.elem[j]);
+        key[i]   = min(l.elem[i].a.x, l.elem[i].b.x);
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        return key[a] < key[b];
+    });
+
+    for(i = 0; i < l.n; i++) {
+        for(j = i+1; j < l.n && key[order[j]] - key[order[i]] <= LENGTH_EPS; j++) {
+            // Keep the comparison in list order, so that we cull the same
+            // edges as a pairwise comparison would.
+            SEdge *se  = &(l.elem[min(order[i], order[j])]);
+            SEdge *set = &(l.elem[max(order[i], order[j])]);
             if((set->a).Equals(se->a) && (set->b).Equals(se->b)) {
                 // Two parallel edges exist; so keep only the first one.
                 set->tag = 1;
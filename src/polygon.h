@@ -14,6 +14,8 @@ class SContour;
 class SMesh;
 class SBsp3;
 class SOutlineList;
+class SShell;
+class SBvh;
 
 enum class EarType : uint32_t {
     UNKNOWN = 0,
@@ -274,7 +276,10 @@ public:
                                   Quaternion q, double scale);
     void MakeFromAssemblyOf(SMesh *a, SMesh *b);
 
-    void MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d);
+    void MakeEdgesInPlaneInto(SEdgeList *sel, Vector n, double d,
+                              const SBvh *bvh = NULL);
+    void MakeSectionInto(SEdgeList *sel, Vector n, double d,
+                         const SBvh *bvh = NULL);
     void MakeOutlinesInto(SOutlineList *sol, EdgeKind type);
 
     void PrecomputeTransparency();
@@ -357,6 +362,63 @@ public:
     void SnapToVertex(Vector v, SMesh *extras);
 };
 
+class SDepthBuffer {
+public:
+    // The buffer needs 8 bytes per pixel, so this keeps it to about 128 MiB.
+    static const int MAX_RESOLUTION = 4096;
+    // The side of a tile, in pixels; each tile lists every triangle that may
+    // cover any part of it.
+    static const int TILE_SIZE = 8;
+
+    struct Occluder {
+        Vector  tn;
+        double  td;
+        Point2d n[3];
+        double  d[3];
+        double  xmin, xmax, ymin, ymax;
+        Point2d centroid;
+    };
+
+    std::vector<Occluder> occluders;
+    std::vector<float>    depth;
+    std::vector<int>      index;
+    std::vector<int>      tileStart;
+    std::vector<int>      tileItems;
+    int                   width, height;
+    int                   tilesX, tilesY;
+    double                pixel;
+    Point2d               origin;
+
+    static SDepthBuffer From(const SMesh *m, int resolution);
+
+    Point2d PixelCenter(int i, int j) const;
+    static bool HidesPoint(const Occluder &oc, Vector p);
+    bool IsOccluded(Vector p) const;
+    void OcclusionTestLine(SEdge orig, SEdgeList *sel) const;
+};
+
+// A bounding volume hierarchy over the triangles of a mesh, or the surfaces of
+// a shell, so that we can find the few that meet a plane without testing all.
+class SBvh {
+public:
+    struct Node {
+        BBox    box;
+        int     left, right;    // children, or -1 for a leaf
+        int     first, count;   // range in items, for a leaf
+    };
+
+    std::vector<Node>   nodes;
+    std::vector<int>    items;
+
+    static SBvh From(const std::vector<BBox> &boxes);
+    static SBvh From(const SMesh *m);
+    static SBvh From(const SShell *s);
+
+    bool IsEmpty() const;
+    void ItemsMeetingPlane(Vector n, double d, double tol,
+                           std::vector<int> *found) const;
+};
+
 class PolylineBuilder {
 public:
     struct Edge;
@@ -271,6 +271,67 @@ std::shared_ptr<Pixmap> Pixmap::ReadPng(const Platform::Path &filename, bool fli
     return pixmap;
 }
 
+// Read a PNG a band of rows at a time, for images too large to hold in memory
+// at once. Each band is passed to fn, with the row of the image it starts at.
+// Interlaced images can only be decoded whole, so they come as one band.
+bool Pixmap::ReadPngBands(const Platform::Path &filename, size_t bandHeight,
+                          const std::function<void(const Pixmap &band, size_t y)> &fn) {
+    png_struct *png_ptr = NULL;
+    png_info *info_ptr = NULL;
+    Pixmap band = {};
+    size_t height = 0;
+    int passes = 1;
+    bool ok = false;
+
+    FILE *f = OpenFile(filename, "rb");
+    if(!f) return false;
+
+    uint8_t header[8];
+    if(fread(header, 1, sizeof(header), f) != sizeof(header)) goto exit;
+    if(png_sig_cmp(header, 0, sizeof(header))) goto exit;
+
+    png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr) goto exit;
+    info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr) goto exit;
+
+    if(setjmp(png_jmpbuf(png_ptr))) goto exit;
+
+    png_init_io(png_ptr, f);
+    png_set_sig_bytes(png_ptr, sizeof(header));
+    png_read_info(png_ptr, info_ptr);
+    png_set_expand(png_ptr);
+    png_set_strip_16(png_ptr);
+    png_set_gray_to_rgb(png_ptr);
+    passes = png_set_interlace_handling(png_ptr);
+    png_read_update_info(png_ptr, info_ptr);
+
+    band.width  = png_get_image_width(png_ptr, info_ptr);
+    height      = png_get_image_height(png_ptr, info_ptr);
+    band.format = (png_get_channels(png_ptr, info_ptr) == 4) ? Format::RGBA : Format::RGB;
+    band.stride = band.width * band.GetBytesPerPixel();
+    if(band.stride % 4 != 0) band.stride += 4 - band.stride % 4;
+    if(passes > 1 || bandHeight == 0) bandHeight = height;
+    band.data.resize(band.stride * std::min(bandHeight, height));
+
+    for(size_t y = 0; y < height; y += band.height) {
+        band.height = std::min(bandHeight, height - y);
+        for(int pass = 0; pass < passes; pass++) {
+            for(size_t row = 0; row < band.height; row++) {
+                png_read_row(png_ptr, &band.data[band.stride * row], NULL);
+            }
+        }
+        fn(band, y);
+    }
+    png_read_end(png_ptr, NULL);
+    ok = true;
+
+exit:
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(f);
+    return ok;
+}
+
 bool Pixmap::WritePng(FILE *f, bool flip) {
     int colorType = 0;
     bool bgr = false;
@@ -31,6 +31,8 @@ public:
 
     static std::shared_ptr<Pixmap> ReadPng(FILE *f, bool flip = false);
     static std::shared_ptr<Pixmap> ReadPng(const Platform::Path &filename, bool flip = false);
+    static bool ReadPngBands(const Platform::Path &filename, size_t bandHeight,
+                             const std::function<void(const Pixmap &band, size_t y)> &fn);
     bool WritePng(FILE *f, bool flip = false);
     bool WritePng(const Platform::Path &filename, bool flip = false);
 
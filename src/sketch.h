@@ -281,6 +281,8 @@ public:
     template<class T> void GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat);
     template<class T> void GenerateForBoolean(T *a, T *b, T *o, Group::CombineAs how);
     void GenerateDisplayItems();
+    Group *DisplayMeshGroup();
+    void ForEachDisplayTriangle(const std::function<void(const STriangle &)> &fn);
 
     enum class DrawMeshAs { DEFAULT, HOVERED, SELECTED };
     void DrawMesh(DrawMeshAs how, Canvas *canvas);
@@ -292,6 +294,7 @@ public:
     SPolygon GetPolygon();
 
     static void MenuGroup(Command id);
+    static hGroup AddWorkplaneGroup(const std::string &name);
 };
 
 // A user request for some primitive or derived operation; for example a
@@ -724,6 +727,7 @@ public:
                             hEntity he, Vector *refp);
 
     std::string DescriptionString() const;
+    void ModifyValueTo(double v);
 
     static hConstraint AddConstraint(Constraint *c, bool rememberForUndo);
     static hConstraint AddConstraint(Constraint *c);
@@ -64,6 +64,9 @@ void SolveSpaceUI::Init() {
     exportScale = CnfThawFloat(1.0f, "ExportScale");
     // Export offset (cutter radius comp)
     exportOffset = CnfThawFloat(0.0f, "ExportOffset");
+    // Hidden line removal depth buffer size (0 for exact)
+    exportHlrResolution = min((int)CnfThawInt(0, "ExportHlrResolution"),
+                              SDepthBuffer::MAX_RESOLUTION);
     // Rewrite exported colors close to white into black (assuming white bg)
     fixExportColors = CnfThawBool(true, "FixExportColors");
     // Draw back faces of triangles (when mesh is leaky/self-intersecting)
@@ -137,6 +140,8 @@ bool SolveSpaceUI::LoadAutosaveFor(const Platform::Path &filename) {
 }
 
 bool SolveSpaceUI::Load(const Platform::Path &filename) {
+    FinishBackgroundSave(/*wait=*/true);
+
     bool autosaveLoaded = LoadAutosaveFor(filename);
     bool fileLoaded = autosaveLoaded || LoadFromFile(filename, /*canCancel=*/true);
     if(fileLoaded) {
@@ -189,6 +194,8 @@ void SolveSpaceUI::Exit() {
     CnfFreezeFloat(exportScale, "ExportScale");
     // Export offset (cutter radius comp)
     CnfFreezeFloat(exportOffset, "ExportOffset");
+    // Hidden line removal depth buffer size (0 for exact)
+    CnfFreezeInt((uint32_t)exportHlrResolution, "ExportHlrResolution");
     // Rewrite exported colors close to white into black (assuming white bg)
     CnfFreezeBool(fixExportColors, "FixExportColors");
     // Draw back faces of triangles (when mesh is leaky/self-intersecting)
@@ -228,6 +235,9 @@ void SolveSpaceUI::Exit() {
     // And the default styles, colors and line widths and such.
     Style::FreezeDefaultStyles();
 
+    // Don't leave a half-written file behind.
+    FinishBackgroundSave(/*wait=*/true);
+
     ExitNow();
 }
 
@@ -247,6 +257,8 @@ void SolveSpaceUI::DoLater() {
     if(later.generateAll) GenerateAll();
     if(later.showTW) TW.Show();
     later = {};
+
+    FinishBackgroundSave(/*wait=*/false);
 }
 
 double SolveSpaceUI::MmPerUnit() {
@@ -374,9 +386,10 @@ bool SolveSpaceUI::GetFilenameAndSave(bool saveAs) {
         if(!GetSaveFile(&newSaveFile, "", SlvsFileFilter)) return false;
     }
 
-    if(SaveToFile(newSaveFile)) {
+    // The autosave file is removed once the write actually succeeds,
+    // in FinishBackgroundSave.
+    if(SaveToFileInBackground(newSaveFile, /*isAutosave=*/false)) {
         AddToRecentList(newSaveFile);
-        RemoveAutosave();
         saveFile = newSaveFile;
         unsaved = false;
         return true;
@@ -389,14 +402,22 @@ bool SolveSpaceUI::Autosave()
 {
     SetAutosaveTimerFor(autosaveInterval);
 
+    // If the previous save is still being written, just wait for the next tick.
+    FinishBackgroundSave(/*wait=*/false);
+    if(backgroundSave.result.valid())
+        return false;
+
     if(!saveFile.IsEmpty() && unsaved)
-        return SaveToFile(saveFile.WithExtension(AUTOSAVE_EXT));
+        return SaveToFileInBackground(saveFile.WithExtension(AUTOSAVE_EXT),
+                                      /*isAutosave=*/true);
 
     return false;
 }
 
 void SolveSpaceUI::RemoveAutosave()
 {
+    FinishBackgroundSave(/*wait=*/true);
+
     Platform::Path autosaveFile = saveFile.WithExtension(AUTOSAVE_EXT);
     RemoveFile(autosaveFile);
 }
@@ -406,7 +427,10 @@ bool SolveSpaceUI::OkayToStartNewFile() {
 
     switch(SaveFileYesNoCancel()) {
         case DIALOG_YES:
-            return GetFilenameAndSave(/*saveAs=*/false);
+            // The current sketch is about to go away, so make sure that
+            // it actually made it to disk.
+            return GetFilenameAndSave(/*saveAs=*/false) &&
+                   FinishBackgroundSave(/*wait=*/true);
 
         case DIALOG_NO:
             RemoveAutosave();
@@ -843,6 +867,21 @@ void SolveSpaceUI::MenuHelp(Command id) {
             OpenWebsite("http://solvespace.com/helpmenu");
             break;
 
+        case Command::RECORD_TRACE: {
+            // Record a profile of everything from now on, until unchecked,
+            // to attach to a report about a slow model.
+            if(TraceScope::TraceIsActive()) {
+                TraceScope::Stop();
+            } else {
+                Platform::Path traceFile;
+                if(GetSaveFile(&traceFile, "", TraceFileFilter)) {
+                    TraceScope::Start(traceFile);
+                }
+            }
+            SS.GW.EnsureValidActives();
+            break;
+        }
+
         case Command::ABOUT:
             Message(
 "This is SolveSpace version " PACKAGE_VERSION ".\n"
@@ -870,6 +909,8 @@ void SolveSpaceUI::Clear() {
         if(i < undo.cnt) undo.d[i].Clear();
         if(i < redo.cnt) redo.d[i].Clear();
     }
+    undoCheckpoint.Clear();
+    undoTouched.clear();
 }
 
 void Sketch::Clear() {
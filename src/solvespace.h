@@ -32,7 +32,11 @@
 #include <unordered_set>
 #include <map>
 #include <set>
+#include <atomic>
 #include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
 #include <sstream>
 
 // We declare these in advance instead of simply using FT_Library
@@ -297,6 +301,39 @@ void MakeMatrix(double *mat, double a11, double a12, double a13, double a14,
                              double a31, double a32, double a33, double a34,
                              double a41, double a42, double a43, double a44);
 void MultMatrix(double *mata, double *matb, double *matr);
+void ParallelFor(size_t n, const std::function<void(size_t)> &fn);
+
+// Markers for profiling, written as Chrome trace events (for chrome://tracing
+// or Perfetto). They are always compiled in, but cost only a flag test unless
+// tracing was started, e.g. by setting SOLVESPACE_TRACE=trace.json.
+class TraceScope {
+public:
+    TraceScope(const char *name, uint32_t id = 0) : name(NULL) {
+        if(TraceIsActive()) Begin(name, id);
+    }
+    ~TraceScope() {
+        if(name) End();
+    }
+
+    static bool TraceIsActive() { return active.load(std::memory_order_relaxed); }
+    static void Start(const Platform::Path &filename);
+    static void StartFromEnvironment();
+    static void Stop();
+    static Platform::Path Filename();
+
+    static std::atomic<bool> active;
+
+private:
+    const char *name;
+    uint32_t    id;
+    int64_t     start;
+
+    void Begin(const char *name, uint32_t id);
+    void End();
+};
+#define TRACE_SCOPE_NAME2(line) traceScope##line
+#define TRACE_SCOPE_NAME(line) TRACE_SCOPE_NAME2(line)
+#define TRACE_SCOPE(...) TraceScope TRACE_SCOPE_NAME(__LINE__)(__VA_ARGS__)
 
 std::string MakeAcceleratorLabel(int accel);
 void Message(const char *str, ...);
@@ -365,6 +402,7 @@ public:
     bool SolveLeastSquares();
 
     bool WriteJacobian(int tag);
+    void WriteJacobian(Equation *e, Param *p);
     void EvalJacobian();
 
     void WriteEquationsExceptFor(hConstraint hc, Group *g);
@@ -394,12 +432,66 @@ public:
     void ExportSurfacesTo(const Platform::Path &filename);
     void WriteHeader();
 	void WriteProductHeader();
+    int ExportPoint(Vector p);
     int ExportCurve(SBezier *sb);
-    int ExportCurveLoop(SBezierLoop *loop, bool inner);
-    void ExportSurface(SSurface *ss, SBezierList *sbl);
     void WriteWireframe();
     void WriteFooter();
 
+    // A surface's part of the file is formatted on its own (possibly on a
+    // worker thread) before any ids are known. Its own entities are numbered
+    // from zero, as "#n"; the points, vertices and edges that it might share
+    // with other surfaces are listed in shared, and referred to as "#@n",
+    // with the sense of a shared edge as ".@n.". WriteSurface() then assigns
+    // the real ids.
+    struct SharedEntity {
+        enum class Type : uint8_t { POINT, VERTEX, EDGE };
+        Type        type;
+        int         ref[2];     // VERTEX: its point; EDGE: start, finish vertex
+        uint32_t    curve;      // EDGE: the SCurve it was trimmed from
+        Vector      p;          // POINT, VERTEX: position; EDGE: second control point
+        std::string text;       // POINT: coordinates; EDGE: its curve
+    };
+    struct SurfaceText {
+        std::vector<SharedEntity> shared;
+        std::string               text;
+        int                       entities;
+        std::vector<int>          faces;
+        std::unordered_map<Vector, int, VectorHash, VectorPred> pointIndex;
+        std::unordered_map<Vector, int, VectorHash, VectorPred> vertexIndex;
+
+        void Printf(const char *fmt, ...);
+        int Point(Vector p);
+        int Vertex(Vector p);
+        int Edge(SBezier *sb, int startVertex, int finishVertex);
+        int CurveLoop(SBezierLoop *loop, bool inner);
+        void Surface(SSurface *ss, SBezierList *sbl);
+    };
+    static void FormatSurface(SShell *shell, SSurface *ss, SurfaceText *st);
+    void WriteSurface(SurfaceText *st);
+
+    // Points, vertices and edges are shared between the faces that use them,
+    // so that each is written only once.
+    struct EdgeKey {
+        uint32_t curve;
+        int      vertexA, vertexB;
+
+        bool operator==(const EdgeKey &other) const {
+            return curve == other.curve &&
+                   vertexA == other.vertexA && vertexB == other.vertexB;
+        }
+    };
+    struct EdgeKeyHash {
+        size_t operator()(const EdgeKey &k) const;
+    };
+    struct SharedEdge {
+        int    id;
+        int    startVertex;
+        Vector secondCtrl;
+    };
+    std::unordered_map<Vector, int, VectorHash, VectorPred> points;
+    std::unordered_map<Vector, int, VectorHash, VectorPred> vertices;
+    std::unordered_map<EdgeKey, SharedEdge, EdgeKeyHash>     edges;
+
     List<int> curves;
     List<int> advancedFaces;
     FILE *f;
@@ -600,7 +692,9 @@ public:
     TextWindow                 &TW;
     GraphicsWindow              GW;
 
-    // The state for undo/redo
+    // The state for undo/redo. Each step only holds the records that it
+    // changed, as they were before and after; the steps on the undo stack are
+    // relative to a full copy of the sketch as of the top of that stack.
     typedef struct {
         IdList<Group,hGroup>            group;
         List<hGroup>                    groupOrder;
@@ -612,25 +706,53 @@ public:
 
         void Clear() {
             group.Clear();
+            groupOrder.Clear();
             request.Clear();
             constraint.Clear();
             param.Clear();
             style.Clear();
         }
     } UndoState;
+    typedef struct {
+        UndoState   before;
+        UndoState   after;
+
+        void Clear() {
+            before.Clear();
+            after.Clear();
+        }
+    } UndoDelta;
     enum { MAX_UNDO = 16 };
     typedef struct {
-        UndoState   d[MAX_UNDO];
+        UndoDelta   d[MAX_UNDO];
         int         cnt;
         int         write;
     } UndoStack;
     UndoStack   undo;
     UndoStack   redo;
+    UndoState   undoCheckpoint;
+    // The groups whose requests, constraints and params may differ from the
+    // checkpoint; only those get compared when we remember a step.
+    std::unordered_set<uint32_t> undoTouched;
 
     std::map<Platform::Path, std::shared_ptr<Pixmap>, Platform::PathLess> images;
     bool ReloadLinkedImage(const Platform::Path &saveFile, Platform::Path *filename,
                            bool canCancel);
 
+    // Linked sketches that have been loaded already; only kept when many files
+    // that link the same parts are processed in a row, as in batch export.
+    // Nothing is ever reloaded, even if the file changes on disk, so the cache
+    // is only valid for one run.
+    typedef struct {
+        EntityList  entity;
+        SMesh       mesh;
+        SShell      shell;
+    } LinkedFile;
+    bool cacheLinkedFiles;
+    std::map<Platform::Path, LinkedFile, Platform::PathLess> linkedFiles;
+    bool LoadLinkedFile(const Platform::Path &filename, EntityList *le,
+                        SMesh *m, SShell *sh);
+
     void UndoEnableMenus();
     void UndoRemember();
     void UndoUndo();
@@ -639,6 +761,12 @@ public:
     void PopOntoCurrentFrom(UndoStack *uk);
     void UndoClearState(UndoState *ut);
     void UndoClearStack(UndoStack *uk);
+    static void UndoMakeDelta(UndoState *from, UndoDelta *ud);
+    static void UndoApplyDelta(UndoDelta *ud, bool forward, UndoState *to);
+    static void UndoApplyDelta(UndoDelta *ud, bool forward);
+    void UndoMarkDirty(UndoDelta *ud);
+    void UndoTouchDelta(UndoDelta *ud);
+    void UndoTouchGroup(hGroup hg);
 
     // Little bits of extra configuration state
     enum { MODEL_COLORS = 8 };
@@ -655,6 +783,7 @@ public:
     float    gridSpacing;
     float    exportScale;
     float    exportOffset;
+    int      exportHlrResolution;
     bool     fixExportColors;
     bool     drawBackFaces;
     bool     showContourAreas;
@@ -666,6 +795,9 @@ public:
     bool     exportPwlCurves;
     bool     exportCanvasSizeAuto;
     bool     exportMode;
+    // The tolerances at which the sketch was last regenerated for export.
+    double   exportModeChordTol;
+    int      exportModeMaxSegments;
     struct {
         float   left;
         float   right;
@@ -730,16 +862,38 @@ public:
         void       *ptr;
     } SaveTable;
     static const SaveTable SAVED[];
-    void SaveUsingTable(const Platform::Path &filename, int type);
-    void LoadUsingTable(const Platform::Path &filename, char *key, char *val);
-    struct {
+    typedef struct {
         Group        g;
         Request      r;
         Entity       e;
         Param        p;
         Constraint   c;
         Style        s;
-    } sv;
+    } SaveVars;
+    static void SaveUsingTable(FILE *fh, const Platform::Path &filename,
+                               const SaveVars &sv, int type);
+    static bool EqualUsingTable(const void *a, const void *b, int type);
+    void LoadUsingTable(const Platform::Path &filename, char *key, char *val);
+    SaveVars    sv;
+    // Everything that gets written to a .slvs file, copied out of the sketch
+    // so that it can be serialized without touching the live data.
+    typedef struct {
+        std::vector<Group>      group;
+        std::vector<Param>      param;
+        std::vector<Request>    request;
+        std::vector<Entity>     entity;
+        std::vector<Constraint> constraint;
+        std::vector<Style>      style;
+        SMesh                   mesh;
+        SShell                  shell;
+
+        void Clear();
+    } SaveSnapshot;
+    struct {
+        std::future<bool>   result;
+        Platform::Path      filename;
+        bool                isAutosave;
+    } backgroundSave;
     static void MenuFile(Command id);
 	bool Autosave();
     void RemoveAutosave();
@@ -750,21 +904,38 @@ public:
     void ClearExisting();
     void NewFile();
     bool SaveToFile(const Platform::Path &filename);
+    bool SaveToFileInBackground(const Platform::Path &filename, bool isAutosave);
+    bool FinishBackgroundSave(bool wait);
+    bool MakeSaveSnapshot(const Platform::Path &filename, SaveSnapshot *snap);
+    static bool WriteSaveSnapshot(FILE *fh, const Platform::Path &filename,
+                                  const SaveSnapshot &snap);
     bool LoadAutosaveFor(const Platform::Path &filename);
     bool LoadFromFile(const Platform::Path &filename, bool canCancel = false);
     void UpgradeLegacyData();
     bool LoadEntitiesFromFile(const Platform::Path &filename, EntityList *le,
                               SMesh *m, SShell *sh);
-    bool ReloadAllLinked(const Platform::Path &filename, bool canCancel = false);
+    bool ReloadAllLinked(const Platform::Path &filename, bool canCancel = false,
+                         bool onlyUnloaded = false);
     // And the various export options
     void ExportAsPngTo(const Platform::Path &filename);
+    void GenerateForExport();
+    void GenerateEditForExport();
+    bool GenerateVariantForExport(const std::vector<hConstraint> &dimensions,
+                                  const std::vector<double> &values,
+                                  IdList<Param,hParam> *goodParams);
     void ExportMeshTo(const Platform::Path &filename);
     void ExportMeshAsStlTo(FILE *f, SMesh *sm);
+    void ExportMeshAsPlyTo(FILE *f, Group *g);
+    void ExportMeshAsGltfTo(FILE *f, Group *g);
     void ExportMeshAsObjTo(FILE *fObj, FILE *fMtl, SMesh *sm);
     void ExportMeshAsThreeJsTo(FILE *f, const Platform::Path &filename,
                                SMesh *sm, SOutlineList *sol);
     void ExportViewOrWireframeTo(const Platform::Path &filename, bool exportWireframe);
     void ExportSectionTo(const Platform::Path &filename);
+    void ExportSectionEdgesTo(const Platform::Path &filename,
+                              SEdgeList *el, SBezierList *bl,
+                              Vector u, Vector v, Vector n, Vector origin);
+    void ExportSlicesTo(const Platform::Path &filename, double step);
     void ExportWireframeCurves(SEdgeList *sel, SBezierList *sbl,
                                VectorFileWriter *out);
     void ExportLinesAndMesh(SEdgeList *sel, SBezierList *sbl, SMesh *sm,
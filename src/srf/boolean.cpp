@@ -132,6 +132,7 @@ SCurve SCurve::MakeCopySplitAgainst(SShell *agnstA, SShell *agnstB,
 }
 
 void SShell::CopyCurvesSplitAgainst(bool opA, SShell *agnst, SShell *into) {
+    TRACE_SCOPE("SShell::CopyCurvesSplitAgainst");
     SCurve *sc;
     for(sc = curve.First(); sc; sc = curve.NextAfter(sc)) {
         SCurve scn = sc->MakeCopySplitAgainst(agnst, NULL,
@@ -605,6 +606,7 @@ SSurface SSurface::MakeCopyTrimAgainst(SShell *parent,
 }
 
 void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSurface::CombineAs type) {
+    TRACE_SCOPE("SShell::CopySurfacesTrimAgainst");
     SSurface *ss;
     for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
         SSurface ssn;
@@ -615,6 +617,7 @@ void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSu
 }
 
 void SShell::MakeIntersectionCurvesAgainst(SShell *agnst, SShell *into) {
+    TRACE_SCOPE("SShell::MakeIntersectionCurvesAgainst");
     SSurface *sa;
     for(sa = surface.First(); sa; sa = surface.NextAfter(sa)) {
         SSurface *sb;
@@ -700,6 +703,7 @@ void SShell::MakeFromAssemblyOf(SShell *a, SShell *b) {
 }
 
 void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
+    TRACE_SCOPE("SShell::MakeFromBoolean");
     booleanFailed = false;
 
     a->MakeClassifyingBsps(NULL);
@@ -754,6 +758,7 @@ void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
 // All of the BSP routines that we use to perform and accelerate polygon ops.
 //-----------------------------------------------------------------------------
 void SShell::MakeClassifyingBsps(SShell *useCurvesFrom) {
+    TRACE_SCOPE("SShell::MakeClassifyingBsps");
     SSurface *ss;
     for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
         ss->MakeClassifyingBsp(this, useCurvesFrom);
@@ -310,7 +310,7 @@ Vector SSurface::ExactSurfaceTangentAt(Vector p, SSurface *srfA, SSurface *srfB,
 //-----------------------------------------------------------------------------
 // Report our trim curves. If a trim curve is exact and sbl is not null, then
 // add its exact form to sbl. Otherwise, add its piecewise linearization to
-// sel.
+// sel. Each Bezier records the SCurve that it came from in its entity field.
 //-----------------------------------------------------------------------------
 void SSurface::MakeSectionEdgesInto(SShell *shell, SEdgeList *sel, SBezierList *sbl)
 {
@@ -337,6 +337,7 @@ void SSurface::MakeSectionEdgesInto(SShell *shell, SEdgeList *sel, SBezierList *
             SBezier keep_bef, junk_aft;
             keep_aft.SplitAt(tf, &keep_bef, &junk_aft);
 
+            keep_bef.entity = stb->curve.v;
             sbl->l.Add(&keep_bef);
         } else if(sbl && !sel && !sc->isExact) {
             // We must approximate this trim curve, as piecewise cubic sections.
@@ -399,6 +400,7 @@ void SSurface::MakeSectionEdgesInto(SShell *shell, SEdgeList *sel, SBezierList *
                         continue;
                     } else {
                         // Okay, so use this piece and break.
+                        sb.entity = stb->curve.v;
                         sbl->l.Add(&sb);
                         break;
                     }
@@ -859,8 +861,22 @@ void SShell::MakeEdgesInto(SEdgeList *sel) {
     }
 }
 
-void SShell::MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierList *sbl)
+void SShell::MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierList *sbl,
+                                  const SBvh *bvh)
 {
+    if(bvh) {
+        // Only the surfaces whose bounding boxes meet the plane can lie in it.
+        std::vector<int> found;
+        bvh->ItemsMeetingPlane(n, d, LENGTH_EPS, &found);
+        for(int i : found) {
+            SSurface *s = &surface.elem[i];
+            if(s->CoincidentWithPlane(n, d)) {
+                s->MakeSectionEdgesInto(this, sel, sbl);
+            }
+        }
+        return;
+    }
+
     SSurface *s;
     for(s = surface.First(); s; s = surface.NextAfter(s)) {
         if(s->CoincidentWithPlane(n, d)) {
@@ -869,7 +885,23 @@ void SShell::MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierLis
     }
 }
 
+//-----------------------------------------------------------------------------
+// Build a bounding volume hierarchy over our surfaces, from the bounding boxes
+// of their control points; items are indices into the surface list.
+//-----------------------------------------------------------------------------
+SBvh SBvh::From(const SShell *s) {
+    std::vector<BBox> boxes;
+    boxes.reserve(s->surface.n);
+    for(int i = 0; i < s->surface.n; i++) {
+        Vector ptMax, ptMin;
+        s->surface.elem[i].GetAxisAlignedBounding(&ptMax, &ptMin);
+        boxes.push_back(BBox::From(ptMin, ptMax));
+    }
+    return From(boxes);
+}
+
 void SShell::TriangulateInto(SMesh *sm) {
+    TRACE_SCOPE("SShell::TriangulateInto");
     SSurface *s;
     for(s = surface.First(); s; s = surface.NextAfter(s)) {
         s->TriangulateInto(this, sm);
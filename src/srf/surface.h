@@ -419,7 +419,8 @@ public:
 
     void TriangulateInto(SMesh *sm);
     void MakeEdgesInto(SEdgeList *sel);
-    void MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierList *sbl);
+    void MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierList *sbl,
+                              const SBvh *bvh = NULL);
     bool IsEmpty() const;
     void RemapFaces(Group *g, int remap);
     void Clear();
@@ -67,6 +67,26 @@ bool System::WriteJacobian(int tag) {
     return true;
 }
 
+// The Jacobian of a single equation in a single unknown. This is what
+// WriteJacobian(tag) writes for an equation solved alone, but without going
+// through every param and equation to find them, which made sketches with
+// thousands of such equations take quadratic time.
+void System::WriteJacobian(Equation *e, Param *p) {
+    mat.param[0] = p->h;
+    mat.n = 1;
+
+    mat.eq[0] = e->h;
+    Expr *f = e->e->DeepCopyWithParamsAsPointers(&param, &(SK.param));
+    f = f->FoldConstants();
+
+    Expr *pd = f->PartialWrt(p->h);
+    pd = pd->FoldConstants();
+    pd = pd->DeepCopyWithParamsAsPointers(&param, &(SK.param));
+    mat.A.sym[0][0] = pd;
+    mat.B.sym[0] = f;
+    mat.m = 1;
+}
+
 void System::EvalJacobian() {
     int i, j;
     for(i = 0; i < mat.m; i++) {
@@ -85,6 +105,7 @@ bool System::IsDragged(hParam p) {
 }
 
 void System::SolveBySubstitution() {
+    TRACE_SCOPE("System::SolveBySubstitution");
     int i;
     for(i = 0; i < eq.n; i++) {
         Equation *teq = &(eq.elem[i]);
@@ -277,6 +298,7 @@ bool System::SolveLeastSquares() {
 }
 
 bool System::NewtonSolve(int tag) {
+    TRACE_SCOPE("System::NewtonSolve");
 
     int iter = 0;
     bool converged = false;
@@ -360,6 +382,7 @@ void System::WriteEquationsExceptFor(hConstraint hc, Group *g) {
 }
 
 void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bool forceDofCheck) {
+    TRACE_SCOPE("System::FindWhichToRemoveToFixJacobian");
     int a, i;
 
     for(a = 0; a < 2; a++) {
@@ -401,6 +424,7 @@ void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bo
 SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
                           bool andFindBad, bool andFindFree, bool forceDofCheck)
 {
+    TRACE_SCOPE("System::Solve");
     WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
 
     int i;
@@ -427,8 +451,9 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
     // Before solving the big system, see if we can find any equations that
     // are soluble alone. This can be a huge speedup. We don't know whether
     // the system is consistent yet, but if it isn't then we'll catch that
-    // later.
-    int alone = 1;
+    // later. Each is written and solved by itself, so they can all share one
+    // tag; numbering them would run into VAR_SUBSTITUTED after 10000.
+    const int alone = 1;
     for(i = 0; i < eq.n; i++) {
         Equation *e = &(eq.elem[i]);
         if(e->tag != 0) continue;
@@ -442,7 +467,7 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
 
         e->tag = alone;
         p->tag = alone;
-        WriteJacobian(alone);
+        WriteJacobian(e, p);
         if(!NewtonSolve(alone)) {
             // We don't do the rank test, so let's arbitrarily return
             // the DIDNT_CONVERGE result here.
@@ -450,7 +475,6 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
             // Failed to converge, bail out early
             goto didnt_converge;
         }
-        alone++;
     }
 
     // Now write the Jacobian for what's left, and do a rank test; that
@@ -520,6 +544,7 @@ didnt_converge:
 SolveResult System::SolveRank(Group *g, int *dof, List<hConstraint> *bad,
                               bool andFindBad, bool andFindFree, bool forceDofCheck)
 {
+    TRACE_SCOPE("System::SolveRank");
     WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
 
     // All params and equations are assigned to group zero.
@@ -559,6 +584,7 @@ void System::Clear() {
 }
 
 void System::MarkParamsFree(bool find) {
+    TRACE_SCOPE("System::MarkParamsFree");
     // If requested, find all the free (unbound) variables. This might be
     // more than the number of degrees of freedom. Don't always do this,
     // because the display would get annoying and it's slow.
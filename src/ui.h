@@ -78,6 +78,8 @@ const FileFilter RasterFileFilter[] = {
 const FileFilter MeshFileFilter[] = {
     { N_("STL mesh"),                   { "stl" } },
     { N_("Wavefront OBJ mesh"),         { "obj" } },
+    { N_("Binary PLY mesh"),            { "ply" } },
+    { N_("glTF binary mesh"),           { "glb" } },
     { N_("Three.js-compatible mesh, with viewer"),  { "html" } },
     { N_("Three.js-compatible mesh, mesh only"),    { "js" } },
     { NULL, {} }
@@ -104,6 +106,11 @@ const FileFilter Vector3dFileFilter[] = {
     { N_("DXF file (AutoCAD 2007)"),    { "dxf" } },
     { NULL, {} }
 };
+// Profiling traces
+const FileFilter TraceFileFilter[] = {
+    { N_("Chrome trace"),               { "json" } },
+    { NULL, {} }
+};
 // All Importable formats
 const FileFilter ImportableFileFilter[] = {
     { N_("AutoCAD DXF and DWG files"),  { "dxf", "dwg" } },
@@ -219,6 +226,7 @@ enum class Command : uint32_t {
     STEP_DIM,
     // Help
     WEBSITE,
+    RECORD_TRACE,
     ABOUT,
     // Recent
     RECENT_OPEN = 0xf000,
@@ -397,6 +405,7 @@ public:
         EXPORT_SCALE          = 108,
         EXPORT_OFFSET         = 109,
         CANVAS_SIZE           = 110,
+        EXPORT_HLR_RESOLUTION = 111,
         G_CODE_DEPTH          = 120,
         G_CODE_PASSES         = 121,
         G_CODE_FEED           = 122,
@@ -552,6 +561,7 @@ public:
     static void ScreenChangeDigitsAfterDecimal(int link, uint32_t v);
     static void ScreenChangeExportScale(int link, uint32_t v);
     static void ScreenChangeExportOffset(int link, uint32_t v);
+    static void ScreenChangeExportHlrResolution(int link, uint32_t v);
     static void ScreenChangeGCodeParameter(int link, uint32_t v);
     static void ScreenChangeAutosaveInterval(int link, uint32_t v);
     static void ScreenChangeStyleName(int link, uint32_t v);
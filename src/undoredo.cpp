@@ -3,6 +3,16 @@
 // record our state and push it on a stack, and we pop the stack when they
 // select undo.
 //
+// We don't keep a copy of the whole sketch for every step, since that would
+// cost time and memory proportional to the size of the sketch on every edit.
+// Instead there is one full copy (the checkpoint) of the state that undo
+// would return to, and each step only records the records that changed.
+// To find those, we only compare the records of the groups that were touched
+// since the checkpoint: marked dirty, solved, or edited in some way that
+// doesn't need either. The other records are only checked to still be there,
+// by walking their handles; that is still in proportion to the size of the
+// sketch, but it's cheap next to regenerating even one group.
+//
 // Copyright 2008-2013 Jonathan Westhues.
 //-----------------------------------------------------------------------------
 #include "solvespace.h"
@@ -35,111 +45,373 @@ void SolveSpaceUI::UndoEnableMenus() {
     EnableMenuByCmd(Command::REDO, redo.cnt > 0);
 }
 
-void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
-    int i;
+//-----------------------------------------------------------------------------
+// Copying and comparing the individual records. Only the stuff that we would
+// save in a file is compared, and for groups, only that stuff is copied; the
+// rest gets regenerated.
+//-----------------------------------------------------------------------------
+template<class T>
+static T UndoCopyOf(const T &src) {
+    return src;
+}
+
+static Group UndoCopyOf(const Group &src) {
+    Group dest = src;
+    // And then clean up all the stuff that needs to be a deep copy,
+    // and zero out all the dynamic stuff that will get regenerated.
+    dest.clean = false;
+    dest.solved = {};
+    dest.polyLoops = {};
+    dest.bezierLoops = {};
+    dest.bezierOpens = {};
+    dest.polyError = {};
+    dest.thisMesh = {};
+    dest.runningMesh = {};
+    dest.thisShell = {};
+    dest.runningShell = {};
+    dest.displayMesh = {};
+    dest.displayOutlines = {};
+
+    dest.remap = {};
+    const_cast<Group &>(src).remap.DeepCopyInto(&(dest.remap));
+
+    dest.impMesh = {};
+    dest.impShell = {};
+    dest.impEntity = {};
+    return dest;
+}
+
+template<class T, class H, class F>
+static void UndoDiffList(IdList<T,H> *from, IdList<T,H> *to, int type,
+                         IdList<T,H> *before, IdList<T,H> *after, F mayDiffer) {
+    // Both lists are sorted by handle, so walk them in step. The results
+    // come out in handle order too, so adding them doesn't move anything.
+    // A record that's in both is only compared if it may have changed.
+    int i = 0, j = 0;
+    while(i < from->n || j < to->n) {
+        T *a = (i < from->n) ? &(from->elem[i]) : NULL;
+        T *b = (j < to->n)   ? &(to->elem[j])   : NULL;
+        if(b == NULL || (a != NULL && a->h.v < b->h.v)) {
+            // Deleted by this step.
+            T copy = UndoCopyOf(*a);
+            before->Add(&copy);
+            i++;
+        } else if(a == NULL || b->h.v < a->h.v) {
+            // Created by this step.
+            T copy = UndoCopyOf(*b);
+            after->Add(&copy);
+            j++;
+        } else {
+            if(mayDiffer(*b) && !SolveSpaceUI::EqualUsingTable(a, b, type)) {
+                T copyA = UndoCopyOf(*a);
+                before->Add(&copyA);
+                T copyB = UndoCopyOf(*b);
+                after->Add(&copyB);
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+template<class T, class H>
+static void UndoApplyList(IdList<T,H> *list, IdList<T,H> *remove, IdList<T,H> *insert) {
+    // Most of what a step touches is changed rather than created or deleted,
+    // so replace those records where they are, in time proportional to the
+    // step and not to the list.
+    std::vector<T *> created;
+    for(T &t : *insert) {
+        T *e = list->FindByIdNoOops(t.h);
+        if(e == NULL) {
+            created.push_back(&t);
+            continue;
+        }
+        e->Clear();
+        *e = UndoCopyOf(t);
+    }
+
+    // Drop the records that the step deleted; both halves are sorted, so
+    // those are the ones in the first that aren't in the second.
+    bool anyTagged = false;
+    int j = 0;
+    for(T &t : *remove) {
+        while(j < insert->n && insert->elem[j].h.v < t.h.v) j++;
+        if(j < insert->n && insert->elem[j].h.v == t.h.v) continue;
+        T *e = list->FindByIdNoOops(t.h);
+        if(e == NULL) continue;
+        if(!anyTagged) list->ClearTags();
+        e->tag = 1;
+        anyTagged = true;
+    }
+    if(anyTagged) list->RemoveTagged();
+    if(created.empty()) return;
+
+    // ... and then merge in the new ones. Both lists are sorted, so this
+    // takes a single pass, however many records there are.
+    IdList<T,H> merged = {};
+    merged.ReserveMore(list->n + (int)created.size());
+    int i = 0;
+    size_t k = 0;
+    while(i < list->n || k < created.size()) {
+        if(k == created.size() ||
+                (i < list->n && list->elem[i].h.v < created[k]->h.v)) {
+            new(&merged.elem[merged.n++]) T(std::move(list->elem[i]));
+            list->elem[i].~T();
+            i++;
+        } else {
+            new(&merged.elem[merged.n++]) T(UndoCopyOf(*created[k]));
+            k++;
+        }
+    }
+    if(list->elem) MemFree(list->elem);
+    *list = merged;
+}
+
+//-----------------------------------------------------------------------------
+// Record how the sketch differs from the given state.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::UndoMakeDelta(UndoState *from, UndoDelta *ud) {
+    const std::unordered_set<uint32_t> &touched = SS.undoTouched;
+    auto groupTouched = [&](hGroup hg) {
+        return touched.count(hg.v) > 0;
+    };
+    int ri = 0;
+    auto paramTouched = [&](const Param &p) {
+        if(p.h.v & 0x80000000) {
+            // Belongs to a group, with the same numbering as its entities.
+            hEntity he = { p.h.v };
+            return groupTouched(he.group());
+        } else if(p.h.v & 0x40000000) {
+            // Belongs to a constraint; there are few of these.
+            return true;
+        }
+        // The params are walked in handle order, and so belong to requests
+        // in handle order too.
+        hRequest hr = p.h.request();
+        while(ri < SK.request.n && SK.request.elem[ri].h.v < hr.v) ri++;
+        return ri == SK.request.n || SK.request.elem[ri].h.v != hr.v ||
+               groupTouched(SK.request.elem[ri].group);
+    };
+
+    *ud = {};
+    UndoDiffList(&from->group, &SK.group, 'g',
+                 &ud->before.group, &ud->after.group,
+                 [](const Group &) { return true; });
+    UndoDiffList(&from->request, &SK.request, 'r',
+                 &ud->before.request, &ud->after.request,
+                 [&](const Request &r) { return groupTouched(r.group); });
+    UndoDiffList(&from->constraint, &SK.constraint, 'c',
+                 &ud->before.constraint, &ud->after.constraint,
+                 [&](const Constraint &c) { return groupTouched(c.group); });
+    UndoDiffList(&from->param, &SK.param, 'p',
+                 &ud->before.param, &ud->after.param, paramTouched);
+    UndoDiffList(&from->style, &SK.style, 's',
+                 &ud->before.style, &ud->after.style,
+                 [](const Style &) { return true; });
+
+    // These are tiny, so just keep both versions.
+    for(hGroup &hg : from->groupOrder) {
+        ud->before.groupOrder.Add(&hg);
+    }
+    for(hGroup &hg : SK.groupOrder) {
+        ud->after.groupOrder.Add(&hg);
+    }
+    ud->before.activeGroup = from->activeGroup;
+    ud->after.activeGroup = SS.GW.activeGroup;
+}
 
+//-----------------------------------------------------------------------------
+// Move a state (or, without one, the sketch itself) across a step, forward
+// from its before to its after half, or backward.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::UndoApplyDelta(UndoDelta *ud, bool forward, UndoState *to) {
+    UndoState *remove = forward ? &ud->before : &ud->after,
+              *insert = forward ? &ud->after  : &ud->before;
+    UndoApplyList(&to->group, &remove->group, &insert->group);
+    UndoApplyList(&to->request, &remove->request, &insert->request);
+    UndoApplyList(&to->constraint, &remove->constraint, &insert->constraint);
+    UndoApplyList(&to->param, &remove->param, &insert->param);
+    UndoApplyList(&to->style, &remove->style, &insert->style);
+
+    to->groupOrder.Clear();
+    for(hGroup &hg : insert->groupOrder) {
+        to->groupOrder.Add(&hg);
+    }
+    to->activeGroup = insert->activeGroup;
+}
+
+void SolveSpaceUI::UndoApplyDelta(UndoDelta *ud, bool forward) {
+    UndoState *remove = forward ? &ud->before : &ud->after,
+              *insert = forward ? &ud->after  : &ud->before;
+    UndoApplyList(&SK.group, &remove->group, &insert->group);
+    UndoApplyList(&SK.request, &remove->request, &insert->request);
+    UndoApplyList(&SK.constraint, &remove->constraint, &insert->constraint);
+    UndoApplyList(&SK.param, &remove->param, &insert->param);
+    UndoApplyList(&SK.style, &remove->style, &insert->style);
+
+    SK.groupOrder.Clear();
+    for(hGroup &hg : insert->groupOrder) {
+        SK.groupOrder.Add(&hg);
+    }
+    SS.GW.activeGroup = insert->activeGroup;
+}
+
+//-----------------------------------------------------------------------------
+// The order of the first group that owns any of the records a step changed.
+// Groups before that are untouched by the step.
+//-----------------------------------------------------------------------------
+static int UndoFirstAffectedOrder(SolveSpaceUI::UndoDelta *ud) {
+    std::unordered_set<uint32_t> affected;
+    std::unordered_set<uint32_t> constraintParams;
+    int firstOrder = INT_MAX;
+    for(SolveSpaceUI::UndoState *ut : { &ud->before, &ud->after }) {
+        for(Group &g : ut->group) {
+            // This might be a group that doesn't exist anymore.
+            firstOrder = min(firstOrder, g.order);
+        }
+        for(Request &r : ut->request) {
+            affected.insert(r.group.v);
+        }
+        for(Constraint &c : ut->constraint) {
+            affected.insert(c.group.v);
+        }
+        for(Param &p : ut->param) {
+            if(p.h.v & 0x80000000) {
+                // Belongs to a group, with the same numbering as its entities.
+                hEntity he = { p.h.v };
+                affected.insert(he.group().v);
+            } else if(p.h.v & 0x40000000) {
+                constraintParams.insert(p.h.v);
+            } else {
+                // A deleted request is in the step itself, so it's counted above.
+                Request *r = SK.request.FindByIdNoOops(p.h.request());
+                if(r) affected.insert(r->group.v);
+            }
+        }
+    }
+    if(!constraintParams.empty()) {
+        for(Constraint &c : SK.constraint) {
+            if(constraintParams.count(c.valP.v)) affected.insert(c.group.v);
+        }
+    }
+
+    for(Group &g : SK.group) {
+        if(affected.count(g.h.v)) firstOrder = min(firstOrder, g.order);
+    }
+    return firstOrder;
+}
+
+//-----------------------------------------------------------------------------
+// Mark as dirty everything from the first group that a step changed. Groups
+// before that keep the geometry that they already have, so they don't need to
+// be solved and meshed again.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::UndoMarkDirty(UndoDelta *ud) {
+    int firstOrder = UndoFirstAffectedOrder(ud);
+    for(Group &g : SK.group) {
+        if(g.order >= firstOrder) {
+            g.clean = false;
+            UndoTouchGroup(g.h);
+        }
+    }
+}
+
+// The groups that a step changed may now differ from the checkpoint, even
+// where the sketch itself didn't change, because the checkpoint did.
+void SolveSpaceUI::UndoTouchDelta(UndoDelta *ud) {
+    int firstOrder = UndoFirstAffectedOrder(ud);
+    for(Group &g : SK.group) {
+        if(g.order >= firstOrder) UndoTouchGroup(g.h);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Note that the records of a group may have changed since the checkpoint.
+// Marking a group dirty does this too; this is for edits that don't need the
+// group regenerated, like moving a label.
+//-----------------------------------------------------------------------------
+void SolveSpaceUI::UndoTouchGroup(hGroup hg) {
+    undoTouched.insert(hg.v);
+}
+
+void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
     if(uk->cnt == MAX_UNDO) {
-        UndoClearState(&(uk->d[uk->write]));
-        // And then write in to this one again
+        UndoClearState(&(uk->d[uk->write].before));
+        UndoClearState(&(uk->d[uk->write].after));
+        // And then write in to this one again. The step after it is now the
+        // oldest one; nothing will ever go back past that, so drop its record
+        // of the changes too.
+        if(uk == &undo) {
+            UndoDelta *oldest = &(uk->d[WRAP(uk->write + 1, MAX_UNDO)]);
+            UndoClearState(&oldest->before);
+            UndoClearState(&oldest->after);
+        }
     } else {
         (uk->cnt)++;
     }
 
-    UndoState *ut = &(uk->d[uk->write]);
-    *ut = {};
-    ut->group.ReserveMore(SK.group.n);
-    for(i = 0; i < SK.group.n; i++) {
-        Group *src = &(SK.group.elem[i]);
-        Group dest = *src;
-        // And then clean up all the stuff that needs to be a deep copy,
-        // and zero out all the dynamic stuff that will get regenerated.
-        dest.clean = false;
-        dest.solved = {};
-        dest.polyLoops = {};
-        dest.bezierLoops = {};
-        dest.bezierOpens = {};
-        dest.polyError = {};
-        dest.thisMesh = {};
-        dest.runningMesh = {};
-        dest.thisShell = {};
-        dest.runningShell = {};
-        dest.displayMesh = {};
-        dest.displayOutlines = {};
-
-        dest.remap = {};
-        src->remap.DeepCopyInto(&(dest.remap));
-
-        dest.impMesh = {};
-        dest.impShell = {};
-        dest.impEntity = {};
-        ut->group.Add(&dest);
-    }
-    for(i = 0; i < SK.groupOrder.n; i++) {
-        ut->groupOrder.Add(&(SK.groupOrder.elem[i]));
-    }
-    ut->request.ReserveMore(SK.request.n);
-    for(i = 0; i < SK.request.n; i++) {
-        ut->request.Add(&(SK.request.elem[i]));
-    }
-    ut->constraint.ReserveMore(SK.constraint.n);
-    for(i = 0; i < SK.constraint.n; i++) {
-        Constraint *src = &(SK.constraint.elem[i]);
-        Constraint dest = *src;
-        ut->constraint.Add(&dest);
-    }
-    ut->param.ReserveMore(SK.param.n);
-    for(i = 0; i < SK.param.n; i++) {
-        ut->param.Add(&(SK.param.elem[i]));
-    }
-    ut->style.ReserveMore(SK.style.n);
-    for(i = 0; i < SK.style.n; i++) {
-        ut->style.Add(&(SK.style.elem[i]));
-    }
-    ut->activeGroup = SS.GW.activeGroup;
+    UndoDelta *ud = &(uk->d[uk->write]);
+    if(uk == &undo && uk->cnt == 1) {
+        // Nothing to be relative to yet, so this is where the checkpoint
+        // starts out.
+        *ud = {};
+        UndoClearState(&undoCheckpoint);
+        UndoDelta all;
+        UndoMakeDelta(&undoCheckpoint, &all);
+        undoCheckpoint = all.after;
+        UndoClearState(&all.before);
+    } else {
+        // A step on the undo stack takes its state to the one above it; on the
+        // redo stack, it takes the state after undo to the one we have now.
+        // Either way that's the difference from the checkpoint.
+        UndoMakeDelta(&undoCheckpoint, ud);
+        if(uk == &undo) {
+            UndoApplyDelta(ud, /*forward=*/true, &undoCheckpoint);
+        }
+    }
+    if(uk == &undo) {
+        // The checkpoint is the sketch as it is now.
+        undoTouched.clear();
+    }
 
     uk->write = WRAP(uk->write + 1, MAX_UNDO);
 }
 
 void SolveSpaceUI::PopOntoCurrentFrom(UndoStack *uk) {
-    int i;
-
     ssassert(uk->cnt > 0, "Cannot pop from empty undo stack");
     (uk->cnt)--;
     uk->write = WRAP(uk->write - 1, MAX_UNDO);
 
-    UndoState *ut = &(uk->d[uk->write]);
+    UndoDelta *ud = &(uk->d[uk->write]);
+    if(uk == &undo) {
+        // Go back to the checkpoint, replacing only what changed since...
+        UndoDelta since = {};
+        UndoMakeDelta(&undoCheckpoint, &since);
+        UndoApplyDelta(&since, /*forward=*/false);
+        UndoMarkDirty(&since);
+        since.Clear();
 
-    // Free everything in the main copy of the program before replacing it
-    for(i = 0; i < SK.groupOrder.n; i++) {
-        Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
-        g->Clear();
+        // ... and then move the checkpoint down to the next step.
+        if(uk->cnt == 0) {
+            UndoClearState(&undoCheckpoint);
+        } else {
+            UndoApplyDelta(ud, /*forward=*/false, &undoCheckpoint);
+            UndoTouchDelta(ud);
+        }
+    } else {
+        UndoApplyDelta(ud, /*forward=*/true);
+        UndoMarkDirty(ud);
     }
-    SK.group.Clear();
-    SK.groupOrder.Clear();
-    SK.request.Clear();
-    SK.constraint.Clear();
-    SK.param.Clear();
-    SK.style.Clear();
-
-    // And then do a shallow copy of the state from the undo list
-    ut->group.MoveSelfInto(&(SK.group));
-    for(i = 0; i < ut->groupOrder.n; i++)
-        SK.groupOrder.Add(&ut->groupOrder.elem[i]);
-    ut->request.MoveSelfInto(&(SK.request));
-    ut->constraint.MoveSelfInto(&(SK.constraint));
-    ut->param.MoveSelfInto(&(SK.param));
-    ut->style.MoveSelfInto(&(SK.style));
-    SS.GW.activeGroup = ut->activeGroup;
-
-    // No need to free it, since a shallow copy was made above
-    *ut = {};
+    UndoClearState(&ud->before);
+    UndoClearState(&ud->after);
 
-    // And reset the state everywhere else in the program, since the
-    // sketch just changed a lot.
+    // And reset the state everywhere else in the program. Only the groups
+    // that were replaced have lost their linked files and their geometry;
+    // regenerate starting from the first of those.
     SS.GW.ClearSuper();
     SS.TW.ClearSuper();
-    SS.ReloadAllLinked(SS.saveFile);
-    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    SS.ReloadAllLinked(SS.saveFile, /*canCancel=*/false, /*onlyUnloaded=*/true);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
     SS.ScheduleShowTW();
 
     // Activate the group that was active before.
@@ -151,23 +423,17 @@ void SolveSpaceUI::UndoClearStack(UndoStack *uk) {
     while(uk->cnt > 0) {
         uk->write = WRAP(uk->write - 1, MAX_UNDO);
         (uk->cnt)--;
-        UndoClearState(&(uk->d[uk->write]));
+        UndoClearState(&(uk->d[uk->write].before));
+        UndoClearState(&(uk->d[uk->write].after));
     }
     *uk = {}; // for good measure
+    if(uk == &undo) {
+        UndoClearState(&undoCheckpoint);
+        undoTouched.clear();
+    }
 }
 
 void SolveSpaceUI::UndoClearState(UndoState *ut) {
-    int i;
-    for(i = 0; i < ut->group.n; i++) {
-        Group *g = &(ut->group.elem[i]);
-
-        g->remap.Clear();
-    }
-    ut->group.Clear();
-    ut->request.Clear();
-    ut->constraint.Clear();
-    ut->param.Clear();
-    ut->style.Clear();
+    ut->Clear();
     *ut = {};
 }
-
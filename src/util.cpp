@@ -94,6 +94,147 @@ void SolveSpace::MultMatrix(double *mata, double *matb, double *matr) {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Call fn(i) for every i from 0 to n-1, spread over all of the cores, and
+// return once all of the calls have. The calls may happen in any order, so
+// each should write its results somewhere of its own.
+//-----------------------------------------------------------------------------
+void SolveSpace::ParallelFor(size_t n, const std::function<void(size_t)> &fn) {
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        size_t i;
+        while((i = next++) < n) {
+            fn(i);
+        }
+    };
+
+    unsigned threads = std::thread::hardware_concurrency();
+    std::vector<std::future<void>> workers;
+    for(unsigned i = 1; i < threads && i < n; i++) {
+        workers.push_back(std::async(std::launch::async, work));
+    }
+    work();
+    for(std::future<void> &worker : workers) {
+        worker.wait();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Profiling with Chrome trace events. Each TraceScope records a complete
+// event, which is buffered in memory until tracing stops (or we exit), and
+// then written out as a JSON trace.
+//-----------------------------------------------------------------------------
+namespace {
+struct TraceEvent {
+    const char  *name;
+    uint32_t    id;
+    uint32_t    thread;
+    int64_t     start;
+    int64_t     duration;
+};
+
+struct TraceState {
+    std::mutex                  mutex;
+    std::vector<TraceEvent>     events;
+    Platform::Path              filename;
+    std::atomic<uint32_t>       nextThread;
+    bool                        atExitRegistered;
+};
+
+TraceState &GetTraceState() {
+    static TraceState state;
+    return state;
+}
+
+int64_t TraceMicroseconds() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t TraceThread() {
+    static thread_local uint32_t thread = ++GetTraceState().nextThread;
+    return thread;
+}
+}
+
+std::atomic<bool> SolveSpace::TraceScope::active(false);
+
+void SolveSpace::TraceScope::Begin(const char *name, uint32_t id) {
+    this->name  = name;
+    this->id    = id;
+    this->start = TraceMicroseconds();
+}
+
+void SolveSpace::TraceScope::End() {
+    TraceEvent event = { name, id, TraceThread(), start, TraceMicroseconds() - start };
+    TraceState &state = GetTraceState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.events.push_back(event);
+}
+
+void SolveSpace::TraceScope::Start(const Platform::Path &filename) {
+    TraceState &state = GetTraceState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.filename = filename;
+        state.events.clear();
+        if(!state.atExitRegistered) {
+            atexit(&TraceScope::Stop);
+            state.atExitRegistered = true;
+        }
+    }
+    active = true;
+}
+
+void SolveSpace::TraceScope::Stop() {
+    if(!active) return;
+    active = false;
+
+    TraceState &state = GetTraceState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    FILE *f = OpenFile(state.filename, "wb");
+    if(!f) {
+        dbp("Cannot write trace to '%s'", state.filename.raw.c_str());
+        return;
+    }
+
+    int64_t epoch = state.events.empty() ? 0 : state.events.front().start;
+    for(const TraceEvent &event : state.events) {
+        epoch = std::min(epoch, event.start);
+    }
+
+    fprintf(f, "{\"traceEvents\":[\n");
+    for(size_t i = 0; i < state.events.size(); i++) {
+        const TraceEvent &event = state.events[i];
+        fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                   "\"ts\":%lld,\"dur\":%lld",
+                event.name, event.thread,
+                (long long)(event.start - epoch), (long long)event.duration);
+        if(event.id != 0) {
+            fprintf(f, ",\"args\":{\"id\":\"%08x\"}", event.id);
+        }
+        fprintf(f, "}%s\n", (i + 1 < state.events.size()) ? "," : "");
+    }
+    fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
+    state.events.clear();
+}
+
+Platform::Path SolveSpace::TraceScope::Filename() {
+    TraceState &state = GetTraceState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.filename;
+}
+
+// Called from main() of each of our programs, so that tracing can be started
+// from the environment; not done in libslvs, which is loaded by other people's.
+void SolveSpace::TraceScope::StartFromEnvironment() {
+    const char *filename = getenv("SOLVESPACE_TRACE");
+    if(filename && *filename) {
+        Start(Platform::Path::From(filename));
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Word-wrap the string for our message box appropriately, and then display
 // that string.
@@ -921,7 +1062,7 @@ size_t VectorHash::operator()(const Vector &v) const {
 
     double x = fabs(v.x) / eps;
     double y = fabs(v.y) / eps;
-    double z = fabs(v.y) / eps;
+    double z = fabs(v.z) / eps;
 
     size_t xs = size_t(fmod(x, (double)size));
     size_t ys = size_t(fmod(y, (double)size));
@@ -0,0 +1,31 @@
+#include "harness.h"
+
+// A big triangle far behind, and a thin one in front that covers no pixel
+// center near the point we test, and whose centroid lies pixels away.
+static SMesh OccludingMesh() {
+    SMesh m = {};
+    STriMeta meta = {};
+    m.AddTriangle(meta, Vector::From(0, 0, -10), Vector::From(40, 0, -10),
+                  Vector::From(0, 40, -10));
+    m.AddTriangle(meta, Vector::From(0.5, 0.9, 5), Vector::From(39, 1, 5),
+                  Vector::From(0.5, 1.1, 5));
+    return m;
+}
+
+TEST_CASE(occluded_behind_thin_triangle) {
+    SMesh m = OccludingMesh();
+    SDepthBuffer db = SDepthBuffer::From(&m, 8);
+    CHECK_TRUE(db.IsOccluded(Vector::From(1, 1, 0)));
+    CHECK_FALSE(db.IsOccluded(Vector::From(1, 1.5, 0)));
+    CHECK_FALSE(db.IsOccluded(Vector::From(1, 1, 6)));
+    CHECK_TRUE(db.IsOccluded(Vector::From(1, 1.5, -11)));
+    m.Clear();
+}
+
+TEST_CASE(resolution_is_capped) {
+    SMesh m = OccludingMesh();
+    SDepthBuffer db = SDepthBuffer::From(&m, 1 << 20);
+    CHECK_TRUE(db.width  <= SDepthBuffer::MAX_RESOLUTION + 3);
+    CHECK_TRUE(db.height <= SDepthBuffer::MAX_RESOLUTION + 3);
+    m.Clear();
+}
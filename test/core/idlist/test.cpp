@@ -0,0 +1,97 @@
+#include "harness.h"
+#if !defined(WIN32)
+#   include <unistd.h>
+#   include <fcntl.h>
+#   include <signal.h>
+#   include <sys/wait.h>
+#endif
+
+// Add params with the given handles, one at a time or all at once, each with
+// its handle as its value, so that we can tell where each one ended up.
+static void AddParams(IdList<Param,hParam> *list, std::vector<uint32_t> handles,
+                      bool many) {
+    std::vector<Param> params;
+    for(uint32_t h : handles) {
+        Param p = {};
+        p.h.v = h;
+        p.val = h;
+        params.push_back(p);
+    }
+    if(many) {
+        list->AddMany(params.data(), (int)params.size());
+    } else {
+        for(Param &p : params) list->Add(&p);
+    }
+}
+
+static bool HasParams(IdList<Param,hParam> *list, std::vector<uint32_t> handles) {
+    if(list->n != (int)handles.size()) return false;
+    for(int i = 0; i < list->n; i++) {
+        if(list->elem[i].h.v != handles[i] || list->elem[i].val != handles[i]) return false;
+        if(list->FindByIdNoOops(list->elem[i].h) != &list->elem[i]) return false;
+    }
+    return true;
+}
+
+TEST_CASE(add_many_to_empty) {
+    IdList<Param,hParam> list = {};
+    AddParams(&list, { 5, 1, 4, 2, 3 }, /*many=*/true);
+    CHECK_TRUE(HasParams(&list, { 1, 2, 3, 4, 5 }));
+    list.Clear();
+}
+
+TEST_CASE(add_many_interleaved) {
+    IdList<Param,hParam> list = {};
+    AddParams(&list, { 2, 4, 6, 8 }, /*many=*/false);
+    AddParams(&list, { 9, 1, 5, 3, 7 }, /*many=*/true);
+    CHECK_TRUE(HasParams(&list, { 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+    list.Clear();
+}
+
+TEST_CASE(add_many_after_end) {
+    IdList<Param,hParam> list = {};
+    AddParams(&list, { 1, 2, 3 }, /*many=*/false);
+    AddParams(&list, { 6, 4, 5 }, /*many=*/true);
+    CHECK_TRUE(HasParams(&list, { 1, 2, 3, 4, 5, 6 }));
+    AddParams(&list, {}, /*many=*/true);
+    CHECK_TRUE(HasParams(&list, { 1, 2, 3, 4, 5, 6 }));
+    list.Clear();
+}
+
+#if !defined(WIN32)
+// Whether fn fails an assertion; it's run in a child process, since that
+// aborts, with the report of the failure thrown away.
+static bool FailsAssertion(std::function<void()> fn) {
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if(pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDERR_FILENO);
+        dup2(null, STDOUT_FILENO);
+        fn();
+        _exit(0);
+    }
+    int status;
+    if(pid < 0 || waitpid(pid, &status, 0) != pid) return false;
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+TEST_CASE(add_many_duplicates) {
+    CHECK_TRUE(FailsAssertion([] {
+        IdList<Param,hParam> list = {};
+        AddParams(&list, { 3, 1, 3 }, /*many=*/true);
+    }));
+    CHECK_TRUE(FailsAssertion([] {
+        IdList<Param,hParam> list = {};
+        AddParams(&list, { 1, 2 }, /*many=*/false);
+        AddParams(&list, { 4, 2 }, /*many=*/true);
+    }));
+    CHECK_FALSE(FailsAssertion([] {
+        IdList<Param,hParam> list = {};
+        AddParams(&list, { 1, 2 }, /*many=*/false);
+        AddParams(&list, { 4, 3 }, /*many=*/true);
+        list.Clear();
+    }));
+}
+#endif
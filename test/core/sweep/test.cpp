@@ -0,0 +1,124 @@
+#include "harness.h"
+
+// A sketch of two groups: a horizontal line from a locked point in the first,
+// and a triangle in the second. The length of the line and the sides of the
+// triangle are the dimensions that the variants change.
+struct Sweep {
+    hEntity                     lineStart, lineEnd;
+    hEntity                     corner[3];
+    std::vector<hConstraint>    dimensions;
+};
+
+static hRequest AddLine(Vector a, Vector b) {
+    hRequest hr = SS.GW.AddRequest(Request::Type::LINE_SEGMENT, /*rememberForUndo=*/false);
+    SK.GetEntity(hr.entity(1))->PointForceTo(a);
+    SK.GetEntity(hr.entity(2))->PointForceTo(b);
+    return hr;
+}
+
+static hConstraint AddDistance(hEntity ptA, hEntity ptB, double val) {
+    Constraint c = {};
+    c.group = SS.GW.activeGroup;
+    c.workplane = SS.GW.ActiveWorkplane();
+    c.type = Constraint::Type::PT_PT_DISTANCE;
+    c.ptA = ptA;
+    c.ptB = ptB;
+    c.valA = val;
+    return Constraint::AddConstraint(&c, /*rememberForUndo=*/false);
+}
+
+static void AddSketchGroup() {
+    Group::AddWorkplaneGroup("triangle");
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+}
+
+static Sweep MakeSweep() {
+    Sweep s = {};
+
+    hRequest line = AddLine(Vector::From(0, 0, 0), Vector::From(10, 0, 0));
+    s.lineStart = line.entity(1);
+    s.lineEnd   = line.entity(2);
+    Constraint::Constrain(Constraint::Type::WHERE_DRAGGED,
+                          s.lineStart, Entity::NO_ENTITY, Entity::NO_ENTITY);
+    Constraint::Constrain(Constraint::Type::HORIZONTAL,
+                          Entity::NO_ENTITY, Entity::NO_ENTITY, line.entity(0));
+    s.dimensions.push_back(AddDistance(s.lineStart, s.lineEnd, 10));
+
+    AddSketchGroup();
+    Vector v[3] = {
+        Vector::From(0, 20, 0), Vector::From(4, 20, 0), Vector::From(4, 23, 0)
+    };
+    hRequest sides[3];
+    for(int i = 0; i < 3; i++) {
+        sides[i] = AddLine(v[i], v[(i + 1) % 3]);
+        s.corner[i] = sides[i].entity(1);
+    }
+    for(int i = 0; i < 3; i++) {
+        Constraint::ConstrainCoincident(sides[i].entity(2), sides[(i + 1) % 3].entity(1));
+    }
+    Constraint::Constrain(Constraint::Type::WHERE_DRAGGED,
+                          s.corner[0], Entity::NO_ENTITY, Entity::NO_ENTITY);
+    Constraint::Constrain(Constraint::Type::HORIZONTAL,
+                          Entity::NO_ENTITY, Entity::NO_ENTITY, sides[0].entity(0));
+    for(int i = 0; i < 3; i++) {
+        s.dimensions.push_back(AddDistance(s.corner[i], s.corner[(i + 1) % 3],
+                                           v[i].Minus(v[(i + 1) % 3]).Magnitude()));
+    }
+    return s;
+}
+
+static double Distance(hEntity ptA, hEntity ptB) {
+    return SK.GetEntity(ptA)->PointGetNum().Minus(SK.GetEntity(ptB)->PointGetNum()).Magnitude();
+}
+
+TEST_CASE(variant_after_failed_variant) {
+    Sweep s = MakeSweep();
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    SS.GenerateForExport();
+    IdList<Param,hParam> goodParams = {};
+    SK.param.DeepCopyInto(&goodParams);
+
+    CHECK_TRUE(SS.GenerateVariantForExport(s.dimensions, { 15, 4, 3, 5 }, &goodParams));
+    CHECK_EQ_EPS(Distance(s.lineStart, s.lineEnd), 15);
+
+    // No triangle has these sides. The line still solves, but then its
+    // params are put back, so it has to be solved again for the next variant,
+    // even though that doesn't change its length.
+    CHECK_FALSE(SS.GenerateVariantForExport(s.dimensions, { 20, 1, 1, 5 }, &goodParams));
+
+    CHECK_TRUE(SS.GenerateVariantForExport(s.dimensions, { 20, 4, 5, 6 }, &goodParams));
+    CHECK_EQ_EPS(Distance(s.lineStart, s.lineEnd), 20);
+    CHECK_EQ_EPS(Distance(s.corner[0], s.corner[1]), 4);
+    CHECK_EQ_EPS(Distance(s.corner[1], s.corner[2]), 5);
+    CHECK_EQ_EPS(Distance(s.corner[2], s.corner[0]), 6);
+    goodParams.Clear();
+}
+
+TEST_CASE(edit_after_export) {
+    Sweep s = MakeSweep();
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+
+    // Every export regenerates for export, and that stays in effect after.
+    Constraint *c = SK.GetConstraint(s.dimensions[0]);
+    c->ModifyValueTo(15);
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateEditForExport();
+    SS.GenerateForExport();
+    CHECK_TRUE(SS.ActiveGroupsOkay());
+    CHECK_EQ_EPS(Distance(s.lineStart, s.lineEnd), 15);
+
+    c = SK.GetConstraint(s.dimensions[0]);
+    c->ModifyValueTo(25);
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateEditForExport();
+    SS.GenerateForExport();
+    CHECK_TRUE(SS.ActiveGroupsOkay());
+    CHECK_EQ_EPS(Distance(s.lineStart, s.lineEnd), 25);
+
+    // A side too long for the triangle doesn't solve, and is reported.
+    c = SK.GetConstraint(s.dimensions[1]);
+    c->ModifyValueTo(20);
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateEditForExport();
+    CHECK_FALSE(SS.ActiveGroupsOkay());
+}
@@ -0,0 +1,67 @@
+#include "harness.h"
+
+static Constraint *FindDistance() {
+    for(Constraint &c : SK.constraint) {
+        if(c.type == Constraint::Type::PT_PT_DISTANCE) return &c;
+    }
+    return NULL;
+}
+
+static void SetDistance(double value) {
+    SS.UndoRemember();
+    Constraint *c = FindDistance();
+    c->valA = value;
+    SS.MarkGroupDirty(c->group);
+    SS.GenerateAll();
+}
+
+TEST_CASE(undo_redo) {
+    CHECK_LOAD("normal.slvs");
+    CHECK_TRUE(FindDistance() != NULL);
+    SetDistance(42.0);
+    SS.UndoUndo();
+    CHECK_EQ_EPS(FindDistance()->valA, 10.0);
+    CHECK_SAVE("normal.slvs");
+    SS.UndoRedo();
+    CHECK_EQ_EPS(FindDistance()->valA, 42.0);
+    SS.UndoUndo();
+    CHECK_SAVE("normal.slvs");
+}
+
+TEST_CASE(undo_past_stack_depth) {
+    CHECK_LOAD("normal.slvs");
+    for(int i = 1; i <= SolveSpaceUI::MAX_UNDO + 4; i++) {
+        SetDistance(10.0 + i);
+    }
+    for(int i = SolveSpaceUI::MAX_UNDO + 3; i >= 4; i--) {
+        SS.UndoUndo();
+        CHECK_EQ_EPS(FindDistance()->valA, 10.0 + i);
+    }
+    CHECK_TRUE(SS.undo.cnt == 0);
+    for(int i = 5; i <= SolveSpaceUI::MAX_UNDO + 4; i++) {
+        SS.UndoRedo();
+        CHECK_EQ_EPS(FindDistance()->valA, 10.0 + i);
+    }
+    CHECK_TRUE(SS.redo.cnt == 0);
+}
+
+TEST_CASE(undo_label_move) {
+    CHECK_LOAD("normal.slvs");
+    Vector offset = FindDistance()->disp.offset;
+
+    // Like dragging the label, which doesn't regenerate anything.
+    SS.UndoRemember();
+    Constraint *c = FindDistance();
+    c->disp.offset = offset.Plus(Vector::From(5, 5, 0));
+    SS.UndoTouchGroup(c->group);
+    SetDistance(42.0);
+
+    SS.UndoUndo();
+    CHECK_TRUE(FindDistance()->disp.offset.Equals(offset.Plus(Vector::From(5, 5, 0))));
+    SS.UndoUndo();
+    CHECK_TRUE(FindDistance()->disp.offset.Equals(offset));
+    CHECK_SAVE("normal.slvs");
+    SS.UndoRedo();
+    CHECK_TRUE(FindDistance()->disp.offset.Equals(offset.Plus(Vector::From(5, 5, 0))));
+    CHECK_EQ_EPS(FindDistance()->valA, 10.0);
+}
@@ -7,6 +7,7 @@
 #include <cairo.h>
 
 #include "harness.h"
+#include "platform/headless.h"
 
 #if defined(WIN32)
 #   include <windows.h>
@@ -14,13 +15,6 @@
 #   include <unistd.h>
 #endif
 
-namespace SolveSpace {
-    // These are defined in headless.cpp, and aren't exposed in solvespace.h.
-    extern std::vector<Platform::Path> fontFiles;
-    extern bool antialias;
-    extern std::shared_ptr<Pixmap> framebuffer;
-}
-
 // The paths in __FILE__ are from the build system, but defined(WIN32) returns
 // the value for the host system.
 #define BUILD_PATH_SEP (__FILE__[0]=='/' ? '/' : '\\')